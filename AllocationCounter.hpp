@@ -0,0 +1,120 @@
+//
+// Counts the allocations of a program by replacing the global operator new and operator delete.
+// The replacements are definitions, so include this file in exactly one translation unit of an
+// executable (a test or a benchmark) and never in the code that is measured.
+//
+#ifndef ALLOCATIONCOUNTER_HPP
+#define ALLOCATIONCOUNTER_HPP
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+/**
+ * The counters of all the allocations of the program
+ */
+struct AllocationCounter
+{
+    /**
+     * @return - number of calls to operator new (and new[], which calls it) so far
+     */
+    static std::atomic<long>& allocations()
+    {
+        static std::atomic<long> count(0);
+        return count;
+    }
+
+    /**
+     * @return - number of calls to operator delete (and delete[]) with a non null pointer so far
+     */
+    static std::atomic<long>& deallocations()
+    {
+        static std::atomic<long> count(0);
+        return count;
+    }
+
+    /**
+     * Free memory that operator new returned, and count the deallocation. It is not inlined, so
+     * the compiler does not mistake the free of memory from the replaced operator new for a
+     * mismatched deallocation.
+     * @param memory - the memory, or nullptr
+     */
+    __attribute__((noinline)) static void deallocate(void *memory) noexcept
+    {
+        if(memory != nullptr)
+        {
+            ++deallocations();
+        }
+        std::free(memory);
+    }
+};
+
+/**
+ * Counts the allocations made since it was created, by all the threads
+ */
+class AllocationScope
+{
+private:
+    long _allocations; /**< allocations when the scope was created */
+    long _deallocations; /**< deallocations when the scope was created */
+
+public:
+    AllocationScope() : _allocations(AllocationCounter::allocations().load()), \
+                        _deallocations(AllocationCounter::deallocations().load())
+    {
+    }
+
+    /**
+     * @return - number of allocations since the scope was created
+     */
+    long allocations() const
+    {
+        return AllocationCounter::allocations().load() - _allocations;
+    }
+
+    /**
+     * @return - number of deallocations since the scope was created
+     */
+    long deallocations() const
+    {
+        return AllocationCounter::deallocations().load() - _deallocations;
+    }
+};
+
+/**
+ * Replacement of the global operator new, that counts the allocation. The other forms of new
+ * (new[] and the nothrow ones) call this one.
+ * @param size - number of bytes
+ * @return - the allocated memory
+ */
+void* operator new(std::size_t size)
+{
+    ++AllocationCounter::allocations();
+    void *memory = std::malloc(size == 0 ? 1 : size);
+    if(memory == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+/**
+ * Replacement of the global operator delete, that counts the deallocation. The other forms of
+ * delete call this one.
+ * @param memory - memory that operator new returned, or nullptr
+ */
+void operator delete(void *memory) noexcept
+{
+    AllocationCounter::deallocate(memory);
+}
+
+/**
+ * Replacement of the global sized operator delete
+ * @param memory - memory that operator new returned, or nullptr
+ */
+void operator delete(void *memory, std::size_t) noexcept
+{
+    AllocationCounter::deallocate(memory);
+}
+
+#endif //ALLOCATIONCOUNTER_HPP
@@ -0,0 +1,519 @@
+//
+// A hash map with the compact dict layout: the pairs are kept dense in a vector in the order
+// they were inserted, and a separate open addressed index maps the hash of a key to the position
+// of its pair. The index slots are 8, 16 or 32 bits wide, the narrowest that can hold a position
+// for the size of the index. Iteration is a linear scan of the pairs, and an erased pair leaves a
+// hole that the next rebuild of the index closes.
+//
+#ifndef COMPACTHASHMAP_HPP
+#define COMPACTHASHMAP_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// index slot that was never used since the last rebuild
+#define COMPACT_HASHMAP_EMPTY (-1)
+// index slot whose pair was erased
+#define COMPACT_HASHMAP_DUMMY (-2)
+// the smallest number of index slots
+#define COMPACT_HASHMAP_MIN_INDEX 8
+// the probe shifts this many more bits of the hash in on every step
+#define COMPACT_HASHMAP_PERTURB_SHIFT 5
+
+template <typename KeyT, typename ValueT, typename HashT = std::hash<KeyT>>
+/**
+ * A generic hash map that iterates in insertion order. At most 2/3 of the index slots are used,
+ * and the pairs, with the holes of erased pairs, never outnumber the usable slots.
+ * @tparam KeyT - the type of key in the map
+ * @tparam ValueT - the type of value in the map
+ * @tparam HashT - the hash function of the keys
+ */
+class CompactHashMap
+{
+private:
+    std::vector<std::pair<KeyT, ValueT>> _entries; /**< the pairs, in insertion order */
+    std::vector<bool> _erased; /**< _erased[i] is true if _entries[i] is a hole */
+    std::vector<char> _index; /**< the index slots, each _indexWidth bytes */
+    size_t _indexSize; /**< number of index slots, a power of 2 */
+    size_t _indexWidth; /**< bytes of an index slot: 1, 2 or 4 */
+    int _size; /**< number of pairs, without the holes */
+    HashT _hash;
+
+    /**
+     * @param indexSize - number of index slots
+     * @return - the number of pairs and holes the index can hold
+     */
+    static size_t usable(size_t indexSize)
+    {
+        return indexSize * 2 / 3;
+    }
+
+    /**
+     * @param numOfPairs - number of pairs
+     * @return - the number of index slots that leaves room for as many pairs again
+     */
+    static size_t indexSizeFor(size_t numOfPairs)
+    {
+        size_t indexSize = COMPACT_HASHMAP_MIN_INDEX;
+        while(usable(indexSize) < numOfPairs * 2)
+        {
+            indexSize *= 2;
+        }
+        return indexSize;
+    }
+
+    /**
+     * @param i - index slot
+     * @return - the position of the pair in the slot, COMPACT_HASHMAP_EMPTY or
+     *           COMPACT_HASHMAP_DUMMY
+     */
+    int64_t slot(size_t i) const
+    {
+        const char *address = _index.data() + i * _indexWidth;
+        if(_indexWidth == 1)
+        {
+            return static_cast<int8_t>(*address);
+        }
+        if(_indexWidth == 2)
+        {
+            int16_t value = 0;
+            std::memcpy(&value, address, sizeof(value));
+            return value;
+        }
+        int32_t value = 0;
+        std::memcpy(&value, address, sizeof(value));
+        return value;
+    }
+
+    /**
+     * @param i - index slot
+     * @param value - the position of a pair, COMPACT_HASHMAP_EMPTY or COMPACT_HASHMAP_DUMMY
+     */
+    void setSlot(size_t i, int64_t value)
+    {
+        char *address = _index.data() + i * _indexWidth;
+        if(_indexWidth == 1)
+        {
+            *address = static_cast<char>(static_cast<int8_t>(value));
+        }
+        else if(_indexWidth == 2)
+        {
+            const int16_t narrow = static_cast<int16_t>(value);
+            std::memcpy(address, &narrow, sizeof(narrow));
+        }
+        else
+        {
+            const int32_t narrow = static_cast<int32_t>(value);
+            std::memcpy(address, &narrow, sizeof(narrow));
+        }
+    }
+
+    /**
+     * Probe the index for a key. The probe mixes in more bits of the hash on every step, so
+     * hashes that share their low bits part ways.
+     * @param key - a key
+     * @param freeSlot - set to the first EMPTY or DUMMY slot of the probe, if the key is missing
+     * @param keySlot - set to the slot of the key, if it is there
+     * @return - the position of the pair of the key, or COMPACT_HASHMAP_EMPTY if it is missing
+     */
+    int64_t probe(const KeyT& key, size_t& freeSlot, size_t& keySlot) const
+    {
+        const size_t mask = _indexSize - 1;
+        size_t perturb = _hash(key);
+        size_t i = perturb & mask;
+        bool sawFree = false;
+        for(;;)
+        {
+            const int64_t position = slot(i);
+            if(position == COMPACT_HASHMAP_EMPTY)
+            {
+                freeSlot = sawFree ? freeSlot : i;
+                return COMPACT_HASHMAP_EMPTY;
+            }
+            if(position == COMPACT_HASHMAP_DUMMY)
+            {
+                if(!sawFree)
+                {
+                    freeSlot = i;
+                    sawFree = true;
+                }
+            }
+            else if(_entries[position].first == key)
+            {
+                keySlot = i;
+                return position;
+            }
+            perturb >>= COMPACT_HASHMAP_PERTURB_SHIFT;
+            i = (i * 5 + perturb + 1) & mask;
+        }
+    }
+
+    /**
+     * @param key - a key
+     * @return - the position of the pair of the key, or COMPACT_HASHMAP_EMPTY if it is missing
+     */
+    int64_t positionOf(const KeyT& key) const
+    {
+        size_t freeSlot = 0;
+        size_t keySlot = 0;
+        return probe(key, freeSlot, keySlot);
+    }
+
+    /**
+     * Close the holes of the pairs, keeping their order, and build a new index of the given
+     * size for them
+     * @param indexSize - number of index slots, a power of 2 that leaves room for the pairs
+     */
+    void rebuild(size_t indexSize)
+    {
+        size_t numOfKept = 0;
+        for(size_t i = 0; i < _entries.size(); ++i)
+        {
+            if(!_erased[i])
+            {
+                if(numOfKept != i)
+                {
+                    _entries[numOfKept] = std::move(_entries[i]);
+                }
+                ++numOfKept;
+            }
+        }
+        _entries.erase(_entries.begin() + numOfKept, _entries.end());
+        _erased.assign(numOfKept, false);
+
+        _indexSize = indexSize;
+        _indexWidth = indexSize <= 0x80 ? 1 : indexSize <= 0x8000 ? 2 : 4;
+        _index.assign(_indexSize * _indexWidth, 0);
+        for(size_t i = 0; i < _indexSize; ++i)
+        {
+            setSlot(i, COMPACT_HASHMAP_EMPTY);
+        }
+        const size_t mask = _indexSize - 1;
+        for(size_t position = 0; position < _entries.size(); ++position)
+        {
+            size_t perturb = _hash(_entries[position].first);
+            size_t i = perturb & mask;
+            while(slot(i) != COMPACT_HASHMAP_EMPTY)
+            {
+                perturb >>= COMPACT_HASHMAP_PERTURB_SHIFT;
+                i = (i * 5 + perturb + 1) & mask;
+            }
+            setSlot(i, static_cast<int64_t>(position));
+        }
+    }
+
+public:
+    /**
+     * Default constructor
+     */
+    CompactHashMap() : _indexSize(0), _indexWidth(1), _size(0)
+    {
+        rebuild(COMPACT_HASHMAP_MIN_INDEX);
+    }
+
+    /**
+     * Insert (key, value) after all the pairs of the map
+     * @param key - the key to insert
+     * @param value - the value to insert
+     * @return - true if insert succeed, false if the map already contains the key.
+     */
+    bool insert(const KeyT& key, const ValueT& value)
+    {
+        size_t freeSlot = 0;
+        size_t keySlot = 0;
+        if(probe(key, freeSlot, keySlot) != COMPACT_HASHMAP_EMPTY)
+        {
+            return false;
+        }
+        if(_entries.size() >= usable(_indexSize))
+        {
+            rebuild(indexSizeFor(_size + 1));
+            probe(key, freeSlot, keySlot);
+        }
+        setSlot(freeSlot, static_cast<int64_t>(_entries.size()));
+        _entries.emplace_back(key, value);
+        _erased.push_back(false);
+        ++_size;
+        return true;
+    }
+
+    /**
+     * @param key - the key to search for
+     * @return - true if the map contains the key, false otherwise
+     */
+    bool containsKey(const KeyT& key) const
+    {
+        return positionOf(key) != COMPACT_HASHMAP_EMPTY;
+    }
+
+    /**
+     * @param key - key of the pair
+     * @return - pointer to the value of the key, or nullptr if the map does not contain it
+     */
+    const ValueT* find(const KeyT& key) const
+    {
+        const int64_t position = positionOf(key);
+        return position == COMPACT_HASHMAP_EMPTY ? nullptr : &_entries[position].second;
+    }
+
+    /**
+     * const version of at.
+     * @param key - key of the pair
+     * @return - the value of that key, if exist, otherwise, will throw an exception.
+     */
+    const ValueT& at(const KeyT& key) const
+    {
+        const ValueT *value = find(key);
+        if(value == nullptr)
+        {
+            throw std::invalid_argument("at function must get a valid key");
+        }
+        return *value;
+    }
+
+    /**
+     * Non const version of at.
+     * @param key - key of the pair
+     * @return - the value of that key, if exist, otherwise, will throw an exception.
+     */
+    ValueT& at(const KeyT& key)
+    {
+        return const_cast<ValueT&>(static_cast<const CompactHashMap&>(*this).at(key));
+    }
+
+    /**
+     * @param key - the key that we want to find the value of.
+     * @return - the value of the key, that is first inserted with ValueT() if it is missing
+     */
+    ValueT& operator [] (const KeyT& key)
+    {
+        const int64_t position = positionOf(key);
+        if(position != COMPACT_HASHMAP_EMPTY)
+        {
+            return _entries[position].second;
+        }
+        insert(key, ValueT());
+        return _entries.back().second;
+    }
+
+    /**
+     * erase the pair with that key from the map. The pair leaves a hole; once the holes are
+     * more than the pairs, the pairs are compacted.
+     * @param key - key of the pair
+     * @return - true if succeed to delete the pair with that key, false otherwise
+     */
+    bool erase(const KeyT& key)
+    {
+        size_t freeSlot = 0;
+        size_t keySlot = 0;
+        const int64_t position = probe(key, freeSlot, keySlot);
+        if(position == COMPACT_HASHMAP_EMPTY)
+        {
+            return false;
+        }
+        setSlot(keySlot, COMPACT_HASHMAP_DUMMY);
+        _entries[position] = std::pair<KeyT, ValueT>();
+        _erased[position] = true;
+        --_size;
+        if(static_cast<size_t>(_size) * 2 < _entries.size())
+        {
+            rebuild(indexSizeFor(_size));
+        }
+        return true;
+    }
+
+    /**
+     * Double or halve the number of index slots; the index is not halved below the room that
+     * the pairs need
+     * @param increaseTheCapacity - true to double the index, false to halve it
+     */
+    void rehashing(bool increaseTheCapacity)
+    {
+        if(increaseTheCapacity)
+        {
+            rebuild(_indexSize * 2);
+        }
+        else if(_indexSize / 2 >= indexSizeFor(_size))
+        {
+            rebuild(_indexSize / 2);
+        }
+    }
+
+    /**
+     * removing all the pairs from the map
+     */
+    void clear()
+    {
+        _entries.clear();
+        _erased.clear();
+        _size = 0;
+        rebuild(COMPACT_HASHMAP_MIN_INDEX);
+    }
+
+    /**
+     * @return the number of pairs in the map
+     */
+    int size() const
+    {
+        return _size;
+    }
+
+    /**
+     * @return - true if the map is empty, false otherwise.
+     */
+    bool empty() const
+    {
+        return _size == 0;
+    }
+
+    /**
+     * @return - the number of index slots
+     */
+    int capacity() const
+    {
+        return static_cast<int>(_indexSize);
+    }
+
+    /**
+     * @return - bytes of the index
+     */
+    size_t indexBytes() const
+    {
+        return _index.size();
+    }
+
+    /**
+     * Checking if this map has the same pairs as other map, in any order
+     * @param other - map
+     * @return true if this and other map are equal, false otherwise.
+     */
+    bool operator == (const CompactHashMap& other) const
+    {
+        if(_size != other._size)
+        {
+            return false;
+        }
+        for(const std::pair<KeyT, ValueT>& pair : *this)
+        {
+            const ValueT *otherValue = other.find(pair.first);
+            if(otherValue == nullptr || *otherValue != pair.second)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @param other - map
+     * @return - true if this and other map are not equal, false otherwise.
+     */
+    bool operator != (const CompactHashMap& other) const
+    {
+        return !operator==(other);
+    }
+
+    /**
+     * iterator of the map, in insertion order. It is invalidated by any change to the map.
+     */
+    class const_iterator
+    {
+    private:
+        const CompactHashMap *_map; /**< the map */
+        size_t _position; /**< a pair that is not a hole, or the number of pairs at the end */
+
+        void skipHoles()
+        {
+            while(_position < _map->_entries.size() && _map->_erased[_position])
+            {
+                ++_position;
+            }
+        }
+
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef std::pair<KeyT, ValueT> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const value_type* pointer;
+        typedef const value_type& reference;
+
+        const_iterator(const CompactHashMap *map, size_t position) : _map(map), \
+                                                                     _position(position)
+        {
+            skipHoles();
+        }
+
+        reference operator*() const
+        {
+            return _map->_entries[_position];
+        }
+
+        pointer operator->() const
+        {
+            return &_map->_entries[_position];
+        }
+
+        const_iterator& operator++()
+        {
+            ++_position;
+            skipHoles();
+            return *this;
+        }
+
+        const_iterator operator++(int)
+        {
+            const_iterator copy(*this);
+            ++*this;
+            return copy;
+        }
+
+        bool operator==(const const_iterator& other) const
+        {
+            return _map == other._map && _position == other._position;
+        }
+
+        bool operator!=(const const_iterator& other) const
+        {
+            return !(*this == other);
+        }
+    };
+
+    /**
+     * @return the first pair that was inserted
+     */
+    const_iterator begin() const
+    {
+        return const_iterator(this, 0);
+    }
+
+    /**
+     * @return the iterator after the last pair
+     */
+    const_iterator end() const
+    {
+        return const_iterator(this, _entries.size());
+    }
+
+    /**
+     * @return the first pair that was inserted
+     */
+    const_iterator cbegin() const
+    {
+        return begin();
+    }
+
+    /**
+     * @return the iterator after the last pair
+     */
+    const_iterator cend() const
+    {
+        return end();
+    }
+};
+
+#endif //COMPACTHASHMAP_HPP
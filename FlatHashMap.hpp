@@ -0,0 +1,621 @@
+//
+// An open addressed hash map with SwissTable style groups: the slots are split into groups of 16,
+// and every slot has a control byte that is empty, deleted, or the low 7 bits of the hash of its
+// key. A lookup compares the 7 bits against the 16 control bytes of a group at once (SSE2, or a
+// scalar loop where SSE2 is missing or FLAT_HASHMAP_NO_SIMD is defined), and compares keys only
+// for the slots whose bits match. The probe stops at the first group that has an empty slot.
+//
+#ifndef FLATHASHMAP_HPP
+#define FLATHASHMAP_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <new>
+#include <stdexcept>
+#include <utility>
+
+#if defined(__SSE2__) && !defined(FLAT_HASHMAP_NO_SIMD)
+#include <emmintrin.h>
+#define FLAT_HASHMAP_SSE2
+#endif
+
+// number of slots in a group
+#define FLAT_HASHMAP_GROUP_WIDTH 16
+// control byte of a slot that was never used since the last rehash
+#define FLAT_HASHMAP_EMPTY int8_t(-128)
+// control byte of a slot whose pair was erased
+#define FLAT_HASHMAP_DELETED int8_t(-2)
+// the table grows once 7/8 of its slots are full or deleted
+#define FLAT_HASHMAP_MAX_LOAD_NUMERATOR 7
+#define FLAT_HASHMAP_MAX_LOAD_DENOMINATOR 8
+
+/**
+ * Mix a hash by folding its 128 bit product with an odd constant, so that identity hashes of
+ * integers spread over both the group index and the 7 bits of the control byte
+ * @param hash - a hash
+ * @return - the mixed hash
+ */
+inline uint64_t flatHashMix(uint64_t hash)
+{
+    const unsigned __int128 product = static_cast<unsigned __int128>(hash) * \
+                                      0x9e3779b97f4a7c15ULL;
+    return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
+}
+
+/**
+ * @param group - FLAT_HASHMAP_GROUP_WIDTH control bytes
+ * @param value - a control byte
+ * @return - a mask with bit i set if group[i] is value, compared one byte at a time
+ */
+inline uint32_t flatGroupMatchScalar(const int8_t *group, int8_t value)
+{
+    uint32_t mask = 0;
+    for(int i = 0; i < FLAT_HASHMAP_GROUP_WIDTH; ++i)
+    {
+        mask |= uint32_t(group[i] == value) << i;
+    }
+    return mask;
+}
+
+/**
+ * @param group - FLAT_HASHMAP_GROUP_WIDTH control bytes
+ * @param value - a control byte
+ * @return - a mask with bit i set if group[i] is value
+ */
+inline uint32_t flatGroupMatch(const int8_t *group, int8_t value)
+{
+#ifdef FLAT_HASHMAP_SSE2
+    const __m128i control = _mm_loadu_si128(reinterpret_cast<const __m128i *>(group));
+    return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(control, \
+                                                                  _mm_set1_epi8(value))));
+#else
+    return flatGroupMatchScalar(group, value);
+#endif
+}
+
+/**
+ * @param group - FLAT_HASHMAP_GROUP_WIDTH control bytes
+ * @return - a mask with bit i set if group[i] is empty or deleted, the only negative control
+ *           bytes, tested one byte at a time
+ */
+inline uint32_t flatGroupMatchFreeScalar(const int8_t *group)
+{
+    uint32_t mask = 0;
+    for(int i = 0; i < FLAT_HASHMAP_GROUP_WIDTH; ++i)
+    {
+        mask |= uint32_t(group[i] < 0) << i;
+    }
+    return mask;
+}
+
+/**
+ * @param group - FLAT_HASHMAP_GROUP_WIDTH control bytes
+ * @return - a mask with bit i set if group[i] is empty or deleted
+ */
+inline uint32_t flatGroupMatchFree(const int8_t *group)
+{
+#ifdef FLAT_HASHMAP_SSE2
+    // the sign bits of the control bytes are the mask
+    return static_cast<uint32_t>(_mm_movemask_epi8(_mm_loadu_si128(\
+        reinterpret_cast<const __m128i *>(group))));
+#else
+    return flatGroupMatchFreeScalar(group);
+#endif
+}
+
+template <typename KeyT, typename ValueT, typename HashT = std::hash<KeyT>>
+/**
+ * Open addressed hash map with 16 slot groups, for small keys and values that are looked up far
+ * more often than they are inserted. Pairs move when the table is rehashed, so pointers to them
+ * are valid only until the next insert.
+ * @tparam KeyT - the type of key in the hash map
+ * @tparam ValueT - the type of value in the hashMap
+ * @tparam HashT - the hash function of the keys
+ */
+class FlatHashMap
+{
+private:
+    int8_t *_control; /**< control byte of every slot */
+    std::pair<KeyT, ValueT> *_slots; /**< the slots, constructed only where the control is full */
+    int _capacity; /**< number of slots, a power of 2 and a multiple of the group width */
+    int _size; /**< number of full slots */
+    int _numOfDeleted; /**< number of deleted slots */
+    HashT _hash;
+
+    /**
+     * @param capacity - number of slots
+     * @return - new control bytes, all empty, and raw memory for the slots
+     */
+    static std::pair<int8_t *, std::pair<KeyT, ValueT> *> allocate(int capacity)
+    {
+        int8_t *control = new int8_t[capacity];
+        std::memset(control, FLAT_HASHMAP_EMPTY, capacity);
+        try
+        {
+            void *slots = ::operator new(sizeof(std::pair<KeyT, ValueT>) * capacity);
+            return {control, static_cast<std::pair<KeyT, ValueT> *>(slots)};
+        }
+        catch (const std::bad_alloc&)
+        {
+            delete[] control;
+            throw;
+        }
+    }
+
+    /**
+     * Destroy the pairs of the full slots and free the memory of the table
+     */
+    void release()
+    {
+        if(_control == nullptr)
+        {
+            return;
+        }
+        for(int i = 0; i < _capacity; ++i)
+        {
+            if(_control[i] >= 0)
+            {
+                _slots[i].~pair();
+            }
+        }
+        ::operator delete(_slots);
+        delete[] _control;
+        _control = nullptr;
+        _slots = nullptr;
+    }
+
+    /**
+     * @param key - a key
+     * @return - the slot of the key, or -1 if the map does not contain it
+     */
+    int findSlot(const KeyT& key) const
+    {
+        const uint64_t hash = flatHashMix(_hash(key));
+        const int8_t h2 = static_cast<int8_t>(hash & 0x7f);
+        const int groupMask = _capacity / FLAT_HASHMAP_GROUP_WIDTH - 1;
+        int group = static_cast<int>(hash >> 7) & groupMask;
+        for(int step = 1; ; ++step)
+        {
+            const int8_t *control = _control + group * FLAT_HASHMAP_GROUP_WIDTH;
+            for(uint32_t match = flatGroupMatch(control, h2); match != 0; match &= match - 1)
+            {
+                const int slot = group * FLAT_HASHMAP_GROUP_WIDTH + __builtin_ctz(match);
+                if(_slots[slot].first == key)
+                {
+                    return slot;
+                }
+            }
+            if(flatGroupMatch(control, FLAT_HASHMAP_EMPTY) != 0 || step > groupMask)
+            {
+                return -1;
+            }
+            // triangular steps visit every group of a power of 2 number of groups
+            group = (group + step) & groupMask;
+        }
+    }
+
+    /**
+     * @param hash - mixed hash of a key that the map does not contain
+     * @return - the first empty or deleted slot of the probe sequence of the hash
+     */
+    int findFreeSlot(uint64_t hash) const
+    {
+        const int groupMask = _capacity / FLAT_HASHMAP_GROUP_WIDTH - 1;
+        int group = static_cast<int>(hash >> 7) & groupMask;
+        for(int step = 1; ; ++step)
+        {
+            const uint32_t free = flatGroupMatchFree(_control + group * FLAT_HASHMAP_GROUP_WIDTH);
+            if(free != 0)
+            {
+                return group * FLAT_HASHMAP_GROUP_WIDTH + __builtin_ctz(free);
+            }
+            group = (group + step) & groupMask;
+        }
+    }
+
+    /**
+     * Construct a pair in a free slot of a key that the map does not contain
+     * @param pair - the pair
+     */
+    template <typename PairT>
+    void place(PairT&& pair)
+    {
+        const uint64_t hash = flatHashMix(_hash(pair.first));
+        const int slot = findFreeSlot(hash);
+        new (&_slots[slot]) std::pair<KeyT, ValueT>(std::forward<PairT>(pair));
+        if(_control[slot] == FLAT_HASHMAP_DELETED)
+        {
+            --_numOfDeleted;
+        }
+        _control[slot] = static_cast<int8_t>(hash & 0x7f);
+    }
+
+    /**
+     * @return - true if one more slot can be used without passing the maximal load factor
+     */
+    bool hasRoomForInsert() const
+    {
+        return long(_size + _numOfDeleted + 1) * FLAT_HASHMAP_MAX_LOAD_DENOMINATOR <= \
+               long(_capacity) * FLAT_HASHMAP_MAX_LOAD_NUMERATOR;
+    }
+
+    /**
+     * Move every pair to a table of the given capacity, which also drops the deleted slots
+     * @param newCapacity - number of slots, a power of 2 and a multiple of the group width
+     */
+    void rehashTo(int newCapacity)
+    {
+        std::pair<int8_t *, std::pair<KeyT, ValueT> *> table = allocate(newCapacity);
+        int8_t *oldControl = _control;
+        std::pair<KeyT, ValueT> *oldSlots = _slots;
+        const int oldCapacity = _capacity;
+        _control = table.first;
+        _slots = table.second;
+        _capacity = newCapacity;
+        _numOfDeleted = 0;
+        for(int i = 0; i < oldCapacity; ++i)
+        {
+            if(oldControl[i] >= 0)
+            {
+                place(std::move(oldSlots[i]));
+                oldSlots[i].~pair();
+            }
+        }
+        ::operator delete(oldSlots);
+        delete[] oldControl;
+    }
+
+public:
+    /**
+     * const_iterator over the full slots, in slot order
+     */
+    class const_iterator
+    {
+    private:
+        const FlatHashMap *_map; /**< the map */
+        int _slot; /**< a full slot, or the capacity at the end */
+
+        void skipFreeSlots()
+        {
+            while(_slot < _map->_capacity && _map->_control[_slot] < 0)
+            {
+                ++_slot;
+            }
+        }
+
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef std::pair<KeyT, ValueT> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const value_type* pointer;
+        typedef const value_type& reference;
+
+        const_iterator(const FlatHashMap *map, int slot) : _map(map), _slot(slot)
+        {
+            skipFreeSlots();
+        }
+
+        reference operator*() const
+        {
+            return _map->_slots[_slot];
+        }
+
+        pointer operator->() const
+        {
+            return &_map->_slots[_slot];
+        }
+
+        const_iterator& operator++()
+        {
+            ++_slot;
+            skipFreeSlots();
+            return *this;
+        }
+
+        const_iterator operator++(int)
+        {
+            const_iterator copy(*this);
+            ++*this;
+            return copy;
+        }
+
+        bool operator==(const const_iterator& other) const
+        {
+            return _map == other._map && _slot == other._slot;
+        }
+
+        bool operator!=(const const_iterator& other) const
+        {
+            return !(*this == other);
+        }
+    };
+
+    /**
+     * Constructor of an empty map of one group
+     */
+    FlatHashMap() : _capacity(FLAT_HASHMAP_GROUP_WIDTH), _size(0), _numOfDeleted(0)
+    {
+        std::pair<int8_t *, std::pair<KeyT, ValueT> *> table = allocate(_capacity);
+        _control = table.first;
+        _slots = table.second;
+    }
+
+    /**
+     * Copy constructor
+     * @param other - other map to copy
+     */
+    FlatHashMap(const FlatHashMap& other) : _capacity(other._capacity), _size(0), \
+                                            _numOfDeleted(0), _hash(other._hash)
+    {
+        std::pair<int8_t *, std::pair<KeyT, ValueT> *> table = allocate(_capacity);
+        _control = table.first;
+        _slots = table.second;
+        try
+        {
+            for(int i = 0; i < _capacity; ++i)
+            {
+                if(other._control[i] >= 0)
+                {
+                    new (&_slots[i]) std::pair<KeyT, ValueT>(other._slots[i]);
+                    _control[i] = other._control[i];
+                    ++_size;
+                }
+            }
+        }
+        catch (...)
+        {
+            release();
+            throw;
+        }
+        // the deleted slots of other are kept, so the probe sequences stay the same
+        for(int i = 0; i < _capacity; ++i)
+        {
+            if(other._control[i] == FLAT_HASHMAP_DELETED)
+            {
+                _control[i] = FLAT_HASHMAP_DELETED;
+                ++_numOfDeleted;
+            }
+        }
+    }
+
+    /**
+     * Move constructor
+     * @param other - other map, left without a table
+     */
+    FlatHashMap(FlatHashMap&& other) noexcept : _control(other._control), _slots(other._slots), \
+                                                _capacity(other._capacity), _size(other._size), \
+                                                _numOfDeleted(other._numOfDeleted), \
+                                                _hash(std::move(other._hash))
+    {
+        other._control = nullptr;
+        other._slots = nullptr;
+        other._capacity = 0;
+        other._size = 0;
+    }
+
+    /**
+     * Assignment by copy and swap
+     * @param other - other map
+     * @return - this map
+     */
+    FlatHashMap& operator = (FlatHashMap other) noexcept
+    {
+        std::swap(_control, other._control);
+        std::swap(_slots, other._slots);
+        std::swap(_capacity, other._capacity);
+        std::swap(_size, other._size);
+        std::swap(_numOfDeleted, other._numOfDeleted);
+        std::swap(_hash, other._hash);
+        return *this;
+    }
+
+    ~FlatHashMap()
+    {
+        release();
+    }
+
+    /**
+     * @return the number of pairs in the map
+     */
+    int size() const
+    {
+        return _size;
+    }
+
+    /**
+     * @return - the number of slots
+     */
+    int capacity() const
+    {
+        return _capacity;
+    }
+
+    /**
+     * @return - true if the map is empty, false otherwise.
+     */
+    bool empty() const
+    {
+        return _size == 0;
+    }
+
+    /**
+     * Rehash the map to twice or half its slots. Halving is ignored if the pairs would not fit
+     * under the maximal load factor. A map that was moved from gets a table of one group.
+     * @param increaseTheCapacity - true to double the capacity, false to halve it
+     */
+    void rehashing(bool increaseTheCapacity)
+    {
+        if(_capacity == 0)
+        {
+            rehashTo(FLAT_HASHMAP_GROUP_WIDTH);
+        }
+        else if(increaseTheCapacity)
+        {
+            rehashTo(_capacity * 2);
+        }
+        else if(_capacity > FLAT_HASHMAP_GROUP_WIDTH && \
+                long(_size) * FLAT_HASHMAP_MAX_LOAD_DENOMINATOR <= \
+                long(_capacity / 2) * FLAT_HASHMAP_MAX_LOAD_NUMERATOR)
+        {
+            rehashTo(_capacity / 2);
+        }
+    }
+
+    /**
+     * Insert (key, value) to the map
+     * @param key - the key to insert
+     * @param value - the value to insert
+     * @return - true if insert succeed, false if the key was already in the map.
+     */
+    bool insert(const KeyT& key, const ValueT& value)
+    {
+        if(_control == nullptr)
+        {
+            throw std::invalid_argument("hashMap is null");
+        }
+        if(findSlot(key) != -1)
+        {
+            return false;
+        }
+        if(!hasRoomForInsert())
+        {
+            // a table that is mostly deleted slots is cleaned at the same capacity
+            rehashTo(_size * 2 >= _capacity ? _capacity * 2 : _capacity);
+        }
+        place(std::pair<KeyT, ValueT>(key, value));
+        ++_size;
+        return true;
+    }
+
+    /**
+     * @param key - key of the pair
+     * @return - pointer to the value of the key, or nullptr if the map does not contain it
+     */
+    const ValueT* find(const KeyT& key) const
+    {
+        if(_control == nullptr)
+        {
+            return nullptr;
+        }
+        const int slot = findSlot(key);
+        return slot == -1 ? nullptr : &_slots[slot].second;
+    }
+
+    /**
+     * @param key - the key to search for
+     * @return - true if the map contains the key, false otherwise
+     */
+    bool containsKey(const KeyT& key) const
+    {
+        return find(key) != nullptr;
+    }
+
+    /**
+     * @param key - key of the pair
+     * @return - the value of that key, if exist, otherwise, will throw an exception.
+     */
+    const ValueT& at(const KeyT& key) const
+    {
+        const ValueT *value = find(key);
+        if(value == nullptr)
+        {
+            throw std::invalid_argument("at function must get a valid key");
+        }
+        return *value;
+    }
+
+    /**
+     * @param key - key of the pair
+     * @return - the value of that key, if exist, otherwise, will throw an exception.
+     */
+    ValueT& at(const KeyT& key)
+    {
+        return const_cast<ValueT&>(static_cast<const FlatHashMap&>(*this).at(key));
+    }
+
+    /**
+     * @param key - the key that we want to find the value of.
+     * @return - the value of the key, which is inserted with a default value if it is missing
+     */
+    ValueT& operator [] (const KeyT& key)
+    {
+        if(!containsKey(key))
+        {
+            insert(key, ValueT());
+        }
+        return at(key);
+    }
+
+    /**
+     * Erase the pair with that key. Its slot becomes empty if its group has an empty slot, since
+     * then no probe passed the group, and deleted otherwise.
+     * @param key - key of the pair
+     * @return - true if the pair was erased, false if the map does not contain the key
+     */
+    bool erase(const KeyT& key)
+    {
+        if(_control == nullptr)
+        {
+            return false;
+        }
+        const int slot = findSlot(key);
+        if(slot == -1)
+        {
+            return false;
+        }
+        _slots[slot].~pair();
+        const int8_t *group = _control + (slot / FLAT_HASHMAP_GROUP_WIDTH) * \
+                                         FLAT_HASHMAP_GROUP_WIDTH;
+        if(flatGroupMatch(group, FLAT_HASHMAP_EMPTY) != 0)
+        {
+            _control[slot] = FLAT_HASHMAP_EMPTY;
+        }
+        else
+        {
+            _control[slot] = FLAT_HASHMAP_DELETED;
+            ++_numOfDeleted;
+        }
+        --_size;
+        return true;
+    }
+
+    /**
+     * Erase all the pairs, keeping the capacity; a map that was moved from gets a table of one
+     * group
+     */
+    void clear()
+    {
+        const int capacity = _capacity == 0 ? FLAT_HASHMAP_GROUP_WIDTH : _capacity;
+        std::pair<int8_t *, std::pair<KeyT, ValueT> *> table = allocate(capacity);
+        release();
+        _control = table.first;
+        _slots = table.second;
+        _capacity = capacity;
+        _size = 0;
+        _numOfDeleted = 0;
+    }
+
+    const_iterator begin() const
+    {
+        return const_iterator(this, 0);
+    }
+
+    const_iterator cbegin() const
+    {
+        return begin();
+    }
+
+    const_iterator end() const
+    {
+        return const_iterator(this, _capacity);
+    }
+
+    const_iterator cend() const
+    {
+        return end();
+    }
+};
+
+#endif //FLATHASHMAP_HPP
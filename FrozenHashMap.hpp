@@ -0,0 +1,611 @@
+//
+// Immutable maps over a minimal perfect hash, for tables that never change once they are built.
+// The keys are split into buckets by their hash, and every bucket gets a displacement that sends
+// its keys to distinct free slots (hash and displace, CHD). A lookup reads the displacement of
+// the bucket of the key and probes exactly one slot; there is one slot per key and no slack.
+// The rare keys whose hash is the same as the hash of another key are kept after the slots, sorted
+// by hash, and are searched only when the slot of a key holds another key.
+//
+#ifndef FROZENHASHMAP_HPP
+#define FROZENHASHMAP_HPP
+
+#include "HashMap.hpp"
+#include <cstdint>
+#include <stdexcept>
+#include <algorithm>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+// average number of keys in a bucket of displacements
+#define FROZEN_HASHMAP_KEYS_PER_BUCKET 3
+// number of displacements to try for a bucket before the build gives up
+#define FROZEN_HASHMAP_MAX_DISPLACEMENT (1u << 24)
+// a displacement with this bit set is the slot itself, for buckets of a single key
+#define FROZEN_HASHMAP_DIRECT_SLOT 0x80000000u
+
+/**
+ * Mix the bits of a hash, so that hash functions that are the identity still spread the keys
+ * @param hash - a hash
+ * @return - the mixed hash
+ */
+constexpr uint64_t frozenHashMix(uint64_t hash)
+{
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+/**
+ * Map a hash to [0, range) by its high bits, with a multiplication instead of a division
+ * @param hash - a mixed hash
+ * @param range - the size of the range
+ * @return - a number in [0, range)
+ */
+constexpr uint64_t frozenHashReduce(uint64_t hash, uint64_t range)
+{
+    return static_cast<uint64_t>((static_cast<unsigned __int128>(hash) * range) >> 64);
+}
+
+/**
+ * @param mixedHash - frozenHashMix of the hash of a key
+ * @param numOfBuckets - number of buckets of displacements
+ * @return - the bucket of the key
+ */
+constexpr uint64_t frozenHashBucket(uint64_t mixedHash, uint64_t numOfBuckets)
+{
+    return frozenHashReduce(mixedHash, numOfBuckets);
+}
+
+/**
+ * @param mixedHash - frozenHashMix of the hash of a key
+ * @param displacement - the displacement of the bucket of the key
+ * @param numOfSlots - number of slots, one per key
+ * @return - the slot of the key
+ */
+constexpr uint64_t frozenHashSlot(uint64_t mixedHash, uint32_t displacement, uint64_t numOfSlots)
+{
+    // the multiplication carries the low bits, which differ inside a bucket, to the high bits
+    return (displacement & FROZEN_HASHMAP_DIRECT_SLOT) != 0 ? \
+           displacement & ~FROZEN_HASHMAP_DIRECT_SLOT : \
+           frozenHashReduce((mixedHash ^ (uint64_t(displacement) * 0xc2b2ae3d27d4eb4fULL)) * \
+                            0x9e3779b97f4a7c15ULL, numOfSlots);
+}
+
+template <typename KeyT, typename ValueT, typename HashT = std::hash<KeyT>>
+/**
+ * Immutable map with a minimal perfect hash over its keys. A lookup probes exactly one slot,
+ * unless the key has the same hash as another key.
+ * @tparam KeyT - the type of key in the map
+ * @tparam ValueT - the type of value in the map
+ * @tparam HashT - the hash function of the keys
+ */
+class FrozenHashMap
+{
+private:
+    /** one slot per key with a distinct hash, then the keys with a repeated hash */
+    std::vector<std::pair<KeyT, ValueT>> _entries;
+    std::vector<uint32_t> _displacements; /**< displacement of every bucket */
+    std::vector<uint64_t> _repeatedHashes; /**< sorted mixed hashes of the keys after the slots */
+    HashT _hash;
+
+    /**
+     * Split off the pairs whose keys have the same hash as the key of an earlier pair: keys with
+     * the same hash always share a slot, so no displacement could separate them. The mix is a
+     * bijection, so it keeps distinct hashes distinct.
+     * @param pairs - the pairs, with distinct keys; left with the pairs of distinct hashes
+     * @param hashes - the mixed hashes of the keys; left with the hashes of the remaining pairs
+     * @param repeated - filled with the split off pairs, sorted by hash
+     */
+    void splitRepeatedHashes(std::vector<std::pair<KeyT, ValueT>>& pairs, \
+                             std::vector<uint64_t>& hashes, \
+                             std::vector<std::pair<KeyT, ValueT>>& repeated)
+    {
+        std::vector<size_t> order(pairs.size());
+        for(size_t i = 0; i < order.size(); ++i)
+        {
+            order[i] = i;
+        }
+        std::stable_sort(order.begin(), order.end(), [&hashes](size_t a, size_t b)
+        {
+            return hashes[a] < hashes[b];
+        });
+        std::vector<bool> isRepeated(pairs.size(), false);
+        for(size_t first = 0, last = 0; first < order.size(); first = last)
+        {
+            for(last = first + 1; last < order.size() && \
+                hashes[order[last]] == hashes[order[first]]; ++last)
+            {
+                for(size_t k = first; k < last; ++k)
+                {
+                    if(pairs[order[k]].first == pairs[order[last]].first)
+                    {
+                        throw std::invalid_argument("FrozenHashMap keys must be distinct");
+                    }
+                }
+                isRepeated[order[last]] = true;
+                repeated.push_back(std::move(pairs[order[last]]));
+                _repeatedHashes.push_back(hashes[order[last]]);
+            }
+        }
+        if(repeated.empty())
+        {
+            return;
+        }
+        size_t kept = 0;
+        for(size_t i = 0; i < pairs.size(); ++i)
+        {
+            if(!isRepeated[i])
+            {
+                if(kept != i)
+                {
+                    pairs[kept] = std::move(pairs[i]);
+                    hashes[kept] = hashes[i];
+                }
+                ++kept;
+            }
+        }
+        pairs.resize(kept);
+        hashes.resize(kept);
+    }
+
+    /**
+     * Find a displacement for every bucket and place the pairs in their slots
+     * @param pairs - the pairs, with distinct keys
+     */
+    void build(std::vector<std::pair<KeyT, ValueT>> pairs)
+    {
+        if(pairs.size() >= FROZEN_HASHMAP_DIRECT_SLOT)
+        {
+            throw std::length_error("FrozenHashMap has too many pairs");
+        }
+        std::vector<uint64_t> hashes(pairs.size());
+        for(size_t i = 0; i < pairs.size(); ++i)
+        {
+            hashes[i] = frozenHashMix(_hash(pairs[i].first));
+        }
+        std::vector<std::pair<KeyT, ValueT>> repeated;
+        splitRepeatedHashes(pairs, hashes, repeated);
+        const uint64_t numOfSlots = pairs.size();
+        const uint64_t numOfBuckets = numOfSlots / FROZEN_HASHMAP_KEYS_PER_BUCKET + 1;
+
+        // the keys of every bucket, grouped by a counting sort
+        std::vector<size_t> bucketStarts(numOfBuckets + 1, 0);
+        for(uint64_t hash : hashes)
+        {
+            ++bucketStarts[frozenHashBucket(hash, numOfBuckets) + 1];
+        }
+        for(uint64_t b = 0; b < numOfBuckets; ++b)
+        {
+            bucketStarts[b + 1] += bucketStarts[b];
+        }
+        std::vector<size_t> bucketKeys(numOfSlots);
+        std::vector<size_t> nextKey(bucketStarts.begin(), bucketStarts.end() - 1);
+        for(size_t i = 0; i < numOfSlots; ++i)
+        {
+            bucketKeys[nextKey[frozenHashBucket(hashes[i], numOfBuckets)]++] = i;
+        }
+
+        // the largest buckets are placed first, while most of the slots are free
+        std::vector<uint64_t> buckets(numOfBuckets);
+        for(uint64_t b = 0; b < numOfBuckets; ++b)
+        {
+            buckets[b] = b;
+        }
+        std::stable_sort(buckets.begin(), buckets.end(), [&bucketStarts](uint64_t a, uint64_t b)
+        {
+            return bucketStarts[a + 1] - bucketStarts[a] > bucketStarts[b + 1] - bucketStarts[b];
+        });
+
+        _displacements.assign(numOfBuckets, 0);
+        std::vector<bool> taken(numOfSlots, false);
+        std::vector<uint64_t> keyOfSlot(numOfSlots);
+        std::vector<uint64_t> slots;
+        uint64_t nextFreeSlot = 0;
+        for(uint64_t b : buckets)
+        {
+            const size_t first = bucketStarts[b];
+            const size_t last = bucketStarts[b + 1];
+            if(last - first == 1)
+            {
+                // a single key takes the next free slot directly
+                while(taken[nextFreeSlot])
+                {
+                    ++nextFreeSlot;
+                }
+                _displacements[b] = FROZEN_HASHMAP_DIRECT_SLOT | uint32_t(nextFreeSlot);
+                taken[nextFreeSlot] = true;
+                keyOfSlot[nextFreeSlot] = bucketKeys[first];
+                continue;
+            }
+            bool placed = last == first;
+            for(uint32_t displacement = 0; !placed && \
+                displacement < FROZEN_HASHMAP_MAX_DISPLACEMENT; ++displacement)
+            {
+                slots.clear();
+                placed = true;
+                for(size_t k = first; placed && k < last; ++k)
+                {
+                    uint64_t slot = frozenHashSlot(hashes[bucketKeys[k]], displacement, \
+                                                   numOfSlots);
+                    placed = !taken[slot] && \
+                             std::find(slots.begin(), slots.end(), slot) == slots.end();
+                    slots.push_back(slot);
+                }
+                if(placed)
+                {
+                    _displacements[b] = displacement;
+                    for(size_t k = first; k < last; ++k)
+                    {
+                        taken[slots[k - first]] = true;
+                        keyOfSlot[slots[k - first]] = bucketKeys[k];
+                    }
+                }
+            }
+            if(!placed)
+            {
+                throw std::runtime_error("FrozenHashMap could not place the keys");
+            }
+        }
+
+        _entries.reserve(numOfSlots + repeated.size());
+        for(uint64_t slot = 0; slot < numOfSlots; ++slot)
+        {
+            _entries.push_back(std::move(pairs[keyOfSlot[slot]]));
+        }
+        std::move(repeated.begin(), repeated.end(), std::back_inserter(_entries));
+    }
+
+    /**
+     * @return - the number of slots, the keys with a repeated hash are after them
+     */
+    size_t slotCount() const
+    {
+        return _entries.size() - _repeatedHashes.size();
+    }
+
+    /**
+     * @param hash - the mixed hash of a key
+     * @return - the only slot that may hold the key, unless its hash is repeated; the map must not
+     *           be empty
+     */
+    size_t slotOf(uint64_t hash) const
+    {
+        const uint32_t displacement = _displacements[frozenHashBucket(hash, \
+                                                                      _displacements.size())];
+        return frozenHashSlot(hash, displacement, slotCount());
+    }
+
+    /**
+     * @param hash - the mixed hash of the key
+     * @param key - a key that is not in its slot
+     * @return - pointer to the value of the key among the keys with a repeated hash, or nullptr
+     */
+    const ValueT* findRepeated(uint64_t hash, const KeyT& key) const
+    {
+        auto range = std::equal_range(_repeatedHashes.begin(), _repeatedHashes.end(), hash);
+        for(auto it = range.first; it != range.second; ++it)
+        {
+            const std::pair<KeyT, ValueT>& entry = _entries[slotCount() + \
+                                                            (it - _repeatedHashes.begin())];
+            if(entry.first == key)
+            {
+                return &entry.second;
+            }
+        }
+        return nullptr;
+    }
+
+public:
+    typedef typename std::vector<std::pair<KeyT, ValueT>>::const_iterator const_iterator;
+
+    /**
+     * Freeze the pairs of a HashMap
+     * @param map - the map to freeze
+     */
+    explicit FrozenHashMap(const HashMap<KeyT, ValueT, HashT>& map)
+    {
+        std::vector<std::pair<KeyT, ValueT>> pairs;
+        pairs.reserve(map.size());
+        const auto mapEnd = map.cend();
+        for(auto it = map.cbegin(); it != mapEnd; ++it)
+        {
+            pairs.push_back(*it);
+        }
+        build(std::move(pairs));
+    }
+
+    /**
+     * @param pairs - the pairs of the map; the keys must be distinct
+     */
+    explicit FrozenHashMap(std::vector<std::pair<KeyT, ValueT>> pairs = {})
+    {
+        build(std::move(pairs));
+    }
+
+    /**
+     * @return the number of pairs in the map
+     */
+    int size() const
+    {
+        return static_cast<int>(_entries.size());
+    }
+
+    /**
+     * @return - true if the map is empty, false otherwise.
+     */
+    bool empty() const
+    {
+        return _entries.empty();
+    }
+
+    /**
+     * @param key - key of the pair
+     * @return - pointer to the value of the key, or nullptr if the map does not contain it
+     */
+    const ValueT* find(const KeyT& key) const
+    {
+        if(_entries.empty())
+        {
+            return nullptr;
+        }
+        const uint64_t hash = frozenHashMix(_hash(key));
+        const std::pair<KeyT, ValueT>& entry = _entries[slotOf(hash)];
+        return entry.first == key ? &entry.second : findRepeated(hash, key);
+    }
+
+    /**
+     * Look up many keys at once, in chunks of HASHMAP_FIND_BATCH: hash the chunk and prefetch
+     * the displacements, then compute the slots and prefetch them, and only then compare keys.
+     * @param keys - the keys to search for
+     * @param numOfKeys - number of keys
+     * @param values - array of numOfKeys pointers, values[i] is set to the value of keys[i], or
+     *                 to nullptr if the map does not contain it
+     */
+    void findBatch(const KeyT *keys, size_t numOfKeys, const ValueT **values) const
+    {
+        if(_entries.empty())
+        {
+            std::fill(values, values + numOfKeys, nullptr);
+            return;
+        }
+        uint64_t hashes[HASHMAP_FIND_BATCH];
+        size_t slots[HASHMAP_FIND_BATCH];
+        for(size_t first = 0; first < numOfKeys; first += HASHMAP_FIND_BATCH)
+        {
+            size_t numInChunk = std::min(numOfKeys - first, size_t(HASHMAP_FIND_BATCH));
+            for(size_t i = 0; i < numInChunk; ++i)
+            {
+                hashes[i] = frozenHashMix(_hash(keys[first + i]));
+                slots[i] = frozenHashBucket(hashes[i], _displacements.size());
+                HASHMAP_PREFETCH(&_displacements[slots[i]]);
+            }
+            for(size_t i = 0; i < numInChunk; ++i)
+            {
+                slots[i] = frozenHashSlot(hashes[i], _displacements[slots[i]], slotCount());
+                HASHMAP_PREFETCH(&_entries[slots[i]]);
+            }
+            for(size_t i = 0; i < numInChunk; ++i)
+            {
+                const std::pair<KeyT, ValueT>& entry = _entries[slots[i]];
+                values[first + i] = entry.first == keys[first + i] ? &entry.second : \
+                                    findRepeated(hashes[i], keys[first + i]);
+            }
+        }
+    }
+
+    /**
+     * @param key - the key to search for
+     * @return - true if the map contains the key, false otherwise
+     */
+    bool containsKey(const KeyT& key) const
+    {
+        return find(key) != nullptr;
+    }
+
+    /**
+     * @param key - key of the pair
+     * @return - the value of that key, if exist, otherwise, will throw an exception.
+     */
+    const ValueT& at(const KeyT& key) const
+    {
+        const ValueT *value = find(key);
+        if(value == nullptr)
+        {
+            throw std::invalid_argument("at function must get a valid key");
+        }
+        return *value;
+    }
+
+    /**
+     * @param key - key of the pair
+     * @return - the value of that key, or a default value if the map does not contain it
+     */
+    ValueT operator [] (const KeyT& key) const
+    {
+        const ValueT *value = find(key);
+        return value == nullptr ? ValueT() : *value;
+    }
+
+    /**
+     * @return - bytes of the displacements and the repeated hashes, the only memory beside the
+     *           pairs themselves
+     */
+    size_t displacementBytes() const
+    {
+        return _displacements.size() * sizeof(uint32_t) + _repeatedHashes.size() * sizeof(uint64_t);
+    }
+
+    const_iterator begin() const
+    {
+        return _entries.cbegin();
+    }
+
+    const_iterator end() const
+    {
+        return _entries.cend();
+    }
+};
+
+template <typename KeyT, typename ValueT, std::size_t N>
+/**
+ * Immutable map over a small fixed set of integral keys, whose perfect hash can be built at
+ * compile time:
+ *     constexpr StaticFrozenHashMap<int, int, 3> map({1, 2, 3}, {10, 20, 30});
+ *     static_assert(map.at(2) == 20, "");
+ * @tparam KeyT - an integral type
+ * @tparam ValueT - a literal type
+ * @tparam N - the number of pairs
+ */
+class StaticFrozenHashMap
+{
+private:
+    static_assert(std::is_integral<KeyT>::value, "StaticFrozenHashMap keys must be integral");
+    static_assert(N > 0, "StaticFrozenHashMap must have at least one pair");
+    static const std::size_t numOfBuckets = N / FROZEN_HASHMAP_KEYS_PER_BUCKET + 1;
+
+    KeyT _keys[N]; /**< one slot per key */
+    ValueT _values[N]; /**< the value of every slot */
+    uint32_t _displacements[numOfBuckets]; /**< displacement of every bucket */
+
+    /**
+     * @param key - a key
+     * @return - the only slot that may hold the key
+     */
+    constexpr std::size_t slotOf(KeyT key) const
+    {
+        return frozenHashSlot(frozenHashMix(uint64_t(key)), \
+                              _displacements[frozenHashBucket(frozenHashMix(uint64_t(key)), \
+                                                              numOfBuckets)], N);
+    }
+
+public:
+    /**
+     * Build the perfect hash of the keys, as FrozenHashMap does
+     * @param keys - the keys, distinct
+     * @param values - values[i] is the value of keys[i]
+     */
+    constexpr StaticFrozenHashMap(const KeyT (&keys)[N], const ValueT (&values)[N]) :
+            _keys{}, _values{}, _displacements{}
+    {
+        uint64_t hashes[N] = {};
+        std::size_t buckets[N] = {};
+        std::size_t bucketSizes[numOfBuckets] = {};
+        for(std::size_t i = 0; i < N; ++i)
+        {
+            for(std::size_t j = 0; j < i; ++j)
+            {
+                if(keys[i] == keys[j])
+                {
+                    throw std::invalid_argument("StaticFrozenHashMap keys must be distinct");
+                }
+            }
+            hashes[i] = frozenHashMix(uint64_t(keys[i]));
+            buckets[i] = frozenHashBucket(hashes[i], numOfBuckets);
+            ++bucketSizes[buckets[i]];
+        }
+
+        bool taken[N] = {};
+        std::size_t slots[N] = {};
+        std::size_t nextFreeSlot = 0;
+        for(std::size_t size = N; size > 0; --size)
+        {
+            for(std::size_t b = 0; b < numOfBuckets; ++b)
+            {
+                if(bucketSizes[b] != size)
+                {
+                    continue;
+                }
+                bool placed = false;
+                for(uint32_t displacement = 0; !placed && \
+                    displacement < FROZEN_HASHMAP_MAX_DISPLACEMENT; ++displacement)
+                {
+                    if(size == 1)
+                    {
+                        while(taken[nextFreeSlot])
+                        {
+                            ++nextFreeSlot;
+                        }
+                        displacement = FROZEN_HASHMAP_DIRECT_SLOT | uint32_t(nextFreeSlot);
+                    }
+                    std::size_t numOfSlots = 0;
+                    placed = true;
+                    for(std::size_t i = 0; placed && i < N; ++i)
+                    {
+                        if(buckets[i] != b)
+                        {
+                            continue;
+                        }
+                        std::size_t slot = frozenHashSlot(hashes[i], displacement, N);
+                        for(std::size_t k = 0; placed && k < numOfSlots; ++k)
+                        {
+                            placed = slots[k] != slot;
+                        }
+                        placed = placed && !taken[slot];
+                        slots[numOfSlots++] = slot;
+                    }
+                    if(placed)
+                    {
+                        _displacements[b] = displacement;
+                        numOfSlots = 0;
+                        for(std::size_t i = 0; i < N; ++i)
+                        {
+                            if(buckets[i] == b)
+                            {
+                                taken[slots[numOfSlots]] = true;
+                                _keys[slots[numOfSlots]] = keys[i];
+                                _values[slots[numOfSlots]] = values[i];
+                                ++numOfSlots;
+                            }
+                        }
+                    }
+                }
+                if(!placed)
+                {
+                    throw std::invalid_argument("StaticFrozenHashMap could not place the keys");
+                }
+            }
+        }
+    }
+
+    /**
+     * @return the number of pairs in the map
+     */
+    constexpr int size() const
+    {
+        return static_cast<int>(N);
+    }
+
+    /**
+     * @param key - key of the pair
+     * @return - pointer to the value of the key, or nullptr if the map does not contain it
+     */
+    constexpr const ValueT* find(KeyT key) const
+    {
+        return _keys[slotOf(key)] == key ? &_values[slotOf(key)] : nullptr;
+    }
+
+    /**
+     * @param key - the key to search for
+     * @return - true if the map contains the key, false otherwise
+     */
+    constexpr bool containsKey(KeyT key) const
+    {
+        return _keys[slotOf(key)] == key;
+    }
+
+    /**
+     * @param key - key of the pair
+     * @return - the value of that key, if exist, otherwise, will throw an exception.
+     */
+    constexpr const ValueT& at(KeyT key) const
+    {
+        return containsKey(key) ? _values[slotOf(key)] : \
+               throw std::invalid_argument("at function must get a valid key");
+    }
+};
+
+#endif //FROZENHASHMAP_HPP
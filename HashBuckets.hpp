@@ -0,0 +1,717 @@
+//
+// The storage that HashMap, HashSet and HashMultiMap share: a cache line aligned array of
+// buckets, each a vector of elements, whose capacity is a power of 2 and is doubled or halved
+// to keep the load factor between the bounds. The containers decide what an element is and how
+// its key is found in it, and search the buckets themselves.
+//
+#ifndef HASHBUCKETS_HPP
+#define HASHBUCKETS_HPP
+
+#include <vector>
+#include <iostream>
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <cstdlib>
+#include <new>
+
+// default hash map size
+const int defaultHashMapCapacity = 16;
+
+// alignment of the bucket array, the size of a cache line
+#define HASHMAP_CACHE_LINE 64
+// number of keys that findBatch hashes and prefetches before it compares any of them
+#define HASHMAP_FIND_BATCH 16
+
+#if defined(__GNUC__) || defined(__clang__)
+#define HASHMAP_PREFETCH(address) __builtin_prefetch(address)
+#else
+#define HASHMAP_PREFETCH(address) ((void) (address))
+#endif
+
+/**
+ * The key of an element that is a (key, value) pair
+ */
+struct HashBucketsPairKey
+{
+    template <typename KeyT, typename ValueT>
+    static const KeyT& get(const std::pair<KeyT, ValueT>& pair)
+    {
+        return pair.first;
+    }
+};
+
+/**
+ * The key of an element that is only a key
+ */
+struct HashBucketsIdentityKey
+{
+    template <typename KeyT>
+    static const KeyT& get(const KeyT& key)
+    {
+        return key;
+    }
+};
+
+template <typename ElementT, typename KeyOfT, typename HashT>
+/**
+ * The buckets of a hash container, with its bounds, size and resizing
+ * @tparam ElementT - the type of element in a bucket
+ * @tparam KeyOfT - has a static get(element) that returns the key of an element
+ * @tparam HashT - the hash function of the keys
+ */
+class HashBuckets
+{
+protected:
+    double _lowerBound; /**< lower bound of the array */
+    double _upperBound; /**< upper bound ratio of the array */
+    int _capacityOfArray; /**< the capacity of the array that store the elements */
+    int _sizeOfArray; /**< the actual number of elements */
+
+    /**
+     * A bucket, padded to 32 bytes so that in the cache line aligned bucket array two buckets
+     * share a cache line and none of them straddles two
+     */
+    struct alignas(32) Bucket : std::vector<ElementT>
+    {
+    };
+
+    Bucket *_hashMap;
+    HashT _hash;
+
+    /**
+     * @param capacity - number of buckets
+     * @return - a cache line aligned array of empty buckets
+     */
+    static Bucket* allocateBuckets(int capacity)
+    {
+        void *memory = nullptr;
+        if(posix_memalign(&memory, HASHMAP_CACHE_LINE, sizeof(Bucket) * capacity) != 0)
+        {
+            throw std::bad_alloc();
+        }
+        Bucket *buckets = static_cast<Bucket *>(memory);
+        for(int i = 0; i < capacity; ++i)
+        {
+            new (&buckets[i]) Bucket();
+        }
+        return buckets;
+    }
+
+    /**
+     * Destroy and free an array of buckets that allocateBuckets returned
+     * @param buckets - the buckets, or nullptr
+     * @param capacity - number of buckets
+     */
+    static void freeBuckets(Bucket *buckets, int capacity)
+    {
+        if(buckets == nullptr)
+        {
+            return;
+        }
+        for(int i = 0; i < capacity; ++i)
+        {
+            buckets[i].~Bucket();
+        }
+        std::free(buckets);
+    }
+
+    /**
+     * @param key - a key
+     * @return - the index of the bucket of the key
+     */
+    template <typename KeyT>
+    int bucketOf(const KeyT& key) const
+    {
+        return static_cast<int>(_hash(key) & (_capacityOfArray - 1));
+    }
+
+    /**
+     * Rehash into a new bucket array by copying (or moving, when that can not throw) every
+     * element into newly allocated buckets; the old buckets are untouched until all of them are
+     * placed. Used for elements whose move may throw.
+     * @param newCapacity - the capacity after the rehash
+     */
+    void rehashInto(int newCapacity, std::false_type)
+    {
+        Bucket *newHashMap = nullptr;
+        try
+        {
+            newHashMap = allocateBuckets(newCapacity);
+
+            // every new bucket is allocated at its final size before the elements are moved
+            // into it, so a bad_alloc leaves the old buckets untouched
+            std::vector<size_t> newBucketSizes(newCapacity, 0);
+            for(int i = 0; i < _capacityOfArray; ++i)
+            {
+                for(size_t j = 0; j < _hashMap[i].size(); j++)
+                {
+                    ++newBucketSizes[_hash(KeyOfT::get(_hashMap[i][j])) & (newCapacity - 1)];
+                }
+            }
+            for(int i = 0; i < newCapacity; ++i)
+            {
+                newHashMap[i].reserve(newBucketSizes[i]);
+            }
+            for(int i = 0; i < _capacityOfArray; ++i)
+            {
+                for(size_t j = 0; j < _hashMap[i].size(); j++)
+                {
+                    int index = _hash(KeyOfT::get(_hashMap[i][j])) & (newCapacity - 1);
+                    newHashMap[index].push_back(std::move_if_noexcept(_hashMap[i][j]));
+                }
+            }
+        }
+        catch (const std::bad_alloc& e)
+        {
+            freeBuckets(newHashMap, newCapacity);
+            throw e;
+        }
+        freeBuckets(_hashMap, _capacityOfArray);
+        _hashMap = newHashMap;
+        _capacityOfArray = newCapacity;
+    }
+
+    /**
+     * Rehash into a new bucket array that takes over the storage of the old buckets. Doubling
+     * the capacity splits bucket i into buckets i and i + capacity, and halving it merges
+     * buckets i and i + capacity / 2 into bucket i, so only the elements that change bucket are
+     * moved, and a shrink does not hash at all. Used for elements that move without throwing,
+     * which includes every trivially copyable element. All the memory is reserved before the
+     * first element is moved, so a bad_alloc leaves the buckets unchanged.
+     * @param newCapacity - the capacity after the rehash
+     */
+    void rehashInto(int newCapacity, std::true_type)
+    {
+        Bucket *newHashMap = allocateBuckets(newCapacity);
+        try
+        {
+            if(newCapacity > _capacityOfArray)
+            {
+                for(int i = 0; i < _capacityOfArray; ++i)
+                {
+                    size_t numOfMoving = 0;
+                    for(const ElementT& element : _hashMap[i])
+                    {
+                        numOfMoving += (_hash(KeyOfT::get(element)) & _capacityOfArray) != 0 ? \
+                                       1 : 0;
+                    }
+                    newHashMap[i + _capacityOfArray].reserve(numOfMoving);
+                }
+            }
+            else
+            {
+                for(int i = 0; i < newCapacity; ++i)
+                {
+                    _hashMap[i].reserve(_hashMap[i].size() + _hashMap[i + newCapacity].size());
+                }
+            }
+        }
+        catch (const std::bad_alloc& e)
+        {
+            freeBuckets(newHashMap, newCapacity);
+            throw e;
+        }
+
+        if(newCapacity > _capacityOfArray)
+        {
+            for(int i = 0; i < _capacityOfArray; ++i)
+            {
+                Bucket& bucket = _hashMap[i];
+                size_t numOfStaying = 0;
+                for(size_t j = 0; j < bucket.size(); ++j)
+                {
+                    if((_hash(KeyOfT::get(bucket[j])) & _capacityOfArray) != 0)
+                    {
+                        newHashMap[i + _capacityOfArray].push_back(std::move(bucket[j]));
+                    }
+                    else
+                    {
+                        if(numOfStaying != j)
+                        {
+                            bucket[numOfStaying] = std::move(bucket[j]);
+                        }
+                        ++numOfStaying;
+                    }
+                }
+                bucket.erase(bucket.begin() + numOfStaying, bucket.end());
+                newHashMap[i] = std::move(bucket);
+            }
+        }
+        else
+        {
+            for(int i = 0; i < newCapacity; ++i)
+            {
+                Bucket& merged = _hashMap[i + newCapacity];
+                _hashMap[i].insert(_hashMap[i].end(), std::make_move_iterator(merged.begin()), \
+                                   std::make_move_iterator(merged.end()));
+                newHashMap[i] = std::move(_hashMap[i]);
+            }
+        }
+        freeBuckets(_hashMap, _capacityOfArray);
+        _hashMap = newHashMap;
+        _capacityOfArray = newCapacity;
+    }
+
+    /**
+     * Add an element to a bucket, and double the capacity if the load factor passed the upper
+     * bound
+     * @param index - the bucket of the key of the element
+     * @param element - the element to add
+     */
+    void addToBucket(int index, ElementT element)
+    {
+        _hashMap[index].push_back(std::move(element));
+        ++_sizeOfArray;
+        if(getLoadFactor() > _upperBound)
+        {
+            rehashing(true);
+        }
+    }
+
+    /**
+     * Remove an element from a bucket in O(1): the last element of the bucket takes its place,
+     * since the order inside a bucket has no meaning. Does not rehash.
+     * @param index - the bucket of the element
+     * @param position - position of the element in its bucket
+     */
+    void removeFromBucketInPlace(int index, size_t position)
+    {
+        Bucket& bucket = _hashMap[index];
+        if(position + 1 != bucket.size())
+        {
+            bucket[position] = std::move(bucket.back());
+        }
+        bucket.pop_back();
+        --_sizeOfArray;
+    }
+
+    /**
+     * Remove an element from a bucket, and halve the capacity if the load factor dropped below
+     * the lower bound
+     * @param index - the bucket of the element
+     * @param position - position of the element in its bucket
+     */
+    void removeFromBucket(int index, size_t position)
+    {
+        removeFromBucketInPlace(index, position);
+        if(getLowerBound() > getLoadFactor())
+        {
+            rehashing(false);
+        }
+    }
+
+    /**
+     * Account for elements that were removed from the buckets, and shrink once to the capacity
+     * that removing them one by one would have left
+     * @param erased - number of elements that were removed
+     */
+    void shrinkAfterErasing(int erased)
+    {
+        // removeFromBucket halves the capacity whenever the load factor drops below the lower
+        // bound
+        int newCapacity = _capacityOfArray;
+        for(int size = _sizeOfArray - 1; size >= _sizeOfArray - erased; --size)
+        {
+            if(newCapacity > 1 && double(size) / newCapacity < _lowerBound)
+            {
+                newCapacity /= 2;
+            }
+        }
+        _sizeOfArray -= erased;
+        while(_capacityOfArray > newCapacity)
+        {
+            rehashing(false);
+        }
+    }
+
+public:
+    /**
+     * Constructor that gets the lower and upper bound
+     * @param lowerBound - of the load factor
+     * @param upperBound - of the load factor
+     */
+    HashBuckets(const double lowerBound, const double upperBound) : \
+                _lowerBound(lowerBound), _upperBound(upperBound), \
+                _capacityOfArray(defaultHashMapCapacity), _sizeOfArray(0), _hashMap(nullptr)
+    {
+        if(lowerBound >= upperBound || lowerBound <= 0 || upperBound >= 1)
+        {
+            throw std::out_of_range("lowerBound < upperBound &&  lowerBound > 0 && upperBound <1");
+        }
+        _hashMap = allocateBuckets(defaultHashMapCapacity);
+    }
+
+    /**
+     * Copy constructor
+     * @param other - the buckets to copy
+     */
+    HashBuckets(const HashBuckets& other) : _lowerBound(other.getLowerBound()), \
+                                            _upperBound(other.getUpperBound()), \
+                                            _capacityOfArray(other.capacity()), \
+                                            _sizeOfArray(other.size())
+    {
+        try
+        {
+            _hashMap = allocateBuckets(other.capacity());
+        }
+        catch (const std::bad_alloc& e)
+        {
+            std::cerr << "Memory allocation failed" << std::endl;
+            throw e;
+        }
+
+        // a bucket is copied with one allocation of its exact size
+        for(int i = 0 ; i < _capacityOfArray; ++i)
+        {
+            _hashMap[i] = other._hashMap[i];
+        }
+    }
+
+    /**
+     * Move constructor
+     * @param other - the buckets to move
+     */
+    HashBuckets(HashBuckets && other) : _lowerBound(other.getLowerBound()), \
+                                        _upperBound(other.getUpperBound()), \
+                                        _capacityOfArray(other._capacityOfArray), \
+                                        _sizeOfArray(other._sizeOfArray), \
+                                        _hashMap(other._hashMap)
+    {
+        other._hashMap = nullptr;
+    }
+
+    /**
+     * overload the operator '='
+     * @param other - other buckets to 'copy'
+     * @return current buckets after the operator '=' been done.
+     */
+    HashBuckets& operator = (const HashBuckets& other)
+    {
+        if(this == &other)
+        {
+            return *this;
+        }
+        /* if current buckets and other, has different size, than delete the current and
+         * allocate new current buckets with the other size.   */
+        int otherCapacity = other.capacity();
+        if(_hashMap == nullptr || _capacityOfArray != otherCapacity)
+        {
+            Bucket *newHashMap = allocateBuckets(otherCapacity);
+            freeBuckets(_hashMap, _capacityOfArray);
+            _hashMap = newHashMap;
+            _capacityOfArray = otherCapacity;
+        }
+
+        // every bucket is replaced, and keeps its storage when it is large enough
+        for(int i = 0 ; i < otherCapacity; ++i)
+        {
+            _hashMap[i] = other._hashMap[i];
+        }
+
+        _lowerBound = other.getLowerBound();
+        _upperBound = other.getUpperBound();
+        _capacityOfArray = other.capacity();
+        _sizeOfArray = other.size();
+
+        return *this;
+    }
+
+    /**
+     * Destructor
+     */
+    ~HashBuckets()
+    {
+        freeBuckets(_hashMap, _capacityOfArray);
+    }
+
+    /**
+     *
+     * @return the lower bound of the load factor
+     */
+    const double& getLowerBound() const
+    {
+        return _lowerBound;
+    }
+
+    /**
+     *
+     * @return the upper bound of the load factor
+     */
+    const double& getUpperBound() const
+    {
+        return _upperBound;
+    }
+
+    /**
+     *
+     * @return the number of elements
+     */
+    int size() const
+    {
+        return _sizeOfArray;
+    }
+
+    /**
+     *
+     * @return - the number of buckets
+     */
+    int capacity() const
+    {
+        return _capacityOfArray;
+    }
+
+    /**
+     *
+     * @return the load factor
+     */
+    double getLoadFactor() const
+    {
+        return (double(_sizeOfArray) / _capacityOfArray);
+    }
+
+    /**
+     *
+     * @return - true if there are no elements, false otherwise.
+     */
+    bool empty() const
+    {
+        return _sizeOfArray == 0;
+    }
+
+    /**
+     * This function rehashing the buckets
+     * @param increaseTheCapacity - true if we need to increase the capacity, false if we want to
+     *                              reduce the capacity
+     */
+    void rehashing(bool increaseTheCapacity)
+    {
+        if(!increaseTheCapacity && _capacityOfArray == 1)
+        {
+            return;
+        }
+        int newCapacity = increaseTheCapacity ? _capacityOfArray * 2 : _capacityOfArray / 2;
+        rehashInto(newCapacity, std::integral_constant<bool, \
+                   std::is_nothrow_move_constructible<ElementT>::value && \
+                   std::is_nothrow_move_assignable<ElementT>::value>());
+    }
+
+    /**
+     * removing all the elements
+     */
+    void clear()
+    {
+        for(int i = 0; i < _capacityOfArray; ++i)
+        {
+            _hashMap[i].clear();
+        }
+        _sizeOfArray = 0;
+    }
+
+    /**
+     * iterator of the elements. It walks the buckets in place and allocates nothing, so it is
+     * invalidated by any change to the container, except for erase of an iterator.
+     */
+    class const_iterator
+    {
+        friend class HashBuckets;
+
+    private:
+        const Bucket *_hashMap; /**< the buckets */
+        int _capacityOfHash; /**< capacity of the hash */
+        int _bucket; /**< the bucket of the current element, _capacityOfHash at the end */
+        size_t _position; /**< position of the current element in its bucket */
+
+        /**
+         * Move to the next bucket while the current one has no element at _position
+         */
+        void skipEmptyBuckets()
+        {
+            while(_bucket < _capacityOfHash && _position == _hashMap[_bucket].size())
+            {
+                ++_bucket;
+                _position = 0;
+            }
+        }
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = ElementT;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const ElementT*;
+        using reference = const ElementT&;
+
+        /**
+         * Constructor of iterator
+         * @param hashMap - the array of buckets
+         * @param capacityOfHash - the number of buckets
+         * @param bucket - the bucket to start from, capacityOfHash for the end
+         * @param position - the position in the bucket to start from
+         */
+        const_iterator(const Bucket *hashMap = nullptr, \
+                       int capacityOfHash = 0, int bucket = 0, size_t position = 0) : \
+                       _hashMap(hashMap), _capacityOfHash(capacityOfHash), _bucket(bucket), \
+                       _position(position)
+        {
+            skipEmptyBuckets();
+        }
+
+        /**
+         *
+         * @return - the element that the iterator is pointing to.
+         */
+        const ElementT& operator * () const
+        {
+            return _hashMap[_bucket][_position];
+        }
+
+        /**
+         *
+         * @return - The Address of the element that the iterator is pointing to.
+         */
+        const ElementT* operator -> () const
+        {
+            if(_bucket == _capacityOfHash)
+            {
+                return nullptr;
+            }
+            return &(_hashMap[_bucket][_position]);
+        }
+
+        /**
+         * prefix increment operator - '++i'
+         * @return current iterator after '++'
+         */
+        const_iterator& operator++()
+        {
+            ++_position;
+            skipEmptyBuckets();
+            return *this;
+        }
+
+        /**
+         * postfix increment operator - 'i++'
+         * @return the iterator before '++'
+         */
+        const_iterator operator++(int)
+        {
+            const_iterator tmp = *this;
+            ++*this;
+            return tmp;
+        }
+
+        /**
+         *
+         * @param other - other iterator
+         * @return - true, if both iterator pointing to the same element, false otherwise
+         */
+        bool operator == (const_iterator const& other) const
+        {
+            return _hashMap == other._hashMap && _bucket == other._bucket && \
+                   _position == other._position;
+        }
+
+        /**
+         * overload the operator '!='
+         * @param other - other iterator
+         * @return - false, if both iterator pointing to the same element, true otherwise
+         */
+        bool operator != (const_iterator const&other) const
+        {
+            return !operator==(other);
+        }
+
+    };
+
+
+    /**
+     * Erase the element of an iterator, in O(1) and without searching for its key. The capacity
+     * is not changed, so the walk can go on from the returned iterator; the following erases
+     * of keys, and eraseIf, halve it as usual.
+     * @param it - iterator of an element, not the end
+     * @return - iterator of the next element of the walk; the elements that were not visited
+     *           yet are all visited from it
+     */
+    const_iterator erase(const_iterator it)
+    {
+        removeFromBucketInPlace(it._bucket, it._position);
+        // the last element of the bucket took the place of the erased one, and was not visited
+        return const_iterator(_hashMap, _capacityOfArray, it._bucket, it._position);
+    }
+
+    /**
+     * Erase every element that pred returns true for, in one walk over the buckets and without
+     * searching for any key, and then shrink once to the capacity that erasing them one by one
+     * would have left
+     * @param pred - function that gets a const reference to an element
+     * @return - the number of elements that were erased
+     */
+    template <typename Pred>
+    int eraseIf(const Pred& pred)
+    {
+        int erased = 0;
+        for(int i = 0; i < _capacityOfArray; ++i)
+        {
+            Bucket& bucket = _hashMap[i];
+            size_t position = 0;
+            while(position < bucket.size())
+            {
+                if(pred(static_cast<const ElementT&>(bucket[position])))
+                {
+                    if(position + 1 != bucket.size())
+                    {
+                        bucket[position] = std::move(bucket.back());
+                    }
+                    bucket.pop_back();
+                    ++erased;
+                }
+                else
+                {
+                    ++position;
+                }
+            }
+        }
+        shrinkAfterErasing(erased);
+        return erased;
+    }
+
+    /**
+     * const version
+     * @return the start of the iterator
+     */
+    const_iterator begin() const
+    {
+        return const_iterator(_hashMap, _capacityOfArray, 0);
+    }
+
+    /**
+     * const version
+     * @return the start of the iterator
+     */
+    const_iterator cbegin() const
+    {
+        return const_iterator(_hashMap, _capacityOfArray, 0);
+    }
+
+    /**
+     * const version
+     * @return return iterator of last+1
+     */
+    const_iterator end() const
+    {
+        return const_iterator(_hashMap, _capacityOfArray, _capacityOfArray);
+    }
+
+    /**
+     * const version
+     * @return return iterator of last+1
+     */
+    const_iterator cend() const
+    {
+        return const_iterator(_hashMap, _capacityOfArray, _capacityOfArray);
+    }
+};
+
+#endif //HASHBUCKETS_HPP
@@ -1,244 +1,678 @@
+#ifndef HASHMAP_HPP
+#define HASHMAP_HPP
+
 #include <vector>
 #include <assert.h>
 #include <iostream>
+#include <algorithm>
+#include <exception>
+#include <thread>
+#include <iterator>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <type_traits>
+#include "HashBuckets.hpp"
+
+#define HASHMAP_IMAGE_MAGIC "HMAP"
+#define HASHMAP_IMAGE_VERSION 1
+#define HASHMAP_IMAGE_TRIVIAL 1
+#define HASHMAP_IMAGE_STRING 2
+// number of entries that save and load convert at once
+#define HASHMAP_IMAGE_CHUNK 4096
+// bytes of bucket offsets or string data that load reads at once
+#define HASHMAP_IMAGE_READ_CHUNK (1 << 20)
 
-// default hash map size
-const int defaultHashMapCapacity = 16;
+/**
+ * Header of a HashMap image, as HashMap::save writes it. The header is followed by capacity + 1
+ * uint64_t bucket offsets (the index of the first entry of every bucket, and size at the end),
+ * then blobSize bytes of string data, and then size entries, the key slot and then the value slot
+ * of every entry, in bucket order. The image is in the byte order and layout of the host, and its
+ * bucket placement is valid only for the same hash function.
+ */
+struct HashMapImageHeader
+{
+    char magic[4]; /**< HASHMAP_IMAGE_MAGIC */
+    uint32_t version; /**< version of the image format */
+    uint32_t keyKind; /**< HASHMAP_IMAGE_TRIVIAL or HASHMAP_IMAGE_STRING */
+    uint32_t valueKind; /**< HASHMAP_IMAGE_TRIVIAL or HASHMAP_IMAGE_STRING */
+    uint32_t keySlotSize; /**< bytes of the slot of a key */
+    uint32_t valueSlotSize; /**< bytes of the slot of a value */
+    double lowerBound; /**< lower bound of the load factor */
+    double upperBound; /**< upper bound of the load factor */
+    uint64_t capacity; /**< number of buckets */
+    uint64_t size; /**< number of entries */
+    uint64_t blobSize; /**< bytes of string data */
+};
 
-template <typename KeyT, typename ValueT>
 /**
- * This class represent a generic Hash Map
- * @tparam KeyT - the type of key in the hash map
- * @tparam ValueT - the type of value in the hashMap
+ * Check the parts of an image header that do not depend on the types of the map
+ * @param header - the header
+ * @return - true if the magic, version, bounds, capacity and size are valid, false otherwise
  */
-class HashMap
+inline bool isValidHashMapImageHeader(const HashMapImageHeader& header)
 {
-private:
-    double _lowerBound; /**< lower bound of the array */
-    double _upperBound; /**< upper bound ratio of the array */
-    int _capacityOfArray; /**< the capacity of the array that store the hashMap */
-    int _sizeOfArray; /**< the actual number of items in the hashMap */
-    std::vector<std::pair<KeyT, ValueT>> *_hashMap;
-    std::hash<KeyT> _hash;
+    return std::memcmp(header.magic, HASHMAP_IMAGE_MAGIC, sizeof(header.magic)) == 0 && \
+           header.version == HASHMAP_IMAGE_VERSION && header.lowerBound > 0 && \
+           header.lowerBound < header.upperBound && header.upperBound < 1 && \
+           header.capacity > 0 && header.capacity <= (uint64_t(1) << 30) && \
+           (header.capacity & (header.capacity - 1)) == 0 && \
+           header.size < (uint64_t(1) << 31) && \
+           double(header.size) <= header.capacity * header.upperBound;
+}
 
-public:
-    /**
-     * Default constructor + constructor that gets the lower and upper bound
-     * @param lowerBound - of the hashMap
-     * @param upperBound - of the hashMap
-     */
-    HashMap(const double lowerBound = (1.0 / 4), const double upperBound = (3.0 / 4)) :
-                                                     _lowerBound(lowerBound), \
-                                                     _upperBound(upperBound), \
-                                                     _capacityOfArray(defaultHashMapCapacity), \
-                                                     _sizeOfArray(0)
+/**
+ * Read an array of an image in chunks of HASHMAP_IMAGE_READ_CHUNK bytes, so the memory grows
+ * only as the data arrives and a corrupted count fails at the end of the stream
+ * @param in - the stream to read from
+ * @param count - number of elements to read
+ * @param array - vector or string that is filled with the elements
+ * @return - true if all the elements were read, false if the stream ended first
+ */
+template <typename Array>
+inline bool readHashMapImageArray(std::istream& in, uint64_t count, Array& array)
+{
+    typedef typename Array::value_type T;
+    const uint64_t chunk = HASHMAP_IMAGE_READ_CHUNK / sizeof(T);
+    array.clear();
+    while(array.size() < count)
     {
-        if(lowerBound >= upperBound || lowerBound <= 0 || upperBound >= 1)
+        const size_t first = array.size();
+        array.resize(first + std::min<uint64_t>(chunk, count - first));
+        if(!in.read(reinterpret_cast<char *>(&array[first]), (array.size() - first) * sizeof(T)))
         {
-            throw std::out_of_range("lowerBound < upperBound &&  lowerBound > 0 && upperBound <1");
-        }
-        try
-        {
-            _hashMap = new std::vector<std::pair<KeyT, ValueT>>[defaultHashMapCapacity];
-        }
-        catch (const std::bad_alloc& e)
-        {
-            throw e;
+            return false;
         }
+    }
+    return true;
+}
 
-    };
+/**
+ * The way a key or a value is stored in a HashMap image. A trivially copyable type is stored as
+ * its bytes; other types are not supported.
+ * @tparam T - the type of the key or the value
+ */
+template <typename T, typename Enable = void>
+struct HashMapImageField;
+
+template <typename T>
+struct HashMapImageField<T, typename std::enable_if<std::is_trivially_copyable<T>::value>::type>
+{
+    static const uint32_t kind = HASHMAP_IMAGE_TRIVIAL;
+    static const uint32_t slotSize = sizeof(T);
 
     /**
-     * Constructor that gets two vector, and creating hashMap which key[i] -> value[i]
-     * @param keysVector
-     * @param valueVector
+     * @return - the bytes of string data of the value, none
      */
-    HashMap(std::vector<KeyT> keysVector, std::vector<ValueT> valueVector) : HashMap()
+    static uint64_t blobSize(const T&)
     {
-        if(keysVector.size() != valueVector.size())
+        return 0;
+    }
+
+    static void writeBlob(std::ostream&, const T&)
+    {
+    }
+
+    /**
+     * Write the slot of the value
+     * @param slot - slotSize bytes
+     * @param value - the value
+     * @param blobOffset - offset of the string data of the value, it is not changed
+     */
+    static void writeSlot(char *slot, const T& value, uint64_t&)
+    {
+        std::memcpy(slot, &value, sizeof(T));
+    }
+
+    /**
+     * Read the value of a slot
+     * @param slot - slotSize bytes
+     * @param value - the value that was read
+     * @return - true, a slot of bytes is always valid
+     */
+    static bool readSlot(const char *slot, const char *, uint64_t, T& value)
+    {
+        std::memcpy(&value, slot, sizeof(T));
+        return true;
+    }
+};
+
+/**
+ * A string is stored as its offset and its length in the string data of the image
+ */
+template <>
+struct HashMapImageField<std::string>
+{
+    static const uint32_t kind = HASHMAP_IMAGE_STRING;
+    static const uint32_t slotSize = 2 * sizeof(uint64_t);
+
+    static uint64_t blobSize(const std::string& value)
+    {
+        return value.length();
+    }
+
+    static void writeBlob(std::ostream& out, const std::string& value)
+    {
+        out.write(value.data(), value.length());
+    }
+
+    static void writeSlot(char *slot, const std::string& value, uint64_t& blobOffset)
+    {
+        uint64_t length = value.length();
+        std::memcpy(slot, &blobOffset, sizeof(uint64_t));
+        std::memcpy(slot + sizeof(uint64_t), &length, sizeof(uint64_t));
+        blobOffset += length;
+    }
+
+    /**
+     * Read the offset and the length of a string slot
+     * @param slot - slotSize bytes
+     * @param blobSize - bytes of string data of the image
+     * @param offset - the offset of the string
+     * @param length - the length of the string
+     * @return - true if the string is inside the string data, false otherwise
+     */
+    static bool readRange(const char *slot, uint64_t blobSize, uint64_t& offset, uint64_t& length)
+    {
+        std::memcpy(&offset, slot, sizeof(uint64_t));
+        std::memcpy(&length, slot + sizeof(uint64_t), sizeof(uint64_t));
+        return offset <= blobSize && length <= blobSize - offset;
+    }
+
+    static bool readSlot(const char *slot, const char *blob, uint64_t blobSize, std::string& value)
+    {
+        uint64_t offset = 0;
+        uint64_t length = 0;
+        if(!readRange(slot, blobSize, offset, length))
         {
-            throw std::invalid_argument("vector are from different sizes");
+            return false;
         }
-        for(int i = 0; i < keysVector.size(); i ++)
+        value.assign(blob + offset, length);
+        return true;
+    }
+};
+
+/**
+ * Joins the threads of a vector when it goes out of scope, so the threads that were started are
+ * joined even when starting the next one, or the work of the calling thread, throws.
+ */
+class ThreadJoiner
+{
+private:
+    std::vector<std::thread>& _threads;
+
+public:
+    /**
+     * @param threads - the threads to join; may grow after the joiner is made
+     */
+    explicit ThreadJoiner(std::vector<std::thread>& threads) : _threads(threads)
+    {
+    }
+
+    ThreadJoiner(const ThreadJoiner&) = delete;
+    ThreadJoiner& operator=(const ThreadJoiner&) = delete;
+
+    ~ThreadJoiner()
+    {
+        for(std::thread& thread : _threads)
         {
-            insert(keysVector[i], valueVector[i]);
-            // override the key - value if exist.
-            at(keysVector[i]) = valueVector[i];
+            if(thread.joinable())
+            {
+                thread.join();
+            }
         }
     }
+};
+
+template <typename KeyT, typename ValueT, typename HashT = std::hash<KeyT>>
+/**
+ * This class represent a generic Hash Map
+ * @tparam KeyT - the type of key in the hash map
+ * @tparam ValueT - the type of value in the hashMap
+ * @tparam HashT - the hash function of the keys
+ */
+class HashMap : public HashBuckets<std::pair<KeyT, ValueT>, HashBucketsPairKey, HashT>
+{
+private:
+    typedef HashBuckets<std::pair<KeyT, ValueT>, HashBucketsPairKey, HashT> Buckets;
+    typedef typename Buckets::Bucket Bucket;
+    using Buckets::_lowerBound;
+    using Buckets::_upperBound;
+    using Buckets::_capacityOfArray;
+    using Buckets::_sizeOfArray;
+    using Buckets::_hashMap;
+    using Buckets::_hash;
+    using Buckets::allocateBuckets;
+    using Buckets::freeBuckets;
+    using Buckets::bucketOf;
+    using Buckets::addToBucket;
+    using Buckets::removeFromBucket;
+    using Buckets::shrinkAfterErasing;
 
     /**
-     *
-     * @return the lower bound of the hashMap
+     * @param bucket - bucket of the hashMap
+     * @param key - key
+     * @return - true if there is a pair with that key in the bucket, false otherwise
      */
-    const double& getLowerBound() const
+    static bool bucketContains(const std::vector<std::pair<KeyT, ValueT>>& bucket, \
+                               const KeyT& key)
     {
-        return _lowerBound;
+        for(size_t i = 0; i < bucket.size(); ++i)
+        {
+            if(bucket[i].first == key)
+            {
+                return true;
+            }
+        }
+        return false;
     }
 
     /**
-     *
-     * @return the upper bound of the array
+     * @param key - key
+     * @return - pointer to the value of the key, or nullptr if there is no such key
      */
-    const double& getUpperBound() const
+    const ValueT* findValue(const KeyT& key) const
     {
-        return _upperBound;
+        const std::vector<std::pair<KeyT, ValueT>>& bucket = \
+                                                    _hashMap[_hash(key) & (_capacityOfArray - 1)];
+        for(size_t i = 0; i < bucket.size(); ++i)
+        {
+            if(bucket[i].first == key)
+            {
+                return &bucket[i].second;
+            }
+        }
+        return nullptr;
     }
 
     /**
-     * Copy constructor
-     * @param other - other hashMap to copy
+     * Look up the keys in chunks of HASHMAP_FIND_BATCH: hash the whole chunk and prefetch its
+     * buckets, then prefetch the pairs of the buckets, and only then compare the keys, so the
+     * cache misses of the chunk overlap instead of following each other.
+     * @param keys - the keys to search for
+     * @param numOfKeys - number of keys
+     * @param store - function that gets the position of a key and a pointer to its value, or
+     *                nullptr if there is no such key
      */
-    HashMap(const HashMap& other) : _lowerBound(other.getLowerBound()), \
-                                    _upperBound(other.getUpperBound()), \
-                                    _capacityOfArray(other.capacity()), \
-                                    _sizeOfArray(other.size())
+    template <typename Store>
+    void findBatchWith(const KeyT *keys, size_t numOfKeys, const Store& store) const
     {
-        /* if current hashMap and other, has different size, than delete the current and allocate
-         * new current hashMap with the other size.   */
-        try
+        if(_hashMap == nullptr)
         {
-            _hashMap = new std::vector<std::pair<KeyT, ValueT>>[other.capacity()];
+            for(size_t i = 0; i < numOfKeys; ++i)
+            {
+                store(i, nullptr);
+            }
+            return;
         }
-        catch (const std::bad_alloc& e)
+        const Bucket *buckets[HASHMAP_FIND_BATCH];
+        for(size_t first = 0; first < numOfKeys; first += HASHMAP_FIND_BATCH)
         {
-            std::cerr << "Memory allocation failed" << std::endl;
-            throw e;
+            size_t numInChunk = std::min(numOfKeys - first, size_t(HASHMAP_FIND_BATCH));
+            for(size_t i = 0; i < numInChunk; ++i)
+            {
+                buckets[i] = &_hashMap[_hash(keys[first + i]) & (_capacityOfArray - 1)];
+                HASHMAP_PREFETCH(buckets[i]);
+            }
+            for(size_t i = 0; i < numInChunk; ++i)
+            {
+                HASHMAP_PREFETCH(buckets[i]->data());
+            }
+            for(size_t i = 0; i < numInChunk; ++i)
+            {
+                const ValueT *value = nullptr;
+                for(const std::pair<KeyT, ValueT>& pair : *buckets[i])
+                {
+                    if(pair.first == keys[first + i])
+                    {
+                        value = &pair.second;
+                        break;
+                    }
+                }
+                store(first + i, value);
+            }
         }
+    }
 
-        for(int i = 0 ; i < _capacityOfArray; ++i)
+    /**
+     * Run func(0), ..., func(numOfThreads - 1), each call on its own thread (the last one on the
+     * calling thread), and wait for all of them, also when starting a thread or the call on the
+     * calling thread throws.
+     * @param func - function that gets the number of the thread
+     * @param numOfThreads - number of threads to use
+     */
+    template <typename Func>
+    static void runOnThreads(const Func& func, int numOfThreads)
+    {
+        std::vector<std::thread> threads;
+        threads.reserve(numOfThreads - 1);
+        ThreadJoiner joiner(threads);
+        for(int thread = 0; thread < numOfThreads - 1; ++thread)
         {
-            std::copy(other._hashMap[i].begin(), other._hashMap[i].end(), \
-                      back_inserter(_hashMap[i]));
+            threads.emplace_back(func, thread);
         }
-
+        func(numOfThreads - 1);
     }
 
     /**
-     * Move constructor
-     * @param other - other object of type HashMap
+     * @param numOfThreads - number of threads that were asked for
+     * @return - the number of threads to split the buckets between, at least 1 and at most one
+     *           per bucket
      */
-    HashMap(HashMap && other) : _lowerBound(other.getLowerBound()), \
-                                _upperBound(other.getUpperBound()), \
-                                _capacityOfArray(other._capacityOfArray), \
-                                _sizeOfArray(other._sizeOfArray), \
-                                _hashMap(std::move(other._hashMap))
+    int threadsForBuckets(int numOfThreads) const
     {
-       other._hashMap = nullptr;
+        return std::max(1, std::min(numOfThreads, _capacityOfArray));
     }
 
-
     /**
-     *
-     * @return the size of the HashMap
+     * Split the buckets into numOfThreads ranges and call func(thread, firstBucket, lastBucket)
+     * for every range on its own thread. The first exception that a call threw is rethrown once
+     * all the calls are done.
+     * @param func - function that gets the number of the thread and a range of buckets
+     * @param numOfThreads - number of threads, as threadsForBuckets returned it
      */
-    int size() const
+    template <typename Func>
+    void runOnBucketRanges(const Func& func, int numOfThreads) const
     {
-        return _sizeOfArray;
+        std::vector<std::exception_ptr> errors(numOfThreads);
+        runOnThreads([&](int thread)
+                     {
+                         int firstBucket = static_cast<int>(long(_capacityOfArray) * thread / \
+                                                            numOfThreads);
+                         int lastBucket = static_cast<int>(long(_capacityOfArray) * \
+                                                           (thread + 1) / numOfThreads);
+                         try
+                         {
+                             func(thread, firstBucket, lastBucket);
+                         }
+                         catch (...)
+                         {
+                             errors[thread] = std::current_exception();
+                         }
+                     }, numOfThreads);
+        for(const std::exception_ptr& error : errors)
+        {
+            if(error)
+            {
+                std::rethrow_exception(error);
+            }
+        }
     }
 
+public:
+    using Buckets::erase;
+    using Buckets::eraseIf;
+
     /**
-     *
-     * @return - the capacity of the HashMap
+     * Default constructor + constructor that gets the lower and upper bound
+     * @param lowerBound - of the hashMap
+     * @param upperBound - of the hashMap
      */
-    int capacity() const
+    HashMap(const double lowerBound = (1.0 / 4), const double upperBound = (3.0 / 4)) : \
+            Buckets(lowerBound, upperBound)
     {
-        return _capacityOfArray;
     }
 
     /**
-     *
-     * @return the load factor of the hashMap
+     * Constructor that gets two vector, and creating hashMap which key[i] -> value[i]
+     * @param keysVector
+     * @param valueVector
      */
-    double getLoadFactor() const
+    HashMap(const std::vector<KeyT>& keysVector, const std::vector<ValueT>& valueVector) : \
+            HashMap()
     {
-        return (double(_sizeOfArray) / _capacityOfArray);
+        if(keysVector.size() != valueVector.size())
+        {
+            throw std::invalid_argument("vector are from different sizes");
+        }
+        for(int i = 0; i < keysVector.size(); i ++)
+        {
+            insert(keysVector[i], valueVector[i]);
+            // override the key - value if exist.
+            at(keysVector[i]) = valueVector[i];
+        }
     }
 
     /**
-     *
-     * @return - true if the HashMap is empty, false otherwise.
+     * Insert (key, value) to the HashMap
+     * @param key - the key to insert
+     * @param value - the value to insert
+     * @return - true if insert succeed, false otherwise.
      */
-    bool empty()
+    bool insert(const KeyT& key, const ValueT& value)
     {
-        return _sizeOfArray == 0;
-    }
 
+        int index = _hash(key) & (_capacityOfArray - 1);
+
+        // iterate over the vector to check if there is already such key in the hashTable.
+        if(bucketContains(_hashMap[index], key))
+        {
+            return false;
+        }
+        addToBucket(index, std::pair<KeyT, ValueT>(key, value));
+        return true;
+    }
 
     /**
-     * This function rehashing the HashMap
-     * @param cutTheCapacityByHalf - true if we need to increase the capacity, false if we want to
-     *                               reduce the capacity
+     * Insert all the given pairs to the HashMap using several threads. The HashMap is resized
+     * once up front and every thread fills its own range of buckets, so the result is the same
+     * as inserting the pairs one by one in their order (for equal keys the first pair wins).
+     * The pairs are first grouped by the thread of their bucket with a counting sort that keeps
+     * their order, so every thread walks only its own pairs.
+     * @param pairs - the pairs to insert, moved into the HashMap
+     * @param numOfThreads - number of threads to use
+     * @return - the number of pairs that were inserted
      */
-    void rehashing(bool increaseTheCapacity)
+    int bulkInsert(std::vector<std::pair<KeyT, ValueT>> pairs, int numOfThreads)
     {
-        int newCapacity = _capacityOfArray;
-        if(increaseTheCapacity)
+        const size_t numOfPairs = pairs.size();
+        numOfThreads = std::max(1, std::min(numOfThreads, static_cast<int>(numOfPairs)));
+        int capacityBefore = _capacityOfArray;
+        while(double(_sizeOfArray + numOfPairs) / _capacityOfArray > _upperBound)
         {
-            newCapacity *= 2;
+            this->rehashing(true);
         }
-        else
+
+        auto threadOfBucket = [&](int index)
+        {
+            return static_cast<int>(long(index) * numOfThreads / _capacityOfArray);
+        };
+        auto sliceOf = [&](int thread, size_t& first, size_t& last)
         {
+            first = numOfPairs * thread / numOfThreads;
+            last = numOfPairs * (thread + 1) / numOfThreads;
+        };
 
-            newCapacity /= 2;
+        // counts[slice * numOfThreads + thread] is the number of pairs of the slice that go to
+        // the thread, and then the position in sorted of the next of them
+        std::vector<int> indexes(numOfPairs);
+        std::vector<size_t> counts(size_t(numOfThreads) * numOfThreads, 0);
+        auto hashSlice = [&](int slice)
+        {
+            size_t first = 0;
+            size_t last = 0;
+            sliceOf(slice, first, last);
+            std::vector<size_t> sliceCounts(numOfThreads, 0);
+            for(size_t i = first; i < last; ++i)
+            {
+                indexes[i] = _hash(pairs[i].first) & (_capacityOfArray - 1);
+                ++sliceCounts[threadOfBucket(indexes[i])];
+            }
+            std::copy(sliceCounts.begin(), sliceCounts.end(), \
+                      counts.begin() + size_t(slice) * numOfThreads);
+        };
+        runOnThreads(hashSlice, numOfThreads);
+
+        std::vector<size_t> threadStarts(numOfThreads + 1, 0);
+        size_t position = 0;
+        for(int thread = 0; thread < numOfThreads; ++thread)
+        {
+            threadStarts[thread] = position;
+            for(int slice = 0; slice < numOfThreads; ++slice)
+            {
+                size_t count = counts[size_t(slice) * numOfThreads + thread];
+                counts[size_t(slice) * numOfThreads + thread] = position;
+                position += count;
+            }
         }
+        threadStarts[numOfThreads] = position;
 
-        std::vector<std::pair<KeyT, ValueT>> * newHashMap = nullptr;
-        try
+        std::vector<size_t> sorted(numOfPairs);
+        auto sortSlice = [&](int slice)
         {
-            newHashMap = new std::vector<std::pair<KeyT, ValueT>>[newCapacity];
+            size_t first = 0;
+            size_t last = 0;
+            sliceOf(slice, first, last);
+            size_t *next = counts.data() + size_t(slice) * numOfThreads;
+            for(size_t i = first; i < last; ++i)
+            {
+                sorted[next[threadOfBucket(indexes[i])]++] = i;
+            }
+        };
+        runOnThreads(sortSlice, numOfThreads);
 
-            for(int i = 0; i < _capacityOfArray; ++i)
+        std::vector<int> numOfInserted(numOfThreads, 0);
+        std::vector<std::exception_ptr> errors(numOfThreads);
+        auto fillBuckets = [&](int thread)
+        {
+            int inserted = 0;
+            try
             {
-                for(size_t j = 0; j < _hashMap[i].size(); j++)
+                for(size_t k = threadStarts[thread]; k < threadStarts[thread + 1]; ++k)
                 {
-                    int index = _hash(_hashMap[i][j].first) & (newCapacity - 1);
-                    newHashMap[index].push_back(\
-                        std::pair<KeyT, ValueT> (_hashMap[i][j].first, _hashMap[i][j].second));
+                    size_t i = sorted[k];
+                    int index = indexes[i];
+                    if(bucketContains(_hashMap[index], pairs[i].first))
+                    {
+                        continue;
+                    }
+                    _hashMap[index].push_back(std::move(pairs[i]));
+                    ++inserted;
                 }
             }
+            catch (...)
+            {
+                errors[thread] = std::current_exception();
+            }
+            numOfInserted[thread] = inserted;
+        };
+        runOnThreads(fillBuckets, numOfThreads);
 
-            delete[] _hashMap;
-            _hashMap = newHashMap;
-            _capacityOfArray = newCapacity;
+        int inserted = 0;
+        for(int count : numOfInserted)
+        {
+            inserted += count;
         }
-        catch (const std::bad_alloc& e)
+        // the pairs that the other threads inserted stay in the HashMap if one of them threw
+        _sizeOfArray += inserted;
+        for(const std::exception_ptr& error : errors)
         {
-            delete[] newHashMap;
-            throw e;
+            if(error)
+            {
+                std::rethrow_exception(error);
+            }
+        }
+
+        // equal keys may leave the HashMap bigger than inserting one by one would
+        while(_capacityOfArray > capacityBefore && \
+              double(_sizeOfArray) / (_capacityOfArray / 2) <= _upperBound)
+        {
+            this->rehashing(false);
         }
+        return inserted;
     }
 
     /**
-     * Insert (key, value) to the HashMap
-     * @param key - the key to insert
-     * @param value - the value to insert
-     * @return - true if insert succeed, false otherwise.
+     * Call func on every pair of the HashMap, using several threads that each visit their own
+     * range of buckets. The calls of different threads run concurrently and in no given order.
+     * @param func - function that gets a const reference to a pair
+     * @param numOfThreads - number of threads to use
      */
-    bool insert(KeyT key, ValueT value)
+    template <typename Func>
+    void parallelForEach(const Func& func, int numOfThreads) const
     {
+        runOnBucketRanges([&](int, int firstBucket, int lastBucket)
+                          {
+                              for(int i = firstBucket; i < lastBucket; ++i)
+                              {
+                                  for(const std::pair<KeyT, ValueT>& pair : _hashMap[i])
+                                  {
+                                      func(pair);
+                                  }
+                              }
+                          }, threadsForBuckets(numOfThreads));
+    }
 
-        int index = _hash(key) & (_capacityOfArray - 1);
-
-        // iterate over the vector to check if there is already such key in the hashTable.
-        if(containsKey(key))
+    /**
+     * Map every pair of the HashMap to a value and reduce the values to one, using several
+     * threads that each reduce their own range of buckets; the results of the threads are then
+     * reduced in order. reduce must be associative and identity must be neutral to it.
+     * @param identity - the result for an empty HashMap
+     * @param map - function that gets a const reference to a pair and returns a T
+     * @param reduce - function that gets two T and returns their reduction
+     * @param numOfThreads - number of threads to use
+     * @return - the reduction of all the mapped pairs
+     */
+    template <typename T, typename MapFunc, typename ReduceFunc>
+    T parallelReduce(const T& identity, const MapFunc& map, const ReduceFunc& reduce, \
+                     int numOfThreads) const
+    {
+        numOfThreads = threadsForBuckets(numOfThreads);
+        std::vector<T> results(numOfThreads, identity);
+        runOnBucketRanges([&](int thread, int firstBucket, int lastBucket)
+                          {
+                              T result = identity;
+                              for(int i = firstBucket; i < lastBucket; ++i)
+                              {
+                                  for(const std::pair<KeyT, ValueT>& pair : _hashMap[i])
+                                  {
+                                      result = reduce(result, map(pair));
+                                  }
+                              }
+                              results[thread] = std::move(result);
+                          }, numOfThreads);
+        T result = identity;
+        for(const T& threadResult : results)
         {
-            return false;
+            result = reduce(result, threadResult);
         }
-        _hashMap[index].push_back(std::pair<KeyT, ValueT>(key, value));
-        ++_sizeOfArray;
-        if(getLoadFactor() > _upperBound)
+        return result;
+    }
+
+    /**
+     * Erase every pair that pred returns true for, using several threads that each filter their
+     * own range of buckets. The HashMap is then shrunk once to the capacity that erasing the
+     * pairs one by one would have left.
+     * @param pred - function that gets a const reference to a pair, called concurrently
+     * @param numOfThreads - number of threads to use
+     * @return - the number of pairs that were erased
+     */
+    template <typename Pred>
+    int eraseIf(const Pred& pred, int numOfThreads)
+    {
+        numOfThreads = threadsForBuckets(numOfThreads);
+        std::vector<int> numOfErased(numOfThreads, 0);
+        runOnBucketRanges([&](int thread, int firstBucket, int lastBucket)
+                          {
+                              for(int i = firstBucket; i < lastBucket; ++i)
+                              {
+                                  auto newEnd = std::remove_if(_hashMap[i].begin(), \
+                                                               _hashMap[i].end(), pred);
+                                  numOfErased[thread] += static_cast<int>(\
+                                                             _hashMap[i].end() - newEnd);
+                                  _hashMap[i].erase(newEnd, _hashMap[i].end());
+                              }
+                          }, numOfThreads);
+
+        int erased = 0;
+        for(int count : numOfErased)
         {
-            try
-            {
-                rehashing(true);
-            }
-            catch (const std::bad_alloc& e)
-            {
-                throw e;
-            }
+            erased += count;
         }
-        return true;
+        shrinkAfterErasing(erased);
+        return erased;
     }
 
     /**
@@ -246,17 +680,9 @@ public:
      * @param key - key
      * @return - true if there is already such key in the HashMap, false otherwise
      */
-    bool containsKey(KeyT key) const
+    bool containsKey(const KeyT& key) const
     {
-        int index = _hash(key) & (_capacityOfArray - 1);
-        for(size_t i = 0; i < _hashMap[index].size(); ++i)
-        {
-            if(_hashMap[index][i].first == key)
-            {
-                return true;
-            }
-        }
-        return false;
+        return findValue(key) != nullptr;
     }
 
     /**
@@ -307,108 +733,229 @@ public:
     }
 
     /**
-     *  erase the pair with that key from the HashSet
-     * @param key - key of the pair
-     * @return - true if succeed to delete the pair with that key from the HashSet, false otherwise
+     * Look up many keys at once. Faster than a call to containsKey or at per key when the
+     * hashMap does not fit in the cache, since the lookups of nearby keys overlap.
+     * @param keys - the keys to search for
+     * @param numOfKeys - number of keys
+     * @param values - array of numOfKeys pointers, values[i] is set to the value of keys[i], or
+     *                 to nullptr if there is no such key. The pointers are valid until the
+     *                 hashMap changes.
      */
-    bool erase(KeyT key)
+    void findBatch(const KeyT *keys, size_t numOfKeys, const ValueT **values) const
     {
-        if(!containsKey(key))
+        findBatchWith(keys, numOfKeys, [values](size_t i, const ValueT *value)
         {
-            return false;
-        }
+            values[i] = value;
+        });
+    }
 
-        int index = _hash(key) & (_capacityOfArray - 1);
-        for(int i = 0; i < _hashMap[index].size(); ++i)
+    /**
+     * Non const version of findBatch.
+     * @param keys - the keys to search for
+     * @param numOfKeys - number of keys
+     * @param values - array of numOfKeys pointers, values[i] is set to the value of keys[i], or
+     *                 to nullptr if there is no such key
+     */
+    void findBatch(const KeyT *keys, size_t numOfKeys, ValueT **values)
+    {
+        findBatchWith(keys, numOfKeys, [values](size_t i, const ValueT *value)
         {
-            if((_hashMap[index])[i].first == key)
+            values[i] = const_cast<ValueT *>(value);
+        });
+    }
+
+    /**
+     * Write the HashMap as a binary image: its bounds, its capacity and the placement of every
+     * pair in the buckets, so load restores it without rehashing. Keys and values must be
+     * trivially copyable or std::string.
+     * @param out - the stream to write to, opened in binary mode
+     * @return - true if all the image was written, false otherwise
+     */
+    bool save(std::ostream& out) const
+    {
+        typedef HashMapImageField<KeyT> KeyField;
+        typedef HashMapImageField<ValueT> ValueField;
+        HashMapImageHeader header = {};
+        std::memcpy(header.magic, HASHMAP_IMAGE_MAGIC, sizeof(header.magic));
+        header.version = HASHMAP_IMAGE_VERSION;
+        header.keyKind = KeyField::kind;
+        header.valueKind = ValueField::kind;
+        header.keySlotSize = KeyField::slotSize;
+        header.valueSlotSize = ValueField::slotSize;
+        header.lowerBound = _lowerBound;
+        header.upperBound = _upperBound;
+        header.capacity = static_cast<uint64_t>(_capacityOfArray);
+        header.size = static_cast<uint64_t>(_sizeOfArray);
+
+        std::vector<uint64_t> bucketOffsets(_capacityOfArray + 1, 0);
+        for(int i = 0; i < _capacityOfArray; ++i)
+        {
+            bucketOffsets[i + 1] = bucketOffsets[i] + _hashMap[i].size();
+            for(const std::pair<KeyT, ValueT>& pair : _hashMap[i])
             {
-                _hashMap[index].erase(_hashMap[index].begin() + i);
-                break;
+                header.blobSize += KeyField::blobSize(pair.first) + \
+                                   ValueField::blobSize(pair.second);
             }
         }
-
-        --_sizeOfArray;
-        if(getLowerBound() > getLoadFactor())
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char *>(bucketOffsets.data()), \
+                  bucketOffsets.size() * sizeof(uint64_t));
+        for(int i = 0; i < _capacityOfArray; ++i)
         {
-            try
+            for(const std::pair<KeyT, ValueT>& pair : _hashMap[i])
             {
-                rehashing(false);
+                KeyField::writeBlob(out, pair.first);
+                ValueField::writeBlob(out, pair.second);
             }
-            catch (const std::bad_alloc& e)
+        }
+
+        const size_t entrySize = KeyField::slotSize + ValueField::slotSize;
+        std::vector<char> entries;
+        entries.reserve(HASHMAP_IMAGE_CHUNK * entrySize);
+        uint64_t blobOffset = 0;
+        for(int i = 0; i < _capacityOfArray; ++i)
+        {
+            for(const std::pair<KeyT, ValueT>& pair : _hashMap[i])
             {
-                throw e;
+                entries.resize(entries.size() + entrySize);
+                char *entry = entries.data() + entries.size() - entrySize;
+                KeyField::writeSlot(entry, pair.first, blobOffset);
+                ValueField::writeSlot(entry + KeyField::slotSize, pair.second, blobOffset);
+                if(entries.size() == HASHMAP_IMAGE_CHUNK * entrySize)
+                {
+                    out.write(entries.data(), entries.size());
+                    entries.clear();
+                }
             }
         }
-        return true;
+        out.write(entries.data(), entries.size());
+        return static_cast<bool>(out);
     }
 
     /**
-     *
-     * @param key - the key within the bucket we want
-     * @return - the size of the bucket which the key is with in
+     * Replace the content of the HashMap with an image that save wrote. Every bucket is
+     * allocated once at its final size, and the pairs are placed in it as they were saved. If
+     * the image is invalid the HashMap is left unchanged.
+     * @param in - the stream to read from, opened in binary mode
      */
-    int bucketSize(KeyT key) const
+    void load(std::istream& in)
     {
-        if(!containsKey(key))
+        typedef HashMapImageField<KeyT> KeyField;
+        typedef HashMapImageField<ValueT> ValueField;
+        HashMapImageHeader header = {};
+        in.read(reinterpret_cast<char *>(&header), sizeof(header));
+        if(!in || !isValidHashMapImageHeader(header) || header.keyKind != KeyField::kind || \
+           header.valueKind != ValueField::kind || header.keySlotSize != KeyField::slotSize || \
+           header.valueSlotSize != ValueField::slotSize)
         {
-            throw std::invalid_argument("bucketSize function must get a valid key");
+            throw std::invalid_argument("not a HashMap image of this type");
         }
 
-        int index = _hash(key) & (_capacityOfArray - 1);
-        return static_cast<int>(_hashMap[index].size());
-    }
+        std::vector<uint64_t> bucketOffsets;
+        bool validOffsets = readHashMapImageArray(in, header.capacity + 1, bucketOffsets) && \
+                            bucketOffsets[0] == 0 && \
+                            bucketOffsets[header.capacity] == header.size;
+        for(uint64_t i = 0; validOffsets && i < header.capacity; ++i)
+        {
+            validOffsets = bucketOffsets[i] <= bucketOffsets[i + 1];
+        }
+        if(!validOffsets)
+        {
+            throw std::invalid_argument("HashMap image has invalid bucket offsets");
+        }
+        std::string blob;
+        if(!readHashMapImageArray(in, header.blobSize, blob))
+        {
+            throw std::invalid_argument("HashMap image is truncated or corrupted");
+        }
 
-    /**
-     * removing all the elements from the HashSet
-     */
-    void clear()
-    {
-        for(int i = 0; i < _capacityOfArray; ++i)
+        const int newCapacity = static_cast<int>(header.capacity);
+        const size_t entrySize = KeyField::slotSize + ValueField::slotSize;
+        Bucket *newHashMap = nullptr;
+        try
         {
-            _hashMap[i].clear();
+            newHashMap = allocateBuckets(newCapacity);
+            std::vector<char> entries(HASHMAP_IMAGE_CHUNK * entrySize);
+            uint64_t entryIndex = 0;
+            for(int i = 0; i < newCapacity && in; ++i)
+            {
+                newHashMap[i].reserve(bucketOffsets[i + 1] - bucketOffsets[i]);
+                for(uint64_t j = bucketOffsets[i]; j < bucketOffsets[i + 1]; ++j, ++entryIndex)
+                {
+                    if(entryIndex % HASHMAP_IMAGE_CHUNK == 0)
+                    {
+                        uint64_t chunk = std::min<uint64_t>(HASHMAP_IMAGE_CHUNK, \
+                                                            header.size - entryIndex);
+                        if(!in.read(entries.data(), chunk * entrySize))
+                        {
+                            break;
+                        }
+                    }
+                    const char *entry = entries.data() + \
+                                        (entryIndex % HASHMAP_IMAGE_CHUNK) * entrySize;
+                    newHashMap[i].emplace_back();
+                    if(!KeyField::readSlot(entry, blob.data(), header.blobSize, \
+                                           newHashMap[i].back().first) || \
+                       !ValueField::readSlot(entry + KeyField::slotSize, blob.data(), \
+                                             header.blobSize, newHashMap[i].back().second))
+                    {
+                        in.setstate(std::ios::failbit);
+                        break;
+                    }
+                }
+            }
+            if(!in)
+            {
+                throw std::invalid_argument("HashMap image is truncated or corrupted");
+            }
+        }
+        catch (...)
+        {
+            freeBuckets(newHashMap, newCapacity);
+            throw;
         }
-        _sizeOfArray = 0;
+
+        freeBuckets(_hashMap, _capacityOfArray);
+        _hashMap = newHashMap;
+        _lowerBound = header.lowerBound;
+        _upperBound = header.upperBound;
+        _capacityOfArray = newCapacity;
+        _sizeOfArray = static_cast<int>(header.size);
     }
 
     /**
-     * overload the operator '='
-     * @param other - other HashMap to 'copy'
-     * @return current HashMap after the operator '=' been done.
+     *  erase the pair with that key from the HashSet
+     * @param key - key of the pair
+     * @return - true if succeed to delete the pair with that key from the HashSet, false otherwise
      */
-    HashMap& operator = (const HashMap& other)
+    bool erase(const KeyT& key)
     {
-        /* if current hashMap and other, has different size, than delete the current and allocate
-         * new current hashMap with the other size.   */
-        int otherCapacity = other.capacity();
-        if(_capacityOfArray != otherCapacity)
+        int index = _hash(key) & (_capacityOfArray - 1);
+        for(size_t i = 0; i < _hashMap[index].size(); ++i)
         {
-            delete[] _hashMap;
-            try
-            {
-                _hashMap = new std::vector<std::pair<KeyT, ValueT>>[otherCapacity];
-            }
-            catch (const std::bad_alloc& e)
+            if((_hashMap[index])[i].first == key)
             {
-                throw e;
+                removeFromBucket(index, i);
+                return true;
             }
-            _capacityOfArray = otherCapacity;
         }
+        return false;
+    }
 
-        _sizeOfArray = other.size();
-
-        for(int i = 0 ; i < otherCapacity; ++i)
+    /**
+     *
+     * @param key - the key within the bucket we want
+     * @return - the size of the bucket which the key is with in
+     */
+    int bucketSize(const KeyT& key) const
+    {
+        if(!containsKey(key))
         {
-            std::copy(other._hashMap[i].begin(), \
-                      other._hashMap[i].end(), back_inserter(_hashMap[i]));
+            throw std::invalid_argument("bucketSize function must get a valid key");
         }
 
-        _lowerBound = other.getLowerBound();
-        _upperBound = other.getUpperBound();
-        _capacityOfArray = other.capacity();
-        _sizeOfArray = other.size();
-
-        return *this;
+        int index = _hash(key) & (_capacityOfArray - 1);
+        return static_cast<int>(_hashMap[index].size());
     }
 
     /**
@@ -419,16 +966,10 @@ public:
      */
     ValueT& operator [] (const KeyT& key) noexcept
     {
-        try
-        {
-            at(key);
-        }
-        catch (std::exception)
+        if(!containsKey(key))
         {
             // insert the key with some value
             insert(key, ValueT());
-            return at(key);
-
         }
         return at(key);
     }
@@ -440,15 +981,12 @@ public:
      */
     ValueT operator [] (const KeyT& key) const noexcept
     {
-        try
-        {
-            at(key);
-        }
-        catch (std::invalid_argument)
+        const ValueT* value = findValue(key);
+        if(value == nullptr)
         {
             return ValueT();
         }
-        return at(key);
+        return *value;
     }
 
     /**
@@ -464,17 +1002,11 @@ public:
             return false;
         }
 
-        std::pair<KeyT, ValueT> *arrOfAllTheItemsCurr = begin().getAllThePairs();
-        for (auto it = this->cbegin(); it != this->cend(); ++it)
+        const auto thisEnd = this->cend();
+        for (auto it = this->cbegin(); it != thisEnd; ++it)
         {
-            try
-            {
-                if(other.at(it->first) != this->at(it->first))
-                {
-                    return false;
-                }
-            }
-            catch(std::invalid_argument)
+            const ValueT* otherValue = other.findValue(it->first);
+            if(otherValue == nullptr || *otherValue != it->second)
             {
                 return false;
             }
@@ -493,202 +1025,6 @@ public:
         return !operator==(other);
     }
 
-    /**
-     * Destructor
-     */
-    ~HashMap()
-    {
-        delete[] _hashMap;
-    }
-
-    /**
-     * iterator of the hashMap
-     */
-    class const_iterator
-    {
-    private:
-        std::vector<std::pair<KeyT, ValueT>> *_hashMap; /**< the hashMap to iterate on */
-        std::pair<KeyT, ValueT> *_arrOfAllTheItems; /**< array of all the pairs in the hashMap */
-        int _currentLocation; /**< current location in the _arrOfAllTheItems */
-        int _capacityOfHash; /**< capacity of the hash */
-        int _endLocation = 0; /**< end location of the hashMap */
-
-    public:
-        /**
-         * Constructor of iterator
-         * @param hashMap - the array of vector of pairs that the HashMap uses
-         * @param sizeOfHashMap - The number of pairs in the HashMap
-         * @param capacityOfHash - The Capacity of the HashMap
-         */
-        const_iterator(std::vector<std::pair<KeyT, ValueT>> *hashMap = nullptr, \
-                       int sizeOfHashMap = 0, int capacityOfHash = 0, int currentLocation = 0) : \
-                       _hashMap(hashMap)
-        {
-            int index = 0;
-            _capacityOfHash = capacityOfHash;
-            _arrOfAllTheItems = new std::pair<KeyT, ValueT>[sizeOfHashMap];
-            for(int i = 0; i < capacityOfHash; ++i)
-            {
-                if(_hashMap[i].size() == 0)
-                {
-                    continue;
-                }
-                for(size_t j = 0; j < _hashMap[i].size(); j++)
-                {
-                    _arrOfAllTheItems[index] = _hashMap[i][j];
-                    ++index;
-                }
-            }
-            _currentLocation = currentLocation;
-            if(currentLocation == sizeOfHashMap)
-            {
-                _currentLocation = index;
-            }
-            _endLocation = index;
-        };
-
-        /**
-         * Copy constructor
-         * @param other - other iterator to copy.
-         */
-        const_iterator(const const_iterator& other)
-        {
-            _hashMap = other._hashMap;
-            _currentLocation = other._currentLocation;
-            _arrOfAllTheItems = new std::pair<KeyT, ValueT>[other._capacityOfHash];
-            for(int i = 0; i < other._endLocation; ++i)
-            {
-                _arrOfAllTheItems[i] = other._arrOfAllTheItems[i];
-            }
-            _currentLocation = other._currentLocation;
-            _endLocation = other._endLocation;
-        }
-
-        /**
-         *
-         * @return - the pair that the iterator is pointing to.
-         */
-        const std::pair<KeyT, ValueT>& operator * () const
-        {
-            return _arrOfAllTheItems[_currentLocation];
-        }
-
-        /**
-         *
-         * @return - The Address of the pair that the iterator is pointing to.
-         */
-        std::pair<KeyT, ValueT>* operator -> () const
-        {
-            if(_currentLocation == _capacityOfHash)
-            {
-                return nullptr;
-            }
-            return &(_arrOfAllTheItems[_currentLocation]);
-        }
-
-        /**
-         * prefix increment operator - '++i'
-         * @return current iterator after '++'
-         */
-        const_iterator& operator++()
-        {
-            ++_currentLocation;
-            return *this;
-        }
-
-        /**
-         * postfix increment operator - 'i++'
-         * @return
-         */
-        const_iterator& operator++(int)
-        {
-            const_iterator tmp = *this;
-            ++_currentLocation;
-            return *this;
-        }
-
-        /**
-         *
-         * @param other - other iterator
-         * @return - true, if both iterator pointing to the same pair, false otherwise
-         */
-        bool operator == (const_iterator const& other) const
-        {
-            if((_currentLocation == other._currentLocation) && (_currentLocation == _endLocation) \
-               && _currentLocation == other._endLocation)
-            {
-                return true;
-            }
-            if(_currentLocation != other._currentLocation || _endLocation != other._endLocation)
-            {
-                return false;
-            }
-            return _arrOfAllTheItems[_currentLocation] == \
-                                               other._arrOfAllTheItems[other._currentLocation];
-        }
-
-        /**
-         * overload the operator '!='
-         * @param other - other iterator
-         * @return - false, if both iterator pointing to the same pair, true otherwise
-         */
-        bool operator != (const_iterator const&other) const
-        {
-            return !operator==(other);
-        }
-
-        /**
-         * use this as helper function in overload the operator '==' and '!=' in HashMap
-         * @return
-         */
-        std::pair<KeyT, ValueT> *getAllThePairs() const
-        {
-            return _arrOfAllTheItems;
-        }
-
-        /**
-         * Destructor
-         */
-        ~const_iterator(){delete[] _arrOfAllTheItems; }
-
-    };
-
-
-    /**
-     * const version
-     * @return the start of the iterator
-     */
-    const_iterator begin() const
-    {
-        return const_iterator(_hashMap, _sizeOfArray, _capacityOfArray);
-    }
-
-    /**
-     * const version
-     * @return the start of the iterator
-     */
-    const_iterator cbegin() const
-    {
-        return const_iterator(_hashMap, _sizeOfArray, _capacityOfArray);
-    }
-
-    /**
-     * const version
-     * @return return iterator of last+1
-     */
-    const_iterator end() const
-    {
-        return const_iterator(_hashMap, _sizeOfArray, _capacityOfArray, _sizeOfArray);
-    }
-
-    /**
-     * const version
-     * @return return iterator of last+1
-     */
-    const_iterator cend() const
-    {
-        return const_iterator(_hashMap, _sizeOfArray, _capacityOfArray, _sizeOfArray);
-    }
-
-
 };
+
+#endif //HASHMAP_HPP
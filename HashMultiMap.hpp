@@ -0,0 +1,131 @@
+//
+// A map from a key to any number of values, on the buckets that HashMap uses. Every value is a
+// pair of its own in the bucket of its key, so a key with many values needs no vector of its
+// own, and all the values of a key are in one bucket.
+//
+#ifndef HASHMULTIMAP_HPP
+#define HASHMULTIMAP_HPP
+
+#include "HashBuckets.hpp"
+#include <functional>
+
+template <typename KeyT, typename ValueT, typename HashT = std::hash<KeyT>>
+/**
+ * This class represent a generic Hash Multi Map. The size is the number of (key, value) pairs,
+ * and the load factor counts the pairs, so many values for one key make a long bucket.
+ * @tparam KeyT - the type of key in the map
+ * @tparam ValueT - the type of value in the map
+ * @tparam HashT - the hash function of the keys
+ */
+class HashMultiMap : public HashBuckets<std::pair<KeyT, ValueT>, HashBucketsPairKey, HashT>
+{
+private:
+    typedef HashBuckets<std::pair<KeyT, ValueT>, HashBucketsPairKey, HashT> Buckets;
+    using Buckets::_hashMap;
+    using Buckets::bucketOf;
+    using Buckets::addToBucket;
+    using Buckets::shrinkAfterErasing;
+
+public:
+    using Buckets::erase;
+
+    /**
+     * Default constructor + constructor that gets the lower and upper bound
+     * @param lowerBound - of the map
+     * @param upperBound - of the map
+     */
+    HashMultiMap(const double lowerBound = (1.0 / 4), const double upperBound = (3.0 / 4)) : \
+                 Buckets(lowerBound, upperBound)
+    {
+    }
+
+    /**
+     * Insert (key, value) to the map, also if the key already has values
+     * @param key - the key to insert
+     * @param value - the value to insert
+     */
+    void insert(const KeyT& key, const ValueT& value)
+    {
+        addToBucket(bucketOf(key), std::pair<KeyT, ValueT>(key, value));
+    }
+
+    /**
+     * @param key - the key to search for
+     * @return - the number of values of the key
+     */
+    int count(const KeyT& key) const
+    {
+        if(_hashMap == nullptr)
+        {
+            return 0;
+        }
+        int numOfValues = 0;
+        for(const std::pair<KeyT, ValueT>& pair : _hashMap[bucketOf(key)])
+        {
+            numOfValues += pair.first == key ? 1 : 0;
+        }
+        return numOfValues;
+    }
+
+    /**
+     * @param key - the key to search for
+     * @return - true if the key has at least one value, false otherwise
+     */
+    bool containsKey(const KeyT& key) const
+    {
+        if(_hashMap == nullptr)
+        {
+            return false;
+        }
+        for(const std::pair<KeyT, ValueT>& pair : _hashMap[bucketOf(key)])
+        {
+            if(pair.first == key)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Call func on every value of the key. The map must not change during the calls.
+     * @param key - the key
+     * @param func - function that gets a const reference to a value
+     */
+    template <typename Func>
+    void forEachValue(const KeyT& key, const Func& func) const
+    {
+        if(_hashMap == nullptr)
+        {
+            return;
+        }
+        for(const std::pair<KeyT, ValueT>& pair : _hashMap[bucketOf(key)])
+        {
+            if(pair.first == key)
+            {
+                func(pair.second);
+            }
+        }
+    }
+
+    /**
+     * erase all the values of the key
+     * @param key - the key to erase
+     * @return - the number of values that were erased
+     */
+    int erase(const KeyT& key)
+    {
+        auto& bucket = _hashMap[bucketOf(key)];
+        auto newEnd = std::remove_if(bucket.begin(), bucket.end(), \
+                                     [&key](const std::pair<KeyT, ValueT>& pair)
+                                     {
+                                         return pair.first == key;
+                                     });
+        int erased = static_cast<int>(bucket.end() - newEnd);
+        bucket.erase(newEnd, bucket.end());
+        shrinkAfterErasing(erased);
+        return erased;
+    }
+};
+
+#endif //HASHMULTIMAP_HPP
@@ -0,0 +1,166 @@
+//
+// A set of keys on the buckets that HashMap uses. A bucket holds only the keys, so the set
+// stores no values.
+//
+#ifndef HASHSET_HPP
+#define HASHSET_HPP
+
+#include "HashBuckets.hpp"
+#include <functional>
+
+template <typename KeyT, typename HashT = std::hash<KeyT>>
+/**
+ * This class represent a generic Hash Set
+ * @tparam KeyT - the type of key in the set
+ * @tparam HashT - the hash function of the keys
+ */
+class HashSet : public HashBuckets<KeyT, HashBucketsIdentityKey, HashT>
+{
+private:
+    typedef HashBuckets<KeyT, HashBucketsIdentityKey, HashT> Buckets;
+    using Buckets::_capacityOfArray;
+    using Buckets::_sizeOfArray;
+    using Buckets::_lowerBound;
+    using Buckets::_upperBound;
+    using Buckets::_hashMap;
+    using Buckets::bucketOf;
+    using Buckets::addToBucket;
+    using Buckets::removeFromBucket;
+
+    /**
+     * @param index - bucket of the key
+     * @param key - key
+     * @return - the position of the key in the bucket, or the size of the bucket if it is not
+     *           there
+     */
+    size_t positionInBucket(int index, const KeyT& key) const
+    {
+        size_t position = 0;
+        while(position < _hashMap[index].size() && !(_hashMap[index][position] == key))
+        {
+            ++position;
+        }
+        return position;
+    }
+
+public:
+    using Buckets::erase;
+
+    /**
+     * Default constructor + constructor that gets the lower and upper bound
+     * @param lowerBound - of the set
+     * @param upperBound - of the set
+     */
+    HashSet(const double lowerBound = (1.0 / 4), const double upperBound = (3.0 / 4)) : \
+            Buckets(lowerBound, upperBound)
+    {
+    }
+
+    /**
+     * Constructor that gets a vector of keys; equal keys are inserted once
+     * @param keysVector - the keys of the set
+     */
+    explicit HashSet(const std::vector<KeyT>& keysVector) : HashSet()
+    {
+        for(const KeyT& key : keysVector)
+        {
+            insert(key);
+        }
+    }
+
+    /**
+     * Insert a key to the set
+     * @param key - the key to insert
+     * @return - true if insert succeed, false if the set already contains the key.
+     */
+    bool insert(const KeyT& key)
+    {
+        int index = bucketOf(key);
+        if(positionInBucket(index, key) != _hashMap[index].size())
+        {
+            return false;
+        }
+        addToBucket(index, key);
+        return true;
+    }
+
+    /**
+     * @param key - the key to search for
+     * @return - true if the set contains the key, false otherwise
+     */
+    bool containsKey(const KeyT& key) const
+    {
+        if(_hashMap == nullptr)
+        {
+            return false;
+        }
+        int index = bucketOf(key);
+        return positionInBucket(index, key) != _hashMap[index].size();
+    }
+
+    /**
+     * erase the key from the set
+     * @param key - the key to erase
+     * @return - true if succeed to erase the key from the set, false otherwise
+     */
+    bool erase(const KeyT& key)
+    {
+        int index = bucketOf(key);
+        size_t position = positionInBucket(index, key);
+        if(position == _hashMap[index].size())
+        {
+            return false;
+        }
+        removeFromBucket(index, position);
+        return true;
+    }
+
+    /**
+     *
+     * @param key - the key within the bucket we want
+     * @return - the size of the bucket which the key is with in
+     */
+    int bucketSize(const KeyT& key) const
+    {
+        if(!containsKey(key))
+        {
+            throw std::invalid_argument("bucketSize function must get a valid key");
+        }
+        return static_cast<int>(_hashMap[bucketOf(key)].size());
+    }
+
+    /**
+     * Checking if this set is the same as other set
+     * @param other - set
+     * @return true if this and other set are equal, false otherwise.
+     */
+    bool operator == (const HashSet& other) const
+    {
+        if(_sizeOfArray != other.size() || _capacityOfArray != other.capacity() || \
+           _lowerBound != other.getLowerBound() || _upperBound != other.getUpperBound())
+        {
+            return false;
+        }
+        const auto thisEnd = this->cend();
+        for(auto it = this->cbegin(); it != thisEnd; ++it)
+        {
+            if(!other.containsKey(*it))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Checking if this set is different from other set
+     * @param other - set
+     * @return - true if this and other set are not equal, false otherwise.
+     */
+    bool operator != (const HashSet& other) const
+    {
+        return !operator==(other);
+    }
+};
+
+#endif //HASHSET_HPP
@@ -0,0 +1,369 @@
+//
+// A bounded cache on HashMap. The entries are kept in one array and linked from the most to the
+// least recently used by indexes stored in the entries themselves, and a HashMap maps every key
+// to its entry. When the cache goes over its budget of entries or bytes, the least recently
+// used entries are evicted, each in O(1). Entries may also expire a given time after they were
+// inserted.
+//
+#ifndef LRUHASHMAP_HPP
+#define LRUHASHMAP_HPP
+
+#include "HashMap.hpp"
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+// the index of no entry, at the ends of the recency list and of the free list
+#define LRU_HASHMAP_NONE std::numeric_limits<uint32_t>::max()
+
+template <typename KeyT, typename ValueT, typename HashT = std::hash<KeyT>, \
+          typename ClockT = std::chrono::steady_clock>
+/**
+ * A map that keeps at most maxEntries pairs and at most maxBytes bytes of pairs, and evicts the
+ * least recently used pairs to stay within both. A pair is used when it is inserted or found.
+ * With a time to live, a pair expires that long after it was inserted; an expired pair is never
+ * found, and is removed when it is looked up or evicted.
+ * @tparam KeyT - the type of key in the map
+ * @tparam ValueT - the type of value in the map
+ * @tparam HashT - the hash function of the keys
+ * @tparam ClockT - the clock of the time to live, with a static now()
+ */
+class LruHashMap
+{
+private:
+    typedef typename ClockT::time_point TimePoint;
+    typedef typename ClockT::duration Duration;
+
+    /**
+     * a pair of the map and its links in the recency list
+     */
+    struct Entry
+    {
+        KeyT key; /**< the key */
+        ValueT value; /**< the value */
+        std::size_t bytes; /**< what the pair costs in the bytes budget */
+        TimePoint expiresAt; /**< when the pair expires, if the map has a time to live */
+        uint32_t newer; /**< the next more recently used entry, or the next free entry */
+        uint32_t older; /**< the next less recently used entry */
+    };
+
+    std::size_t _maxEntries; /**< the most pairs the map keeps */
+    std::size_t _maxBytes; /**< the most bytes of pairs the map keeps */
+    Duration _timeToLive; /**< how long a pair lives, zero for ever */
+    std::vector<Entry> _entries; /**< the entries, used and free */
+    HashMap<KeyT, uint32_t, HashT> _index; /**< the entry of every key */
+    uint32_t _newest; /**< the most recently used entry */
+    uint32_t _oldest; /**< the least recently used entry */
+    uint32_t _free; /**< the first free entry */
+    std::size_t _bytes; /**< the bytes of the pairs in the map */
+    unsigned long _hits; /**< number of lookups that found a pair */
+    unsigned long _misses; /**< number of lookups that did not find a pair */
+    unsigned long _evictions; /**< number of pairs evicted to stay within the budget */
+    unsigned long _expirations; /**< number of pairs removed because they expired */
+
+    /**
+     * Take an entry out of the recency list
+     * @param i - the entry
+     */
+    void unlink(uint32_t i)
+    {
+        Entry& entry = _entries[i];
+        (entry.newer == LRU_HASHMAP_NONE ? _newest : _entries[entry.newer].older) = entry.older;
+        (entry.older == LRU_HASHMAP_NONE ? _oldest : _entries[entry.older].newer) = entry.newer;
+    }
+
+    /**
+     * Put an entry at the head of the recency list
+     * @param i - the entry
+     */
+    void linkAsNewest(uint32_t i)
+    {
+        Entry& entry = _entries[i];
+        entry.newer = LRU_HASHMAP_NONE;
+        entry.older = _newest;
+        (_newest == LRU_HASHMAP_NONE ? _oldest : _entries[_newest].newer) = i;
+        _newest = i;
+    }
+
+    /**
+     * Remove an entry from the map and put it in the free list
+     * @param i - the entry
+     */
+    void removeEntry(uint32_t i)
+    {
+        unlink(i);
+        _index.erase(_entries[i].key);
+        _bytes -= _entries[i].bytes;
+        _entries[i].value = ValueT();
+        _entries[i].newer = _free;
+        _free = i;
+    }
+
+    /**
+     * @param i - a used entry
+     * @return - true if the entry expired, false otherwise
+     */
+    bool expired(uint32_t i) const
+    {
+        return _timeToLive != Duration::zero() && ClockT::now() >= _entries[i].expiresAt;
+    }
+
+    /**
+     * Evict the least recently used entries until the map is within its budget, keeping at
+     * least the newest entry
+     */
+    void evictOverBudget()
+    {
+        while(_oldest != _newest && (size() > _maxEntries || _bytes > _maxBytes))
+        {
+            if(expired(_oldest))
+            {
+                ++_expirations;
+            }
+            else
+            {
+                ++_evictions;
+            }
+            removeEntry(_oldest);
+        }
+    }
+
+    /**
+     * @param key - a key
+     * @return - the entry of the key, or LRU_HASHMAP_NONE if the map does not have it. An
+     *           expired entry is removed.
+     */
+    uint32_t findEntry(const KeyT& key)
+    {
+        if(!_index.containsKey(key))
+        {
+            return LRU_HASHMAP_NONE;
+        }
+        uint32_t i = _index.at(key);
+        if(expired(i))
+        {
+            ++_expirations;
+            removeEntry(i);
+            return LRU_HASHMAP_NONE;
+        }
+        return i;
+    }
+
+public:
+    /**
+     * Constructor
+     * @param maxEntries - the most pairs the map keeps, at least 1
+     * @param maxBytes - the most bytes of pairs the map keeps, counted as the insert calls give
+     *                   them; no limit by default
+     * @param timeToLive - how long a pair lives after it is inserted, zero (the default) for ever
+     */
+    explicit LruHashMap(std::size_t maxEntries, \
+                        std::size_t maxBytes = std::numeric_limits<std::size_t>::max(), \
+                        Duration timeToLive = Duration::zero()) : \
+                        _maxEntries(maxEntries), _maxBytes(maxBytes), _timeToLive(timeToLive), \
+                        _newest(LRU_HASHMAP_NONE), _oldest(LRU_HASHMAP_NONE), \
+                        _free(LRU_HASHMAP_NONE), _bytes(0), _hits(0), _misses(0), \
+                        _evictions(0), _expirations(0)
+    {
+        if(maxEntries == 0 || maxEntries >= LRU_HASHMAP_NONE)
+        {
+            throw std::out_of_range("maxEntries must be positive and fit 32 bits");
+        }
+        if(timeToLive < Duration::zero())
+        {
+            throw std::out_of_range("timeToLive must not be negative");
+        }
+    }
+
+    /**
+     * Insert (key, value) as the most recently used pair, replacing the value if the key is
+     * already in the map, and evict the least recently used pairs that go over the budget. The
+     * new pair itself is never evicted, also if it is bigger than maxBytes alone.
+     * @param key - the key to insert
+     * @param value - the value to insert
+     * @param bytes - what the pair costs in the bytes budget; by default the size of a key and
+     *                a value
+     * @return - true if the key was not in the map, false if its value was replaced
+     */
+    bool insert(const KeyT& key, const ValueT& value, \
+                std::size_t bytes = sizeof(KeyT) + sizeof(ValueT))
+    {
+        const TimePoint expiresAt = _timeToLive != Duration::zero() ? \
+                                    ClockT::now() + _timeToLive : TimePoint();
+        uint32_t i = findEntry(key);
+        const bool isNew = i == LRU_HASHMAP_NONE;
+        if(isNew)
+        {
+            if(_free != LRU_HASHMAP_NONE)
+            {
+                i = _free;
+                _free = _entries[i].newer;
+                _entries[i].key = key;
+                _entries[i].value = value;
+            }
+            else
+            {
+                i = static_cast<uint32_t>(_entries.size());
+                _entries.push_back({key, value, 0, TimePoint(), LRU_HASHMAP_NONE, \
+                                    LRU_HASHMAP_NONE});
+            }
+            _index.insert(key, i);
+        }
+        else
+        {
+            unlink(i);
+            _bytes -= _entries[i].bytes;
+            _entries[i].value = value;
+        }
+        _entries[i].bytes = bytes;
+        _entries[i].expiresAt = expiresAt;
+        _bytes += bytes;
+        linkAsNewest(i);
+        evictOverBudget();
+        return isNew;
+    }
+
+    /**
+     * Look a key up and make its pair the most recently used, counting a hit or a miss
+     * @param key - key of the pair
+     * @return - pointer to the value of the key, or nullptr if the map does not have it. The
+     *           pointer is valid until the map changes.
+     */
+    ValueT* find(const KeyT& key)
+    {
+        uint32_t i = findEntry(key);
+        if(i == LRU_HASHMAP_NONE)
+        {
+            ++_misses;
+            return nullptr;
+        }
+        ++_hits;
+        unlink(i);
+        linkAsNewest(i);
+        return &_entries[i].value;
+    }
+
+    /**
+     * Look a key up without using its pair and without counting the lookup
+     * @param key - key of the pair
+     * @return - pointer to the value of the key, or nullptr if the map does not have it or it
+     *           expired. The pointer is valid until the map changes.
+     */
+    const ValueT* peek(const KeyT& key) const
+    {
+        if(!_index.containsKey(key))
+        {
+            return nullptr;
+        }
+        uint32_t i = _index.at(key);
+        return expired(i) ? nullptr : &_entries[i].value;
+    }
+
+    /**
+     * @param key - the key to search for
+     * @return - true if the map has the key and it did not expire, false otherwise
+     */
+    bool containsKey(const KeyT& key) const
+    {
+        return peek(key) != nullptr;
+    }
+
+    /**
+     * erase the pair with that key from the map
+     * @param key - key of the pair
+     * @return - true if the map had the key, false otherwise
+     */
+    bool erase(const KeyT& key)
+    {
+        uint32_t i = findEntry(key);
+        if(i == LRU_HASHMAP_NONE)
+        {
+            return false;
+        }
+        removeEntry(i);
+        return true;
+    }
+
+    /**
+     * removing all the pairs from the map; the counters are kept
+     */
+    void clear()
+    {
+        _entries.clear();
+        _index.clear();
+        _newest = LRU_HASHMAP_NONE;
+        _oldest = LRU_HASHMAP_NONE;
+        _free = LRU_HASHMAP_NONE;
+        _bytes = 0;
+    }
+
+    /**
+     * Call func on every pair, from the least to the most recently used. Expired pairs that
+     * were not removed yet are skipped.
+     * @param func - function that gets a const reference to a key and to its value
+     */
+    template <typename Func>
+    void forEachFromOldest(const Func& func) const
+    {
+        for(uint32_t i = _oldest; i != LRU_HASHMAP_NONE; i = _entries[i].newer)
+        {
+            if(!expired(i))
+            {
+                func(_entries[i].key, _entries[i].value);
+            }
+        }
+    }
+
+    /**
+     * @return the number of pairs in the map, including expired pairs that were not removed yet
+     */
+    std::size_t size() const
+    {
+        return static_cast<std::size_t>(_index.size());
+    }
+
+    /**
+     * @return the bytes of the pairs in the map
+     */
+    std::size_t bytes() const
+    {
+        return _bytes;
+    }
+
+    /**
+     * @return - number of lookups that found a pair
+     */
+    unsigned long hits() const
+    {
+        return _hits;
+    }
+
+    /**
+     * @return - number of lookups that did not find a pair
+     */
+    unsigned long misses() const
+    {
+        return _misses;
+    }
+
+    /**
+     * @return - number of pairs evicted to stay within the budget
+     */
+    unsigned long evictions() const
+    {
+        return _evictions;
+    }
+
+    /**
+     * @return - number of pairs removed because they expired
+     */
+    unsigned long expirations() const
+    {
+        return _expirations;
+    }
+};
+
+#endif //LRUHASHMAP_HPP
@@ -0,0 +1,271 @@
+//
+// A read only view of a HashMap image that HashMap::save wrote, mapped into memory. Opening the
+// view reads only the header and the bucket offsets; a lookup hashes the key, walks its bucket in
+// the image and compares the stored keys in place.
+//
+#ifndef MAPPEDHASHMAP_HPP
+#define MAPPEDHASHMAP_HPP
+
+#include "HashMap.hpp"
+#include <boost/utility/string_view.hpp>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <stdexcept>
+
+/**
+ * How a view reads a key or a value of the image. A trivially copyable type is read by value.
+ * @tparam T - the type of the key or the value
+ */
+template <typename T, typename Enable = void>
+struct MappedHashMapField;
+
+template <typename T>
+struct MappedHashMapField<T, typename std::enable_if<std::is_trivially_copyable<T>::value>::type>
+{
+    typedef T View;
+
+    /**
+     * @param slot - the slot of the value
+     * @return - the value
+     */
+    static View view(const char *slot, const char *, uint64_t)
+    {
+        T value;
+        std::memcpy(&value, slot, sizeof(T));
+        return value;
+    }
+
+    /**
+     * @param slot - the slot of a key
+     * @param key - the key to compare to
+     * @return - true if the slot holds the key, false otherwise
+     */
+    static bool equals(const char *slot, const char *, uint64_t, const T& key)
+    {
+        return view(slot, nullptr, 0) == key;
+    }
+};
+
+/**
+ * A string is viewed in place, in the string data of the image
+ */
+template <>
+struct MappedHashMapField<std::string>
+{
+    typedef boost::string_view View;
+
+    static View view(const char *slot, const char *blob, uint64_t blobSize)
+    {
+        uint64_t offset = 0;
+        uint64_t length = 0;
+        if(!HashMapImageField<std::string>::readRange(slot, blobSize, offset, length))
+        {
+            throw std::invalid_argument("HashMap image has a string out of its data");
+        }
+        return View(blob + offset, length);
+    }
+
+    static bool equals(const char *slot, const char *blob, uint64_t blobSize, \
+                       const std::string& key)
+    {
+        return view(slot, blob, blobSize) == boost::string_view(key);
+    }
+};
+
+template <typename KeyT, typename ValueT, typename HashT = std::hash<KeyT>>
+/**
+ * Read only view of a HashMap image in a file. It must use the hash function of the HashMap
+ * that wrote the image. Keys and values are returned by value, and strings as views into the
+ * mapped file, which are valid as long as the view exists.
+ * @tparam KeyT - the type of key in the image
+ * @tparam ValueT - the type of value in the image
+ * @tparam HashT - the hash function of the keys
+ */
+class MappedHashMap
+{
+private:
+    typedef MappedHashMapField<KeyT> KeyField;
+    typedef MappedHashMapField<ValueT> ValueField;
+
+    const char *_image; /**< the mapped file */
+    size_t _imageSize; /**< bytes of the mapped file */
+    HashMapImageHeader _header; /**< the header of the image */
+    const uint64_t *_bucketOffsets; /**< capacity + 1 offsets, in the image */
+    const char *_blob; /**< the string data, in the image */
+    const char *_entries; /**< the entries, in the image */
+    size_t _entrySize; /**< bytes of an entry */
+    HashT _hash;
+
+    /**
+     * @param key - a key
+     * @return - the entry of the key, or nullptr if it is not in the image
+     */
+    const char* findEntry(const KeyT& key) const
+    {
+        uint64_t index = _hash(key) & (_header.capacity - 1);
+        for(uint64_t i = _bucketOffsets[index]; i < _bucketOffsets[index + 1]; ++i)
+        {
+            const char *entry = _entries + i * _entrySize;
+            if(KeyField::equals(entry, _blob, _header.blobSize, key))
+            {
+                return entry;
+            }
+        }
+        return nullptr;
+    }
+
+public:
+    typedef typename KeyField::View KeyView;
+    typedef typename ValueField::View ValueView;
+
+    /**
+     * Map the image in the given file
+     * @param path - path of a file that HashMap<KeyT, ValueT, HashT>::save wrote
+     */
+    explicit MappedHashMap(const std::string& path) : _image(nullptr), _imageSize(0)
+    {
+        int fd = open(path.c_str(), O_RDONLY);
+        if(fd == -1)
+        {
+            throw std::runtime_error("can not open " + path);
+        }
+        struct stat imageStat = {};
+        if(fstat(fd, &imageStat) == -1 || size_t(imageStat.st_size) < sizeof(_header))
+        {
+            close(fd);
+            throw std::invalid_argument("not a HashMap image: " + path);
+        }
+        _imageSize = static_cast<size_t>(imageStat.st_size);
+        void *mapped = mmap(nullptr, _imageSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if(mapped == MAP_FAILED)
+        {
+            throw std::runtime_error("can not map " + path);
+        }
+        _image = static_cast<const char *>(mapped);
+
+        std::memcpy(&_header, _image, sizeof(_header));
+        _entrySize = size_t(_header.keySlotSize) + _header.valueSlotSize;
+        uint64_t offsetsSize = (_header.capacity + 1) * sizeof(uint64_t);
+        if(!isValidHashMapImageHeader(_header) || \
+           _header.keyKind != HashMapImageField<KeyT>::kind || \
+           _header.valueKind != HashMapImageField<ValueT>::kind || \
+           _header.keySlotSize != HashMapImageField<KeyT>::slotSize || \
+           _header.valueSlotSize != HashMapImageField<ValueT>::slotSize || \
+           offsetsSize > _imageSize - sizeof(_header) || \
+           _header.blobSize > _imageSize - sizeof(_header) - offsetsSize || \
+           _header.size * _entrySize != _imageSize - sizeof(_header) - offsetsSize - \
+                                        _header.blobSize)
+        {
+            munmap(mapped, _imageSize);
+            throw std::invalid_argument("not a HashMap image of this type: " + path);
+        }
+        _bucketOffsets = reinterpret_cast<const uint64_t *>(_image + sizeof(_header));
+        _blob = _image + sizeof(_header) + offsetsSize;
+        _entries = _blob + _header.blobSize;
+
+        bool validOffsets = _bucketOffsets[0] == 0 && \
+                            _bucketOffsets[_header.capacity] == _header.size;
+        for(uint64_t i = 0; validOffsets && i < _header.capacity; ++i)
+        {
+            validOffsets = _bucketOffsets[i] <= _bucketOffsets[i + 1];
+        }
+        if(!validOffsets)
+        {
+            munmap(mapped, _imageSize);
+            throw std::invalid_argument("HashMap image has invalid bucket offsets: " + path);
+        }
+    }
+
+    MappedHashMap(const MappedHashMap&) = delete;
+    MappedHashMap& operator = (const MappedHashMap&) = delete;
+
+    ~MappedHashMap()
+    {
+        munmap(const_cast<char *>(_image), _imageSize);
+    }
+
+    /**
+     * @return the number of pairs in the image
+     */
+    int size() const
+    {
+        return static_cast<int>(_header.size);
+    }
+
+    /**
+     * @return - the capacity of the HashMap that wrote the image
+     */
+    int capacity() const
+    {
+        return static_cast<int>(_header.capacity);
+    }
+
+    /**
+     * @return the lower bound of the HashMap that wrote the image
+     */
+    double getLowerBound() const
+    {
+        return _header.lowerBound;
+    }
+
+    /**
+     * @return the upper bound of the HashMap that wrote the image
+     */
+    double getUpperBound() const
+    {
+        return _header.upperBound;
+    }
+
+    /**
+     * @param key - the key to search for
+     * @return - true if the image contains the key, false otherwise
+     */
+    bool containsKey(const KeyT& key) const
+    {
+        return findEntry(key) != nullptr;
+    }
+
+    /**
+     * @param key - key of the pair
+     * @return - the value of that key, if exist, otherwise, will throw an exception.
+     */
+    ValueView at(const KeyT& key) const
+    {
+        const char *entry = findEntry(key);
+        if(entry == nullptr)
+        {
+            throw std::invalid_argument("at function must get a valid key");
+        }
+        return ValueField::view(entry + _header.keySlotSize, _blob, _header.blobSize);
+    }
+
+    /**
+     * @param key - a key
+     * @return - the number of pairs in the bucket of the key
+     */
+    int bucketSize(const KeyT& key) const
+    {
+        uint64_t index = _hash(key) & (_header.capacity - 1);
+        return static_cast<int>(_bucketOffsets[index + 1] - _bucketOffsets[index]);
+    }
+
+    /**
+     * Call func on every pair of the image, in bucket order
+     * @param func - function that gets a KeyView and a ValueView
+     */
+    template <typename Func>
+    void forEach(const Func& func) const
+    {
+        for(uint64_t i = 0; i < _header.size; ++i)
+        {
+            const char *entry = _entries + i * _entrySize;
+            func(KeyField::view(entry, _blob, _header.blobSize), \
+                 ValueField::view(entry + _header.keySlotSize, _blob, _header.blobSize));
+        }
+    }
+};
+
+#endif //MAPPEDHASHMAP_HPP
@@ -0,0 +1,253 @@
+//
+// A HashMap for many writing threads: the keys are split between N shards by the high bits of
+// their hash, and every shard is a HashMap of its own behind its own lock. Writers of different
+// shards never wait for each other, and a shard that rehashes stalls only its own keys.
+//
+#ifndef SHARDEDHASHMAP_HPP
+#define SHARDEDHASHMAP_HPP
+
+#include "HashMap.hpp"
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+
+// multiplier that spreads the low bits of a hash into its high bits before a shard is chosen
+#define SHARDED_HASHMAP_MIX 0x9e3779b97f4a7c15ull
+
+template <typename KeyT, typename ValueT, int N, typename HashT = std::hash<KeyT>>
+/**
+ * A HashMap split into N shards, each with its own lock. Every function locks only the shard of
+ * its key, except for size, clear and forEach, that lock the shards one at a time. Values are
+ * returned by copy, since a reference would outlive the lock of its shard.
+ * @tparam KeyT - the type of key in the map
+ * @tparam ValueT - the type of value in the map
+ * @tparam N - number of shards
+ * @tparam HashT - the hash function of the keys
+ */
+class ShardedHashMap
+{
+    static_assert(N > 0, "ShardedHashMap needs at least one shard");
+
+private:
+    /**
+     * A shard, on cache lines of its own so that the locks of neighbour shards do not share one
+     */
+    struct alignas(HASHMAP_CACHE_LINE) Shard
+    {
+        mutable std::mutex lock; /**< guards map */
+        HashMap<KeyT, ValueT, HashT> map; /**< the pairs of the shard */
+    };
+
+    Shard _shards[N];
+    HashT _hash;
+
+    /**
+     * @param i - index of a shard
+     * @return - the shard
+     */
+    Shard& shard(int i)
+    {
+        return _shards[i];
+    }
+
+    /**
+     * @param i - index of a shard
+     * @return - the shard
+     */
+    const Shard& shard(int i) const
+    {
+        return _shards[i];
+    }
+
+    /**
+     * The shard is taken from the high bits of the mixed hash, and HashMap takes the bucket from
+     * the low bits of the hash, so the keys of a shard still spread over all of its buckets
+     * @param key - a key
+     * @return - the shard of the key
+     */
+    Shard& shardOf(const KeyT& key)
+    {
+        return shard(indexOfShard(key));
+    }
+
+    /**
+     * @param key - a key
+     * @return - the shard of the key
+     */
+    const Shard& shardOf(const KeyT& key) const
+    {
+        return shard(indexOfShard(key));
+    }
+
+public:
+    /**
+     * @param key - a key
+     * @return - the index of the shard of the key, from 0 to N - 1
+     */
+    int indexOfShard(const KeyT& key) const
+    {
+        const uint64_t mixed = uint64_t(_hash(key)) * SHARDED_HASHMAP_MIX;
+        return static_cast<int>((static_cast<unsigned __int128>(mixed) * N) >> 64);
+    }
+
+    /**
+     * Default constructor + constructor that gets the lower and upper bound of every shard
+     * @param lowerBound - of every shard
+     * @param upperBound - of every shard
+     */
+    ShardedHashMap(const double lowerBound = (1.0 / 4), const double upperBound = (3.0 / 4))
+    {
+        const HashMap<KeyT, ValueT, HashT> empty(lowerBound, upperBound);
+        for(Shard& s : _shards)
+        {
+            s.map = empty;
+        }
+    }
+
+    ShardedHashMap(const ShardedHashMap&) = delete;
+    ShardedHashMap& operator = (const ShardedHashMap&) = delete;
+
+    /**
+     * @return - the number of shards
+     */
+    static constexpr int numOfShards()
+    {
+        return N;
+    }
+
+    /**
+     * Insert (key, value) to the map
+     * @param key - the key to insert
+     * @param value - the value to insert
+     * @return - true if insert succeed, false if the map already contains the key.
+     */
+    bool insert(const KeyT& key, const ValueT& value)
+    {
+        Shard& s = shardOf(key);
+        std::lock_guard<std::mutex> guard(s.lock);
+        return s.map.insert(key, value);
+    }
+
+    /**
+     * Call func on the value of the key, with the shard of the key locked. A key that is not in
+     * the map is first inserted with ValueT().
+     * @param key - the key
+     * @param func - function that gets a reference to the value
+     */
+    template <typename Func>
+    void update(const KeyT& key, const Func& func)
+    {
+        Shard& s = shardOf(key);
+        std::lock_guard<std::mutex> guard(s.lock);
+        func(s.map[key]);
+    }
+
+    /**
+     * erase the pair with that key from the map
+     * @param key - key of the pair
+     * @return - true if succeed to delete the pair with that key, false otherwise
+     */
+    bool erase(const KeyT& key)
+    {
+        Shard& s = shardOf(key);
+        std::lock_guard<std::mutex> guard(s.lock);
+        return s.map.erase(key);
+    }
+
+    /**
+     * @param key - the key to search for
+     * @return - true if the map contains the key, false otherwise
+     */
+    bool containsKey(const KeyT& key) const
+    {
+        const Shard& s = shardOf(key);
+        std::lock_guard<std::mutex> guard(s.lock);
+        return s.map.containsKey(key);
+    }
+
+    /**
+     * @param key - key of the pair
+     * @param value - set to the value of the key, if the map contains it
+     * @return - true if the map contains the key, false otherwise
+     */
+    bool find(const KeyT& key, ValueT& value) const
+    {
+        const Shard& s = shardOf(key);
+        std::lock_guard<std::mutex> guard(s.lock);
+        if(!s.map.containsKey(key))
+        {
+            return false;
+        }
+        value = s.map.at(key);
+        return true;
+    }
+
+    /**
+     * @param key - key of the pair
+     * @return - a copy of the value of that key, if exist, otherwise, will throw an exception.
+     */
+    ValueT at(const KeyT& key) const
+    {
+        const Shard& s = shardOf(key);
+        std::lock_guard<std::mutex> guard(s.lock);
+        return s.map.at(key);
+    }
+
+    /**
+     * @return the number of pairs in the map. Pairs that other threads insert or erase while
+     *         the shards are counted may or may not be counted.
+     */
+    int size() const
+    {
+        int numOfPairs = 0;
+        for(int i = 0; i < N; ++i)
+        {
+            std::lock_guard<std::mutex> guard(shard(i).lock);
+            numOfPairs += shard(i).map.size();
+        }
+        return numOfPairs;
+    }
+
+    /**
+     * @param i - index of a shard
+     * @return - the number of pairs in the shard
+     */
+    int shardSize(int i) const
+    {
+        std::lock_guard<std::mutex> guard(shard(i).lock);
+        return shard(i).map.size();
+    }
+
+    /**
+     * removing all the pairs from the map
+     */
+    void clear()
+    {
+        for(int i = 0; i < N; ++i)
+        {
+            std::lock_guard<std::mutex> guard(shard(i).lock);
+            shard(i).map.clear();
+        }
+    }
+
+    /**
+     * Call func on every pair of the map, one shard at a time with that shard locked. func must
+     * not call other functions of the map.
+     * @param func - function that gets a const reference to a pair
+     */
+    template <typename Func>
+    void forEach(const Func& func) const
+    {
+        for(int i = 0; i < N; ++i)
+        {
+            std::lock_guard<std::mutex> guard(shard(i).lock);
+            for(const std::pair<KeyT, ValueT>& pair : shard(i).map)
+            {
+                func(pair);
+            }
+        }
+    }
+};
+
+#endif //SHARDEDHASHMAP_HPP
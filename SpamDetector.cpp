@@ -1,254 +1,184 @@
 //
 // Created by Owner on 23/09/2019.
 //
-#define INVALID_INPUT "Invalid input"
-#define ALLOCATION_FAILED "Memory allocation failed"
-#define FAILURE -1
-#define DIGIT "0123456789"
-#define SPAM "SPAM"
-#define NOT_SPAM "NOT_SPAM"
+#define COMPILE_USAGE "Usage: SpamDetector compile <database path> <image path>"
+#define COMPILE_COMMAND "compile"
+#define APPLY_DELTA_USAGE "Usage: SpamDetector apply-delta <image path> <delta path>"
+#define APPLY_DELTA_COMMAND "apply-delta"
+#define DAEMON_USAGE "Usage: SpamDetector daemon [options] <database path> <socket path>"
+#define DAEMON_COMMAND "daemon"
+#define DAEMON_SOCKET_FAILED "Failed to listen on "
+#include "SpamDetector.hpp"
 #include <iostream>
-#include "HashMap.hpp"
-#include <boost/filesystem.hpp>
-#include <fstream>
-#include <ostream>
-#include <vector>
 #include <string>
-#include <algorithm>
-#include <sstream>
-
-using namespace boost::filesystem;
-
+#include <memory>
+#include <csignal>
 
 /**
- * Checking if the given string contain only digits
- * @param str - string
- * @return - true - if the string contain only digits, false otherwise
+ * the daemon that is running, for the signal handler
  */
-bool strContainOnlyDigits(const std::string &str)
-{
-    return str.find_first_not_of(DIGIT) == std::string::npos;
-}
+ScoringDaemon *gDaemon = nullptr;
 
 /**
- * Convert string to lower case
- * @param str - string to convert
+ * Signal handler of the daemon
+ * @param signal - the signal that was received
  */
-std::string lowerStringCase(const std::string& str)
+void stopDaemonHandler(int signal)
 {
-    std::string loweCaseStr = str;
-    for(int i = 0; str[i] != '\0'; i++)
+    (void) signal;
+    if(gDaemon != nullptr)
     {
-        if (loweCaseStr[i] >= 'A' && loweCaseStr[i] <= 'Z')
-        {
-            loweCaseStr[i] = static_cast<char>(loweCaseStr[i] + 32); // convert to lower case
-        }
+        gDaemon->stop();
     }
-    return loweCaseStr;
 }
 
 /**
- * @param line - line from data base
- * @param part0 - the part0 from the data base - the bad sequence
- * @param points - part1 from the database of the above line, the points this sequence wroth
- * @return - true if it a valid line, false otherwise
- */
-bool checkForValidInput(const std::string& line)
-{
-
-    // checking for valid format - there is only one ','
-    long numOfColumns = std::count(line.begin(), line.end(), ',');
-    if( numOfColumns != 1)
-    {
-        return false;
-    }
-
-    std::size_t dividerPos = line.find(',');
-    std::string part0 = line.substr(0, dividerPos); // part0
-    std::string points_seq = line.substr(dividerPos + 1, line.length()); // part1
-
-    // checking if there is actually points (part1) and actually a string of bad sequence (part 0)
-    if(part0.length() == 0 || points_seq.length() == 0 || !strContainOnlyDigits(points_seq))
-    {
-        return false;
-    }
-
-    // number of points must be non-negative (positive or zero)
-    if(std::stoi(points_seq) < 0)
-    {
-        return false;
-    }
-
-    return true;
-}
-
-/**
- *
- * @param dataBase - hashMap to insert the data into.
- * @param argv - argv (command line parameters)
- * @param gDatBaseIndex - index in argv that contains dataBase path
- * @return true, if succeed, false otherwise.
+ * The 'compile' command - write the given csv data base as a compiled image
+ * @param argc - number of argument in the command line
+ * @param argv - array of string that contain all the command line arguments
+ * @return 0 on success, 1 on failure
  */
-bool insertDataFromDataBaseToHashMap(HashMap<std::string, int>& dataBase, char*argv[], \
-                                     const int& gDatBaseIndex)
+int runCompileCommand(int argc, char* argv[])
 {
-
-    path p(argv[gDatBaseIndex]);
-    // checking if the path actually exist
-    if (!exists(p))
+    const int gDatBaseIndex = 2;
+    const int gImageIndex = 3;
+    if(argc != 4)
     {
-        return false;
+        std::cerr << COMPILE_USAGE << std::endl;
+        return EXIT_FAILURE;
     }
-
-    std::string line;
-    std::ifstream input_dataBase(argv[gDatBaseIndex]);
-
-    while(getline(input_dataBase, line))
+    long invalidLine = 0;
+    try
     {
-        if(!checkForValidInput(line))
-        {
-            return false;
-        }
-        std::size_t dividerPos = line.find(',');
-        std::string bad_seq = line.substr(0, dividerPos); // part0
-        std::string points_seq = line.substr(dividerPos + 1, line.length()); // part1
-        try
-        {
-            dataBase.insert(bad_seq, std::stoi(points_seq));
-        }
-        catch (const std::bad_alloc& e)
+        if(!compileDataBase(argv, gDatBaseIndex, gImageIndex, invalidLine))
         {
-            throw e;
+            std::cerr << INVALID_INPUT;
+            if(invalidLine > 0)
+            {
+                std::cerr << INVALID_LINE << invalidLine;
+            }
+            std::cerr << std::endl;
+            return EXIT_FAILURE;
         }
     }
-    return true;
-}
-
-/**
- * Find the number of times str2 is inside str1 (without regards to upper or lower case)
- * @param str1 - string
- * @param str2 - string
- * @return - the number of times str2 is inside str1
- */
-long countNumberOfStrInStr(const std::string& str1, const std::string& str2)
-{
-    std::string str1_lower = lowerStringCase(str1);
-    std::string str2_lower = lowerStringCase(str2);
-    long count = 0;
-    std::string::size_type position = 0;
-    while ((position = str1_lower.find(str2_lower, position )) != std::string::npos)
-    {
-        ++ count;
-        position += str2_lower.length();
-    }
-    return count;
-}
-
-/**
- *
- * @param argv - the command line argument
- * @param gMsgIndex - index of the msg in the command line argument
- * @param dataBase - hashMap that contain all the bad sequences and their equivalent wroth
- * @return -1 if failed to open the file, non-negative otherwise that represent the total pointer
- *          the file got
- */
-long getTotalFilePoint(char* argv[], const int gMsgIndex, \
-                       const HashMap<std::string, int> &dataBase)
-{
-
-    path p(argv[gMsgIndex]);
-    // checking if the path actually exist
-    if (!exists(p))
-    {
-        return FAILURE;
-    }
-    // convert the file input to string
-    std::ifstream tmp(argv[gMsgIndex]);
-    std::stringstream msg;
-    msg << tmp.rdbuf();
-    long totalFilePoints = 0;
-    for(auto it = dataBase.cbegin(); it != dataBase.cend(); ++it)
+    catch (const std::bad_alloc& e)
     {
-        long numberOfTimesInText = countNumberOfStrInStr(msg.str(), it->first);
-        totalFilePoints += numberOfTimesInText * it->second;
+        std::cerr << ALLOCATION_FAILED << std::endl;
+        return EXIT_FAILURE;
     }
-    return totalFilePoints;
+    return 0;
 }
 
 /**
- * getting from the user all the arguments and printing whether the message is legal (error msg
- * if not), and if legal, print if its a SPAM message or NOT SPAM
+ * The 'apply-delta' command - append a delta file to a compiled image
  * @param argc - number of argument in the command line
  * @param argv - array of string that contain all the command line arguments
  * @return 0 on success, 1 on failure
  */
-int main(int argc, char* argv[])
+int runApplyDeltaCommand(int argc, char* argv[])
 {
-    const int gDatBaseIndex = 1; // the data base location in command line
-    const int gMsgIndex = 2;
-    const int gThresholdIndex = 3;
+    const int gImageIndex = 2;
+    const int gDeltaIndex = 3;
     if(argc != 4)
     {
-        std::cerr << "Usage: SpamDetector <database path> <message path> <threshold>" << std::endl;
+        std::cerr << APPLY_DELTA_USAGE << std::endl;
         return EXIT_FAILURE;
     }
-    HashMap<std::string, int> dataBase;
+    long invalidLine = 0;
     try
     {
-        dataBase = HashMap<std::string, int>();
+        if(!appendDeltaToCompiledDataBase(argv, gImageIndex, gDeltaIndex, invalidLine))
+        {
+            std::cerr << INVALID_INPUT;
+            if(invalidLine > 0)
+            {
+                std::cerr << INVALID_LINE << invalidLine;
+            }
+            std::cerr << std::endl;
+            return EXIT_FAILURE;
+        }
     }
     catch (const std::bad_alloc& e)
     {
         std::cerr << ALLOCATION_FAILED << std::endl;
         return EXIT_FAILURE;
     }
+    return 0;
+}
 
-    bool insertToHashMap;
-    try
-    {
-        insertToHashMap = insertDataFromDataBaseToHashMap(dataBase, argv, gDatBaseIndex);
-    }
-    catch (const std::bad_alloc& e)
+/**
+ * The 'daemon' command - serve scoring requests on a unix domain socket
+ * @param argc - number of argument in the command line
+ * @param argv - array of string that contain all the command line arguments
+ * @return 0 on success, 1 on failure
+ */
+int runDaemonCommand(int argc, char* argv[])
+{
+    ScanOptions options;
+    const int gDatBaseIndex = parseScanOptions(argc, argv, 2, options);
+    const int gSocketIndex = gDatBaseIndex + 1;
+    if(gDatBaseIndex == FAILURE || argc != gSocketIndex + 1)
     {
-        std::cerr << ALLOCATION_FAILED << std::endl;
+        std::cerr << DAEMON_USAGE << std::endl;
         return EXIT_FAILURE;
     }
-
-    if(!insertToHashMap)
+    int numOfWorkers = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    ScoringDaemon daemon(argv, gDatBaseIndex, options);
+    if(!daemon.start(numOfWorkers))
     {
-        std::cerr << INVALID_INPUT << std::endl;
         return EXIT_FAILURE;
     }
-
-    long totalFilePoint = getTotalFilePoint(argv, gMsgIndex, dataBase);
-    if(totalFilePoint == FAILURE)
+    if(!daemon.listenOn(argv[gSocketIndex]))
     {
-        std::cerr << INVALID_INPUT << std::endl;
+        std::cerr << DAEMON_SOCKET_FAILED << argv[gSocketIndex] << std::endl;
         return EXIT_FAILURE;
     }
 
-    if(!strContainOnlyDigits(argv[gThresholdIndex]))
-    {
-        std::cerr << INVALID_INPUT << std::endl;
-        return EXIT_FAILURE;
-    }
-    long threshold = std::stoi(argv[gThresholdIndex]);
+    gDaemon = &daemon;
+    struct sigaction action = {};
+    action.sa_handler = stopDaemonHandler;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+    daemon.serve();
+    gDaemon = nullptr;
+    return 0;
+}
 
-    if(threshold <= 0)
+/**
+ * getting from the user all the arguments and printing whether the message is legal (error msg
+ * if not), and if legal, print if its a SPAM message or NOT SPAM.
+ * 'SpamDetector compile <database path> <image path>' writes a compiled image of the data base,
+ * which is loaded instead of the csv when --db-compiled is given before the data base path.
+ * 'SpamDetector apply-delta <image path> <delta path>' appends a delta file to a compiled image,
+ * and '--db-delta <delta path>' (may be repeated) applies a delta file to the loaded data base.
+ * '--early-exit' stops scanning a message as soon as its points reach the threshold.
+ * '--tokens' matches the bad sequences only as whole words, with hash lookups.
+ * '--cache <path>' keeps the scores of messages in a file, and scores a message that is already
+ * there without loading the data base; '--cache-size <n>' bounds the number of scores it keeps
+ * and '--cache-stats' prints its counters.
+ * '--explain' and '--profile' write to stderr a JSON object with the bad sequences that added the
+ * most points and the ones that took the longest to search for (not with '--tokens').
+ * 'SpamDetector daemon [options] <database path> <socket path>' runs the scoring daemon.
+ * @param argc - number of argument in the command line
+ * @param argv - array of string that contain all the command line arguments
+ * @return 0 on success, 1 on failure
+ */
+int main(int argc, char* argv[])
+{
+    if(argc > 1 && std::strcmp(argv[1], COMPILE_COMMAND) == 0)
     {
-        std::cerr << INVALID_INPUT << std::endl;
-        return EXIT_FAILURE;
+        return runCompileCommand(argc, argv);
     }
-
-    if(threshold <= totalFilePoint)
+    if(argc > 1 && std::strcmp(argv[1], APPLY_DELTA_COMMAND) == 0)
     {
-        std::cout << SPAM << std::endl;
+        return runApplyDeltaCommand(argc, argv);
     }
-    else
+    if(argc > 1 && std::strcmp(argv[1], DAEMON_COMMAND) == 0)
     {
-        std::cout << NOT_SPAM << std::endl;
+        return runDaemonCommand(argc, argv);
     }
 
-    return 0;
+    return runScanCommand(argc, argv);
 }
 
@@ -0,0 +1,2689 @@
+//
+// The scoring engine of SpamDetector - loading the data base and scoring messages - and the
+// scoring daemon. It is shared by the command line tool (SpamDetector.cpp), the benchmarks
+// (bench_spam.cpp) and the tests.
+//
+#ifndef SPAMDETECTOR_HPP
+#define SPAMDETECTOR_HPP
+
+#define USAGE "Usage: SpamDetector <database path> <message path> <threshold>"
+#define FAILURE -1
+#define DIGIT "0123456789"
+#define SPAM "SPAM"
+#define NOT_SPAM "NOT_SPAM"
+#define DB_DELTA_FLAG "--db-delta"
+#define EARLY_EXIT_FLAG "--early-exit"
+#define EARLY_EXIT_BLOCK_SIZE 4096
+#define TOKENS_FLAG "--tokens"
+#define NGRAM_LENGTH 3
+#define NGRAM_FILTER_BITS (1 << 18)
+#define CACHE_FLAG "--cache"
+#define CACHE_SIZE_FLAG "--cache-size"
+#define CACHE_STATS_FLAG "--cache-stats"
+#define CACHE_DEFAULT_SIZE 65536
+#define CACHE_STATS_HITS "cache hits: "
+#define CACHE_STATS_MISSES ", misses: "
+#define CACHE_STATS_ENTRIES ", entries: "
+#define EXPLAIN_FLAG "--explain"
+#define PROFILE_FLAG "--profile"
+#define EXPLAIN_TOP_PATTERNS 10
+#define CACHE_FILE_MAGIC "SPSC"
+#define CACHE_FILE_VERSION 1
+#define CACHE_TEMP_SUFFIX ".tmp"
+#define MURMUR_C1 0x87c37b91114253d5ULL
+#define MURMUR_C2 0x4cf5ad432745937fULL
+#define DELTA_ADD '+'
+#define DELTA_REMOVE '-'
+#define DELTA_UPDATE '='
+#define COMPILED_DELTA_MAGIC "SPDD"
+#define DB_COMPILED_FLAG "--db-compiled"
+#define COMPILED_DB_MAGIC "SPDB"
+#define COMPILED_DB_VERSION 2
+#define FNV_OFFSET_BASIS 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+#define PARALLEL_LOAD_MIN_SIZE (1 << 20)
+#define MAX_THRESHOLD_DIGITS 18
+#define INVALID_INPUT "Invalid input"
+#define INVALID_LINE " at line "
+#define ALLOCATION_FAILED "Memory allocation failed"
+#define DAEMON_SCORE_COMMAND "SCORE"
+#define DAEMON_MESSAGE_COMMAND "MESSAGE"
+#define DAEMON_STATS_COMMAND "STATS"
+#define DAEMON_ERROR "ERROR "
+#define DAEMON_MAX_LINE 4096
+#define DAEMON_MAX_MESSAGE (64UL << 20)
+#define DAEMON_READ_SIZE 65536
+#define DAEMON_MAX_EVENTS 64
+#define DAEMON_RELOAD_CHECK_MS 1000
+#define DAEMON_LOOP_TIMEOUT_MS 1000
+#include <iostream>
+#include "HashMap.hpp"
+#include "FrozenHashMap.hpp"
+#include "LruHashMap.hpp"
+#include <boost/filesystem.hpp>
+#include <fstream>
+#include <ostream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <sstream>
+#include <limits>
+#include <thread>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <boost/utility/string_view.hpp>
+#include <boost/functional/hash.hpp>
+#include <cctype>
+#include <bitset>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <deque>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+
+/**
+ * Checking if the given string contain only digits
+ * @param str - string
+ * @return - true - if the string contain only digits, false otherwise
+ */
+inline bool strContainOnlyDigits(const std::string &str)
+{
+    return str.find_first_not_of(DIGIT) == std::string::npos;
+}
+
+/**
+ * Convert string to lower case
+ * @param str - string to convert
+ */
+inline std::string lowerStringCase(const std::string& str)
+{
+    std::string loweCaseStr = str;
+    for(int i = 0; str[i] != '\0'; i++)
+    {
+        if (loweCaseStr[i] >= 'A' && loweCaseStr[i] <= 'Z')
+        {
+            loweCaseStr[i] = static_cast<char>(loweCaseStr[i] + 32); // convert to lower case
+        }
+    }
+    return loweCaseStr;
+}
+
+/**
+ * Convert string to lower case in place, like lowerStringCase but without allocating
+ * @param str - string to convert
+ */
+inline void lowerStringCaseInPlace(std::string& str)
+{
+    for(size_t i = 0; i < str.length() && str[i] != '\0'; i++)
+    {
+        if (str[i] >= 'A' && str[i] <= 'Z')
+        {
+            str[i] = static_cast<char>(str[i] + 32); // convert to lower case
+        }
+    }
+}
+
+/**
+ * Read the whole content of a file
+ * @param filePath - path of the file
+ * @param content - set to the content of the file
+ * @return - true if succeed, false if the file could not be read
+ */
+inline bool readFileToString(const char *filePath, std::string& content)
+{
+    std::ifstream file(filePath, std::ios::binary | std::ios::ate);
+    if(!file)
+    {
+        return false;
+    }
+    std::streamoff fileSize = file.tellg();
+    if(fileSize < 0)
+    {
+        return false;
+    }
+    content.resize(static_cast<size_t>(fileSize));
+    file.seekg(0);
+    return static_cast<bool>(file.read(&content[0], fileSize)) || fileSize == 0;
+}
+
+/**
+ * Validate and split one line of the data base in a single pass, without allocating.
+ * A valid line is "<bad sequence>,<points>" where the bad sequence is not empty and the points
+ * are a non-negative number that fits in an int.
+ * @param line - line from data base, without the new line
+ * @param part0 - set to the bad sequence of the line
+ * @param points - set to the points of the line (part1)
+ * @return - true if it a valid line, false otherwise
+ */
+inline bool parseDataBaseLine(const boost::string_view& line, boost::string_view& part0, \
+                              int& points)
+{
+    std::size_t dividerPos = boost::string_view::npos;
+    long value = 0;
+    for(std::size_t i = 0; i < line.length(); ++i)
+    {
+        const char c = line[i];
+        if(c == ',')
+        {
+            // checking for valid format - there is only one ','
+            if(dividerPos != boost::string_view::npos)
+            {
+                return false;
+            }
+            dividerPos = i;
+        }
+        else if(dividerPos != boost::string_view::npos)
+        {
+            if(c < '0' || c > '9')
+            {
+                return false;
+            }
+            value = value * 10 + (c - '0');
+            if(value > std::numeric_limits<int>::max())
+            {
+                return false;
+            }
+        }
+    }
+
+    // checking if there is actually points (part1) and actually a string of bad sequence (part 0)
+    if(dividerPos == boost::string_view::npos || dividerPos == 0 || \
+       dividerPos + 1 == line.length())
+    {
+        return false;
+    }
+    part0 = line.substr(0, dividerPos);
+    points = static_cast<int>(value);
+    return true;
+}
+
+/**
+ * Call func on every line of a text that is already in memory, until it returns false
+ * @param content - the text
+ * @param numOfLines - set to the number of lines that func was called on
+ * @param func - called with every line, without the new line, in order
+ * @return true, if func returned true for all the lines, false otherwise.
+ */
+template <typename Func>
+bool forEachLine(const boost::string_view& content, long& numOfLines, const Func& func)
+{
+    numOfLines = 0;
+    std::size_t lineStart = 0;
+    while(lineStart < content.length())
+    {
+        std::size_t lineEnd = content.find('\n', lineStart);
+        if(lineEnd == boost::string_view::npos)
+        {
+            lineEnd = content.length();
+        }
+        ++numOfLines;
+        if(!func(content.substr(lineStart, lineEnd - lineStart)))
+        {
+            return false;
+        }
+        lineStart = lineEnd + 1;
+    }
+    return true;
+}
+
+/**
+ * Parse every line of (a part of) a data base that is already in memory
+ * @param content - whole lines of the data base
+ * @param numOfLines - set to the number of lines that were parsed, including the invalid one
+ * @param func - called with the bad sequence and the points of every valid line, in order
+ * @return true, if all the lines are valid, false otherwise.
+ */
+template <typename Func>
+bool forEachDataBaseRow(const boost::string_view& content, long& numOfLines, const Func& func)
+{
+    return forEachLine(content, numOfLines, [&func](const boost::string_view& line)
+    {
+        boost::string_view bad_seq;
+        int points = 0;
+        if(!parseDataBaseLine(line, bad_seq, points))
+        {
+            return false;
+        }
+        func(bad_seq, points);
+        return true;
+    });
+}
+
+/**
+ * Insert every line of a data base that is already in memory to the hashMap
+ * @param dataBase - hashMap to insert the data into.
+ * @param content - the content of the data base
+ * @param invalidLine - set to the (1 based) number of the first invalid line, if there is one
+ * @return true, if all the lines are valid, false otherwise.
+ */
+inline bool insertDataBaseContentToHashMap(HashMap<std::string, int>& dataBase, \
+                                           const boost::string_view& content, long& invalidLine)
+{
+    long numOfLines = 0;
+    bool valid = forEachDataBaseRow(content, numOfLines, \
+                                    [&dataBase](const boost::string_view& bad_seq, int points)
+                                    {
+                                        dataBase.insert(std::string(bad_seq.data(), \
+                                                                    bad_seq.length()), points);
+                                    });
+    if(!valid)
+    {
+        invalidLine = numOfLines;
+    }
+    return valid;
+}
+
+/**
+ * Same as insertDataBaseContentToHashMap, using several threads. The content is split into
+ * chunks of whole lines that are parsed in parallel, and the rows are then inserted with
+ * HashMap::bulkInsert, so for a bad sequence that appears twice the first line still wins.
+ * @param dataBase - hashMap to insert the data into.
+ * @param content - the content of the data base
+ * @param numOfThreads - number of threads to use
+ * @param invalidLine - set to the (1 based) number of the first invalid line, if there is one
+ * @return true, if all the lines are valid, false otherwise.
+ */
+inline bool insertDataBaseContentToHashMapParallel(HashMap<std::string, int>& dataBase, \
+                                                   const boost::string_view& content, \
+                                                   int numOfThreads, long& invalidLine)
+{
+    // split the content at new lines, so every chunk holds whole lines
+    std::vector<std::size_t> chunkStart(numOfThreads + 1, content.length());
+    chunkStart[0] = 0;
+    for(int i = 1; i < numOfThreads; ++i)
+    {
+        std::size_t position = std::max(chunkStart[i - 1], content.length() * i / numOfThreads);
+        std::size_t lineEnd = position == 0 ? 0 : content.find('\n', position - 1);
+        chunkStart[i] = lineEnd == boost::string_view::npos ? content.length() : lineEnd + 1;
+    }
+
+    std::vector<std::vector<std::pair<std::string, int>>> chunkRows(numOfThreads);
+    std::vector<long> chunkLines(numOfThreads, 0);
+    std::vector<char> chunkValid(numOfThreads, true);
+    std::vector<std::exception_ptr> errors(numOfThreads);
+    auto parseChunk = [&](int chunk)
+    {
+        try
+        {
+            std::vector<std::pair<std::string, int>>& rows = chunkRows[chunk];
+            chunkValid[chunk] = forEachDataBaseRow(\
+                content.substr(chunkStart[chunk], chunkStart[chunk + 1] - chunkStart[chunk]), \
+                chunkLines[chunk], [&rows](const boost::string_view& bad_seq, int points)
+                {
+                    rows.emplace_back(std::string(bad_seq.data(), bad_seq.length()), points);
+                });
+        }
+        catch (...)
+        {
+            errors[chunk] = std::current_exception();
+        }
+    };
+    {
+        std::vector<std::thread> threads;
+        threads.reserve(numOfThreads - 1);
+        ThreadJoiner joiner(threads);
+        for(int chunk = 1; chunk < numOfThreads; ++chunk)
+        {
+            threads.emplace_back(parseChunk, chunk);
+        }
+        parseChunk(0);
+    }
+
+    long linesBefore = 0;
+    std::size_t numOfRows = 0;
+    for(int chunk = 0; chunk < numOfThreads; ++chunk)
+    {
+        if(errors[chunk])
+        {
+            std::rethrow_exception(errors[chunk]);
+        }
+        if(!chunkValid[chunk])
+        {
+            invalidLine = linesBefore + chunkLines[chunk];
+            return false;
+        }
+        linesBefore += chunkLines[chunk];
+        numOfRows += chunkRows[chunk].size();
+    }
+
+    std::vector<std::pair<std::string, int>> rows;
+    rows.reserve(numOfRows);
+    for(std::vector<std::pair<std::string, int>>& chunk : chunkRows)
+    {
+        std::move(chunk.begin(), chunk.end(), std::back_inserter(rows));
+        std::vector<std::pair<std::string, int>>().swap(chunk);
+    }
+    dataBase.bulkInsert(std::move(rows), numOfThreads);
+    return true;
+}
+
+/**
+ *
+ * @param dataBase - hashMap to insert the data into.
+ * @param argv - argv (command line parameters)
+ * @param gDatBaseIndex - index in argv that contains dataBase path
+ * @param invalidLine - set to the (1 based) number of the first invalid line, if there is one
+ * @return true, if succeed, false otherwise.
+ */
+inline bool insertDataFromDataBaseToHashMap(HashMap<std::string, int>& dataBase, char*argv[], \
+                                            const int& gDatBaseIndex, long& invalidLine)
+{
+    invalidLine = 0;
+    boost::filesystem::path p(argv[gDatBaseIndex]);
+    // checking if the path actually exist
+    if (!boost::filesystem::exists(p))
+    {
+        return false;
+    }
+
+    std::string content;
+    if(!readFileToString(argv[gDatBaseIndex], content))
+    {
+        return false;
+    }
+    int numOfThreads = static_cast<int>(std::thread::hardware_concurrency());
+    if(numOfThreads > 1 && content.length() >= PARALLEL_LOAD_MIN_SIZE)
+    {
+        return insertDataBaseContentToHashMapParallel(dataBase, content, numOfThreads, \
+                                                      invalidLine);
+    }
+    return insertDataBaseContentToHashMap(dataBase, content, invalidLine);
+}
+
+/**
+ * One line of a delta file
+ */
+struct DeltaOperation
+{
+    char operation; /**< DELTA_ADD, DELTA_REMOVE or DELTA_UPDATE */
+    boost::string_view part0; /**< the bad sequence */
+    int points; /**< the points of the bad sequence, not used by DELTA_REMOVE */
+};
+
+/**
+ * Parse all the lines of a delta file. Every line is an operation followed by a data base row:
+ * "+<bad sequence>,<points>" adds a bad sequence (if it is already in the data base it keeps
+ * its points, as a repeated line in the data base would), "=<bad sequence>,<points>" sets the
+ * points of a bad sequence, adding it if needed, and "-<bad sequence>" removes it.
+ * @param content - the content of the delta file, must outlive operations
+ * @param operations - the operations of the file are appended to it, in order
+ * @param invalidLine - set to the (1 based) number of the first invalid line, if there is one
+ * @return true, if all the lines are valid, false otherwise.
+ */
+inline bool parseDelta(const boost::string_view& content, std::vector<DeltaOperation>& operations, \
+                       long& invalidLine)
+{
+    long numOfLines = 0;
+    bool valid = forEachLine(content, numOfLines, [&operations](const boost::string_view& line)
+    {
+        if(line.empty())
+        {
+            return false;
+        }
+        DeltaOperation operation = {line[0], line.substr(1), 0};
+        if(operation.operation == DELTA_REMOVE)
+        {
+            if(operation.part0.empty() || operation.part0.find(',') != boost::string_view::npos)
+            {
+                return false;
+            }
+        }
+        else if((operation.operation != DELTA_ADD && operation.operation != DELTA_UPDATE) || \
+                !parseDataBaseLine(line.substr(1), operation.part0, operation.points))
+        {
+            return false;
+        }
+        operations.push_back(operation);
+        return true;
+    });
+    if(!valid)
+    {
+        invalidLine = numOfLines;
+    }
+    return valid;
+}
+
+/**
+ * Apply one delta operation to the data base
+ * @param dataBase - the data base
+ * @param operation - DELTA_ADD, DELTA_REMOVE or DELTA_UPDATE
+ * @param bad_seq - the bad sequence
+ * @param points - the points of the bad sequence
+ */
+inline void applyDeltaOperation(HashMap<std::string, int>& dataBase, char operation, \
+                                const std::string& bad_seq, int points)
+{
+    if(operation == DELTA_REMOVE)
+    {
+        dataBase.erase(bad_seq);
+    }
+    else if(!dataBase.insert(bad_seq, points) && operation == DELTA_UPDATE)
+    {
+        dataBase.at(bad_seq) = points;
+    }
+}
+
+/**
+ * Apply a delta file to a loaded data base. The file is validated as a whole before anything
+ * is applied, so an invalid delta leaves the data base as it was.
+ * @param dataBase - the data base
+ * @param deltaPath - path of the delta file
+ * @param invalidLine - set to the (1 based) number of the first invalid line, if there is one
+ * @return true, if succeed, false otherwise.
+ */
+inline bool applyDeltaFileToHashMap(HashMap<std::string, int>& dataBase, const char *deltaPath, \
+                                    long& invalidLine)
+{
+    std::string content;
+    std::vector<DeltaOperation> operations;
+    if(!readFileToString(deltaPath, content) || !parseDelta(content, operations, invalidLine))
+    {
+        return false;
+    }
+    for(const DeltaOperation& operation : operations)
+    {
+        applyDeltaOperation(dataBase, operation.operation, \
+                            std::string(operation.part0.data(), operation.part0.length()), \
+                            operation.points);
+    }
+    return true;
+}
+
+/**
+ * Header of a compiled data base image. The header is followed by numOfPatterns records, each
+ * record is the points of the pattern (int32_t), the length of the pattern (uint32_t) and the
+ * bytes of the pattern, in its case in the data base. Delta segments may follow the records.
+ */
+struct CompiledDataBaseHeader
+{
+    char magic[4]; /**< always COMPILED_DB_MAGIC */
+    uint32_t version; /**< version of the image format */
+    uint32_t numOfPatterns; /**< number of records that follow the header */
+    uint32_t reserved; /**< padding, always 0 */
+    uint64_t payloadSize; /**< number of bytes of the records */
+    uint64_t checksum; /**< FNV-1a checksum of the records */
+};
+
+/**
+ * Header of a delta segment appended to a compiled data base image by 'apply-delta'. The header
+ * is followed by numOfOperations records, each record is the operation (one byte) followed by a
+ * record as in the image itself.
+ */
+struct CompiledDeltaHeader
+{
+    char magic[4]; /**< always COMPILED_DELTA_MAGIC */
+    uint32_t numOfOperations; /**< number of records that follow the header */
+    uint64_t payloadSize; /**< number of bytes of the records */
+    uint64_t checksum; /**< FNV-1a checksum of the records */
+};
+
+/**
+ * FNV-1a hash of the given bytes
+ * @param data - the bytes to hash
+ * @param length - number of bytes
+ * @return - the 64 bit hash of the bytes
+ */
+inline uint64_t fnv1aChecksum(const char *data, size_t length)
+{
+    uint64_t hash = FNV_OFFSET_BASIS;
+    for(size_t i = 0; i < length; ++i)
+    {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+/**
+ * Append a record of a compiled image
+ * @param payload - the records of the image
+ * @param pattern - the pattern
+ * @param points - the points of the pattern
+ */
+inline void appendCompiledRecord(std::string& payload, const std::string& pattern, int32_t points)
+{
+    uint32_t length = static_cast<uint32_t>(pattern.length());
+    payload.append(reinterpret_cast<const char *>(&points), sizeof(points));
+    payload.append(reinterpret_cast<const char *>(&length), sizeof(length));
+    payload.append(pattern);
+}
+
+/**
+ * Read a record of a compiled image
+ * @param payload - the records of the image
+ * @param payloadSize - number of bytes of the records
+ * @param position - position of the record, advanced past it
+ * @param pattern - set to the pattern of the record
+ * @param points - set to the points of the record
+ * @return - true if there is a whole record at position, false otherwise
+ */
+inline bool readCompiledRecord(const char *payload, uint64_t payloadSize, uint64_t& position, \
+                               boost::string_view& pattern, int32_t& points)
+{
+    uint32_t length = 0;
+    if(payloadSize - position < sizeof(points) + sizeof(length))
+    {
+        return false;
+    }
+    std::memcpy(&points, payload + position, sizeof(points));
+    std::memcpy(&length, payload + position + sizeof(points), sizeof(length));
+    position += sizeof(points) + sizeof(length);
+    if(payloadSize - position < length)
+    {
+        return false;
+    }
+    pattern = boost::string_view(payload + position, length);
+    position += length;
+    return true;
+}
+
+/**
+ * Load the given csv data base and write it as a compiled image. Every pattern keeps its own
+ * record in its own case, as it is in the data base, so that a delta changes the same patterns
+ * in the image as in the csv; case is folded only when a message is scored.
+ * @param argv - argv (command line parameters)
+ * @param gDatBaseIndex - index in argv that contains dataBase path
+ * @param gImageIndex - index in argv that contains the path of the image to write
+ * @param invalidLine - set to the (1 based) number of the first invalid line, if there is one
+ * @return true, if succeed, false otherwise.
+ */
+inline bool compileDataBase(char *argv[], const int& gDatBaseIndex, const int& gImageIndex, \
+                            long& invalidLine)
+{
+    HashMap<std::string, int> dataBase;
+    if(!insertDataFromDataBaseToHashMap(dataBase, argv, gDatBaseIndex, invalidLine))
+    {
+        return false;
+    }
+
+    std::string payload;
+    const auto dataBaseEnd = dataBase.cend();
+    for(auto it = dataBase.cbegin(); it != dataBaseEnd; ++it)
+    {
+        appendCompiledRecord(payload, it->first, it->second);
+    }
+
+    CompiledDataBaseHeader header = {};
+    std::memcpy(header.magic, COMPILED_DB_MAGIC, sizeof(header.magic));
+    header.version = COMPILED_DB_VERSION;
+    header.numOfPatterns = static_cast<uint32_t>(dataBase.size());
+    header.payloadSize = payload.length();
+    header.checksum = fnv1aChecksum(payload.data(), payload.length());
+
+    std::ofstream image(argv[gImageIndex], std::ios::binary | std::ios::trunc);
+    image.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    image.write(payload.data(), payload.length());
+    return static_cast<bool>(image);
+}
+
+/**
+ * Insert a compiled image that is in memory to the hashMap, and apply its delta segments
+ * @param dataBase - hashMap to insert the data into.
+ * @param image - the image
+ * @param imageSize - size of the image
+ * @return true, if succeed, false if the image is corrupted.
+ */
+inline bool insertCompiledImageToHashMap(HashMap<std::string, int>& dataBase, const char *image, \
+                                         size_t imageSize)
+{
+    CompiledDataBaseHeader header = {};
+    if(imageSize < sizeof(header))
+    {
+        return false;
+    }
+    std::memcpy(&header, image, sizeof(header));
+    const char *payload = image + sizeof(header);
+    if(std::memcmp(header.magic, COMPILED_DB_MAGIC, sizeof(header.magic)) != 0 || \
+       header.version != COMPILED_DB_VERSION || \
+       header.payloadSize > imageSize - sizeof(header) || \
+       header.checksum != fnv1aChecksum(payload, header.payloadSize))
+    {
+        return false;
+    }
+
+    uint64_t position = 0;
+    boost::string_view pattern;
+    int32_t points = 0;
+    for(uint32_t i = 0; i < header.numOfPatterns; ++i)
+    {
+        if(!readCompiledRecord(payload, header.payloadSize, position, pattern, points))
+        {
+            return false;
+        }
+        dataBase.insert(std::string(pattern.data(), pattern.length()), points);
+    }
+    if(position != header.payloadSize)
+    {
+        return false;
+    }
+
+    size_t segmentPosition = sizeof(header) + header.payloadSize;
+    while(segmentPosition < imageSize)
+    {
+        CompiledDeltaHeader deltaHeader = {};
+        if(imageSize - segmentPosition < sizeof(deltaHeader))
+        {
+            return false;
+        }
+        std::memcpy(&deltaHeader, image + segmentPosition, sizeof(deltaHeader));
+        payload = image + segmentPosition + sizeof(deltaHeader);
+        if(std::memcmp(deltaHeader.magic, COMPILED_DELTA_MAGIC, sizeof(deltaHeader.magic)) != 0 \
+           || deltaHeader.payloadSize > imageSize - segmentPosition - sizeof(deltaHeader) || \
+           deltaHeader.checksum != fnv1aChecksum(payload, deltaHeader.payloadSize))
+        {
+            return false;
+        }
+        position = 0;
+        for(uint32_t i = 0; i < deltaHeader.numOfOperations; ++i)
+        {
+            if(position == deltaHeader.payloadSize)
+            {
+                return false;
+            }
+            char operation = payload[position++];
+            if(!readCompiledRecord(payload, deltaHeader.payloadSize, position, pattern, points))
+            {
+                return false;
+            }
+            applyDeltaOperation(dataBase, operation, \
+                                std::string(pattern.data(), pattern.length()), points);
+        }
+        if(position != deltaHeader.payloadSize)
+        {
+            return false;
+        }
+        segmentPosition += sizeof(deltaHeader) + deltaHeader.payloadSize;
+    }
+    return true;
+}
+
+/**
+ * Load a data base image that was written by compileDataBase. The image is mapped into memory
+ * and its records are inserted as is, without any parsing or validation of the patterns.
+ * @param dataBase - hashMap to insert the data into.
+ * @param argv - argv (command line parameters)
+ * @param gDatBaseIndex - index in argv that contains the image path
+ * @return true, if succeed, false if the image does not exist or is corrupted.
+ */
+inline bool insertCompiledDataBaseToHashMap(HashMap<std::string, int>& dataBase, char*argv[], \
+                                            const int& gDatBaseIndex)
+{
+    int fd = open(argv[gDatBaseIndex], O_RDONLY);
+    if(fd == FAILURE)
+    {
+        return false;
+    }
+    struct stat imageStat = {};
+    if(fstat(fd, &imageStat) == FAILURE || imageStat.st_size == 0)
+    {
+        close(fd);
+        return false;
+    }
+    size_t imageSize = static_cast<size_t>(imageStat.st_size);
+    void *mapped = mmap(nullptr, imageSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(mapped == MAP_FAILED)
+    {
+        return false;
+    }
+
+    bool valid = false;
+    try
+    {
+        valid = insertCompiledImageToHashMap(dataBase, static_cast<const char *>(mapped), \
+                                             imageSize);
+    }
+    catch (const std::bad_alloc& e)
+    {
+        munmap(mapped, imageSize);
+        throw e;
+    }
+    munmap(mapped, imageSize);
+    return valid;
+}
+
+/**
+ * Validate a delta file and append it to a compiled image as a delta segment
+ * @param argv - argv (command line parameters)
+ * @param gImageIndex - index in argv that contains the image path
+ * @param gDeltaIndex - index in argv that contains the delta path
+ * @param invalidLine - set to the (1 based) number of the first invalid line, if there is one
+ * @return true, if succeed, false otherwise.
+ */
+inline bool appendDeltaToCompiledDataBase(char *argv[], const int& gImageIndex, \
+                                          const int& gDeltaIndex, long& invalidLine)
+{
+    HashMap<std::string, int> dataBase;
+    std::string image;
+    std::string content;
+    std::vector<DeltaOperation> operations;
+    if(!readFileToString(argv[gImageIndex], image) || \
+       !insertCompiledImageToHashMap(dataBase, image.data(), image.length()) || \
+       !readFileToString(argv[gDeltaIndex], content) || \
+       !parseDelta(content, operations, invalidLine))
+    {
+        return false;
+    }
+
+    std::string payload;
+    for(const DeltaOperation& operation : operations)
+    {
+        payload.push_back(operation.operation);
+        appendCompiledRecord(payload, std::string(operation.part0.data(), \
+                                                  operation.part0.length()), operation.points);
+    }
+    CompiledDeltaHeader header = {};
+    std::memcpy(header.magic, COMPILED_DELTA_MAGIC, sizeof(header.magic));
+    header.numOfOperations = static_cast<uint32_t>(operations.size());
+    header.payloadSize = payload.length();
+    header.checksum = fnv1aChecksum(payload.data(), payload.length());
+
+    std::ofstream output(argv[gImageIndex], std::ios::binary | std::ios::app);
+    output.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    output.write(payload.data(), payload.length());
+    return static_cast<bool>(output);
+}
+
+/**
+ * Find the number of times str2 is inside str1, when both are already in lower case
+ * @param str1 - string
+ * @param str2 - string
+ * @return - the number of times str2 is inside str1
+ */
+inline long countNumberOfLowerCaseStrInStr(const std::string& str1, const std::string& str2)
+{
+    long count = 0;
+    std::string::size_type position = 0;
+    while ((position = str1.find(str2, position )) != std::string::npos)
+    {
+        ++ count;
+        position += str2.length();
+    }
+    return count;
+}
+
+/**
+ * Find the number of times str2 is inside str1 (without regards to upper or lower case)
+ * @param str1 - string
+ * @param str2 - string
+ * @return - the number of times str2 is inside str1
+ */
+inline long countNumberOfStrInStr(const std::string& str1, const std::string& str2)
+{
+    return countNumberOfLowerCaseStrInStr(lowerStringCase(str1), lowerStringCase(str2));
+}
+
+/**
+ * A set of the NGRAM_LENGTH-grams of a text, used to skip the bad sequences that cannot be in
+ * it: a bad sequence whose first or last n-gram is not in the text is not in the text either.
+ * The n-grams are hashed into NGRAM_FILTER_BITS bits, so the filter may let through a bad
+ * sequence that is not in the text, but never rejects one that is.
+ */
+class NGramFilter
+{
+public:
+    /**
+     * @param text - the text, in lower case
+     */
+    explicit NGramFilter(const std::string& text)
+    {
+        for(std::size_t i = 0; i + NGRAM_LENGTH <= text.length(); ++i)
+        {
+            _bits.set(bitOf(text.data() + i));
+        }
+    }
+
+    /**
+     * @param pattern - a bad sequence, in lower case
+     * @return - false if the pattern is surely not in the text, true if it may be
+     */
+    bool mayContain(const std::string& pattern) const
+    {
+        if(pattern.length() < NGRAM_LENGTH)
+        {
+            return true;
+        }
+        return _bits.test(bitOf(pattern.data())) && \
+               _bits.test(bitOf(pattern.data() + pattern.length() - NGRAM_LENGTH));
+    }
+
+private:
+    std::bitset<NGRAM_FILTER_BITS> _bits; /**< the bits of the n-grams of the text */
+
+    /**
+     * @param nGram - pointer to the first of NGRAM_LENGTH characters
+     * @return - the bit of the n-gram
+     */
+    static std::size_t bitOf(const char *nGram)
+    {
+        uint32_t key = 0;
+        for(int i = 0; i < NGRAM_LENGTH; ++i)
+        {
+            key = (key << 8) | static_cast<unsigned char>(nGram[i]);
+        }
+        // Fibonacci hashing spreads the n-grams of a text over the bits
+        return static_cast<uint32_t>(key * 2654435769u) % NGRAM_FILTER_BITS;
+    }
+};
+
+/**
+ * @param msg - the message
+ * @param dataBase - hashMap that contain all the bad sequences and their equivalent wroth
+ * @return - the total points the message got
+ */
+inline long getTotalPoints(const std::string& msg, const HashMap<std::string, int> &dataBase)
+{
+    const std::string lowerCaseMsg = lowerStringCase(msg);
+    const std::unique_ptr<NGramFilter> filter(new NGramFilter(lowerCaseMsg));
+    long totalPoints = 0;
+    std::string pattern; // reused, so the loop allocates only to grow it
+    const auto dataBaseEnd = dataBase.cend();
+    for(auto it = dataBase.cbegin(); it != dataBaseEnd; ++it)
+    {
+        pattern = it->first;
+        lowerStringCaseInPlace(pattern);
+        if(filter->mayContain(pattern))
+        {
+            long numberOfTimesInText = countNumberOfLowerCaseStrInStr(lowerCaseMsg, pattern);
+            totalPoints += numberOfTimesInText * it->second;
+        }
+    }
+    return totalPoints;
+}
+
+/**
+ * @param dataBase - hashMap that contain all the bad sequences and their equivalent wroth
+ * @return - the bad sequences in lower case, with the bad sequences that are equal up to case
+ *           folded into one with the sum of their points, sorted from the highest points down
+ */
+inline std::vector<std::pair<std::string, long>> sortPatternsByPoints(\
+                                                        const HashMap<std::string, int> &dataBase)
+{
+    HashMap<std::string, long> lowerCaseDataBase;
+    const auto dataBaseEnd = dataBase.cend();
+    for(auto it = dataBase.cbegin(); it != dataBaseEnd; ++it)
+    {
+        lowerCaseDataBase[lowerStringCase(it->first)] += it->second;
+    }
+    std::vector<std::pair<std::string, long>> patterns;
+    const auto lowerCaseDataBaseEnd = lowerCaseDataBase.cend();
+    for(auto it = lowerCaseDataBase.cbegin(); it != lowerCaseDataBaseEnd; ++it)
+    {
+        if(it->second > 0)
+        {
+            patterns.push_back(*it);
+        }
+    }
+    using Pattern = std::pair<std::string, long>;
+    std::stable_sort(patterns.begin(), patterns.end(), \
+                     [](const Pattern& a, const Pattern& b)
+                     {
+                         return a.second > b.second;
+                     });
+    return patterns;
+}
+
+/**
+ * Count the points of the message only until they reach the threshold. The message is scanned
+ * from its start in blocks of EARLY_EXIT_BLOCK_SIZE bytes, and in every block the patterns are
+ * tried from the highest points down, so a spam message is usually decided within its first
+ * blocks. Every pattern continues its search where it stopped in the previous block, so a whole
+ * scan costs the same as getTotalPoints and counts the same occurrences.
+ * @param lowerCaseMsg - the message in lower case
+ * @param patterns - the patterns as returned by sortPatternsByPoints
+ * @param threshold - the threshold
+ * @return - the total points of the message if they are below the threshold, otherwise the
+ *           points that were counted until the threshold was reached
+ */
+inline long getTotalPointsUpToThreshold(const std::string& lowerCaseMsg, \
+                                        const std::vector<std::pair<std::string, long>> &patterns, \
+                                        long threshold)
+{
+    const std::size_t msgLength = lowerCaseMsg.length();
+    const std::unique_ptr<NGramFilter> filter(new NGramFilter(lowerCaseMsg));
+    std::vector<std::size_t> searchFrom(patterns.size(), 0);
+    for(std::size_t i = 0; i < patterns.size(); ++i)
+    {
+        if(!filter->mayContain(patterns[i].first))
+        {
+            // never searched again
+            searchFrom[i] = msgLength;
+        }
+    }
+    long totalPoints = 0;
+    std::size_t blockEnd = 0;
+    do
+    {
+        blockEnd = std::min(msgLength, blockEnd + EARLY_EXIT_BLOCK_SIZE);
+        for(std::size_t i = 0; i < patterns.size(); ++i)
+        {
+            const std::string& pattern = patterns[i].first;
+            // occurrences that start in the block end before windowEnd
+            const std::size_t windowEnd = std::min(msgLength, blockEnd + pattern.length() - 1);
+            while(searchFrom[i] < blockEnd)
+            {
+                const void *found = memmem(lowerCaseMsg.data() + searchFrom[i], \
+                                           windowEnd - searchFrom[i], pattern.data(), \
+                                           pattern.length());
+                if(found == nullptr)
+                {
+                    searchFrom[i] = blockEnd;
+                    break;
+                }
+                searchFrom[i] = static_cast<const char *>(found) - lowerCaseMsg.data() + \
+                                pattern.length();
+                totalPoints += patterns[i].second;
+                if(totalPoints >= threshold)
+                {
+                    return totalPoints;
+                }
+            }
+        }
+    } while(blockEnd < msgLength);
+    return totalPoints;
+}
+
+/**
+ * Rewrite a text as its words (maximal runs of letters and digits) in lower case separated by
+ * single spaces, so that a sequence of words is a substring of the result however it was
+ * separated in the text
+ * @param text - the text
+ * @param wordStarts - set to the offset in the result of every word
+ * @return - the words of the text
+ */
+inline std::string normalizeWords(const boost::string_view& text, \
+                                  std::vector<std::size_t>& wordStarts)
+{
+    std::string words;
+    words.reserve(text.length());
+    wordStarts.clear();
+    bool inWord = false;
+    for(char c : text)
+    {
+        const bool wordCharacter = std::isalnum(static_cast<unsigned char>(c)) != 0;
+        if(wordCharacter && !inWord)
+        {
+            if(!words.empty())
+            {
+                words.push_back(' ');
+            }
+            wordStarts.push_back(words.length());
+        }
+        if(wordCharacter)
+        {
+            words.push_back(static_cast<char>(std::tolower(static_cast<unsigned char>(c))));
+        }
+        inWord = wordCharacter;
+    }
+    return words;
+}
+
+/**
+ * The data base of --tokens: every bad sequence as normalizeWords writes it, so a message is
+ * scored by looking up each of its word n-grams instead of searching for every bad sequence.
+ * The keys of points are views into patterns, so the struct can be neither copied nor moved.
+ */
+struct TokenDataBase
+{
+    std::vector<std::string> patterns; /**< owns the strings the keys of points view */
+    /** points by pattern, frozen once the data base is built */
+    FrozenHashMap<boost::string_view, long, boost::hash<boost::string_view>> points;
+    std::size_t maxWords = 0; /**< the number of words in the longest pattern */
+
+    TokenDataBase() = default;
+    TokenDataBase(const TokenDataBase&) = delete;
+    TokenDataBase& operator=(const TokenDataBase&) = delete;
+};
+
+/**
+ * @param dataBase - hashMap that contain all the bad sequences and their equivalent wroth
+ * @param tokens - filled with the bad sequences as words; the bad sequences that have the same
+ *                 words are folded into one with the sum of their points, and the bad sequences
+ *                 without any word are dropped
+ */
+inline void buildTokenDataBase(const HashMap<std::string, int> &dataBase, TokenDataBase& tokens)
+{
+    HashMap<std::string, long> folded;
+    std::vector<std::size_t> wordStarts;
+    const auto dataBaseEnd = dataBase.cend();
+    for(auto it = dataBase.cbegin(); it != dataBaseEnd; ++it)
+    {
+        std::string words = normalizeWords(it->first, wordStarts);
+        if(!words.empty())
+        {
+            folded[words] += it->second;
+            tokens.maxWords = std::max(tokens.maxWords, wordStarts.size());
+        }
+    }
+    // all the patterns are stored before the first view into them is taken
+    tokens.patterns.reserve(folded.size());
+    const auto foldedEnd = folded.cend();
+    for(auto it = folded.cbegin(); it != foldedEnd; ++it)
+    {
+        tokens.patterns.push_back(it->first);
+    }
+    std::vector<std::pair<boost::string_view, long>> points;
+    points.reserve(tokens.patterns.size());
+    for(const std::string& pattern : tokens.patterns)
+    {
+        points.emplace_back(boost::string_view(pattern), folded.at(pattern));
+    }
+    tokens.points = FrozenHashMap<boost::string_view, long, \
+                                  boost::hash<boost::string_view>>(std::move(points));
+}
+
+/**
+ * Count the points of the message in --tokens mode: every run of 1 to tokens.maxWords words of
+ * the message is looked up, without a copy, in tokens.points. The runs are looked up in batches,
+ * so the cache misses of nearby runs overlap. The cost depends on the length of the message and
+ * not on the size of the data base.
+ * @param msg - the message
+ * @param tokens - the data base
+ * @param threshold - the scan stops once the points reach it
+ * @return - the total points of the message if they are below the threshold, otherwise the
+ *           points that were counted until the threshold was reached
+ */
+inline long getTotalPointsOfTokens(const std::string& msg, const TokenDataBase& tokens, \
+                                   long threshold)
+{
+    std::vector<std::size_t> wordStarts;
+    const std::string words = normalizeWords(msg, wordStarts);
+    const std::size_t numOfWords = wordStarts.size();
+    long totalPoints = 0;
+    boost::string_view nGrams[HASHMAP_FIND_BATCH];
+    const long *points[HASHMAP_FIND_BATCH];
+    std::size_t numOfNGrams = 0;
+    // add the points of the batch in the order of the runs, so the scan stops where it would
+    // stop if the runs were looked up one by one
+    auto addBatch = [&]() -> bool
+    {
+        tokens.points.findBatch(nGrams, numOfNGrams, points);
+        for(std::size_t i = 0; i < numOfNGrams; ++i)
+        {
+            if(points[i] != nullptr)
+            {
+                totalPoints += *points[i];
+                if(totalPoints >= threshold)
+                {
+                    return true;
+                }
+            }
+        }
+        numOfNGrams = 0;
+        return false;
+    };
+    for(std::size_t first = 0; first < numOfWords; ++first)
+    {
+        for(std::size_t last = first; last < numOfWords && last - first < tokens.maxWords; ++last)
+        {
+            // the word ends at the space before the next word, or at the end of the words
+            const std::size_t end = last + 1 < numOfWords ? wordStarts[last + 1] - 1 : \
+                                    words.length();
+            nGrams[numOfNGrams++] = boost::string_view(words.data() + wordStarts[first], \
+                                                       end - wordStarts[first]);
+            if(numOfNGrams == HASHMAP_FIND_BATCH && addBatch())
+            {
+                return totalPoints;
+            }
+        }
+    }
+    addBatch();
+    return totalPoints;
+}
+
+/**
+ * @param str - the threshold as given by the user
+ * @param threshold - set to the threshold
+ * @return - true if the threshold is a positive number, false otherwise
+ */
+inline bool parseThreshold(const std::string& str, long& threshold)
+{
+    if(str.empty() || str.length() > MAX_THRESHOLD_DIGITS || !strContainOnlyDigits(str))
+    {
+        return false;
+    }
+    threshold = std::stol(str);
+    return threshold > 0;
+}
+
+/**
+ * Options that may be given on the command line before the positional arguments
+ */
+struct ScanOptions
+{
+    bool dbCompiled = false; /**< the data base path is an image written by 'compile' */
+    std::vector<std::string> deltaPaths; /**< delta files to apply to the data base, in order */
+    bool earlyExit = false; /**< stop scanning a message once it reached the threshold */
+    bool tokens = false; /**< match the bad sequences only as whole words */
+    bool cache = false; /**< cache the scores, set by --cache and by --cache-size */
+    std::string cachePath; /**< file the score cache is kept in between runs, if not empty */
+    std::size_t cacheSize = CACHE_DEFAULT_SIZE; /**< the most scores the cache keeps */
+    bool cacheStats = false; /**< print the counters of the cache */
+    bool explain = false; /**< write the bad sequences that added the most points */
+    bool profile = false; /**< write the bad sequences that took the longest to search for */
+};
+
+/**
+ * Parse the options that come before the positional arguments of the command line
+ * @param argc - number of argument in the command line
+ * @param argv - array of string that contain all the command line arguments
+ * @param firstIndex - index in argv of the first option
+ * @param options - the options to fill
+ * @return - the index of the first positional argument, or FAILURE on an unknown option
+ */
+inline int parseScanOptions(int argc, char* argv[], int firstIndex, ScanOptions& options)
+{
+    int argIndex = firstIndex;
+    for(; argIndex < argc && std::strncmp(argv[argIndex], "--", 2) == 0; ++argIndex)
+    {
+        if(std::strcmp(argv[argIndex], DB_COMPILED_FLAG) == 0)
+        {
+            options.dbCompiled = true;
+        }
+        else if(std::strcmp(argv[argIndex], EARLY_EXIT_FLAG) == 0)
+        {
+            options.earlyExit = true;
+        }
+        else if(std::strcmp(argv[argIndex], TOKENS_FLAG) == 0)
+        {
+            options.tokens = true;
+        }
+        else if(std::strcmp(argv[argIndex], EXPLAIN_FLAG) == 0)
+        {
+            options.explain = true;
+        }
+        else if(std::strcmp(argv[argIndex], PROFILE_FLAG) == 0)
+        {
+            options.profile = true;
+        }
+        else if(std::strcmp(argv[argIndex], CACHE_STATS_FLAG) == 0)
+        {
+            options.cacheStats = true;
+        }
+        else if(std::strcmp(argv[argIndex], CACHE_FLAG) == 0 && argIndex + 1 < argc)
+        {
+            options.cache = true;
+            options.cachePath = argv[++argIndex];
+        }
+        else if(std::strcmp(argv[argIndex], CACHE_SIZE_FLAG) == 0 && argIndex + 1 < argc)
+        {
+            long cacheSize = 0;
+            if(!parseThreshold(argv[++argIndex], cacheSize))
+            {
+                return FAILURE;
+            }
+            options.cache = true;
+            options.cacheSize = static_cast<std::size_t>(cacheSize);
+        }
+        else if(std::strcmp(argv[argIndex], DB_DELTA_FLAG) == 0 && argIndex + 1 < argc)
+        {
+            options.deltaPaths.push_back(argv[++argIndex]);
+        }
+        else
+        {
+            return FAILURE;
+        }
+    }
+    // the explanation is of the default engine, it would not explain a --tokens score
+    return options.tokens && (options.explain || options.profile) ? FAILURE : argIndex;
+}
+
+/**
+ * Load the data base, as a csv or as a compiled image according to the options, and apply the
+ * delta files that were given
+ * @param dataBase - hashMap to insert the data into.
+ * @param argv - argv (command line parameters)
+ * @param gDatBaseIndex - index in argv that contains dataBase path
+ * @param options - the command line options
+ * @param invalidLine - set to the (1 based) number of the first invalid line, if there is one
+ * @return true, if succeed, false otherwise.
+ */
+inline bool loadDataBase(HashMap<std::string, int>& dataBase, char* argv[], \
+                         const int& gDatBaseIndex, const ScanOptions& options, long& invalidLine)
+{
+    invalidLine = 0;
+    bool loaded = false;
+    if(options.dbCompiled)
+    {
+        loaded = insertCompiledDataBaseToHashMap(dataBase, argv, gDatBaseIndex);
+    }
+    else
+    {
+        loaded = insertDataFromDataBaseToHashMap(dataBase, argv, gDatBaseIndex, invalidLine);
+    }
+    for(size_t i = 0; loaded && i < options.deltaPaths.size(); ++i)
+    {
+        loaded = applyDeltaFileToHashMap(dataBase, options.deltaPaths[i].c_str(), invalidLine);
+    }
+    return loaded;
+}
+
+/**
+ * A data base that messages are scored with, together with everything that is derived from it.
+ * A snapshot never changes once it is built; a reload builds a new snapshot and publishes it, and
+ * every scoring thread keeps a shared_ptr to the snapshot it started with.
+ */
+struct DataBaseSnapshot
+{
+    HashMap<std::string, int> dataBase; /**< the bad sequences and their points */
+    unsigned long version = 0; /**< number of the load that built the snapshot */
+    std::vector<std::pair<std::string, long>> patternsByPoints; /**< for --early-exit */
+    TokenDataBase tokenDataBase; /**< for --tokens */
+    uint64_t cacheVersion = 0; /**< identifies the data base in the keys of the score cache */
+};
+
+/**
+ * @param argv - argv (command line parameters)
+ * @param gDatBaseIndex - index in argv that contains dataBase path
+ * @param options - the command line options
+ * @return - the inode, size and modification time of the data base file and the delta files
+ */
+inline std::string dataBaseFilesState(char* argv[], const int& gDatBaseIndex, \
+                                      const ScanOptions& options)
+{
+    std::string state;
+    std::vector<std::string> paths(1, argv[gDatBaseIndex]);
+    paths.insert(paths.end(), options.deltaPaths.begin(), options.deltaPaths.end());
+    for(const std::string& filePath : paths)
+    {
+        struct stat fileStat = {};
+        if(stat(filePath.c_str(), &fileStat) == FAILURE)
+        {
+            state += "-;";
+            continue;
+        }
+        state += std::to_string(fileStat.st_ino) + "," + std::to_string(fileStat.st_size) + \
+                 "," + std::to_string(fileStat.st_mtim.tv_sec) + "." + \
+                 std::to_string(fileStat.st_mtim.tv_nsec) + ";";
+    }
+    return state;
+}
+
+/**
+ * The version of the data base in the keys of the score cache. It is derived from the state of
+ * the files and not from their content, so that a cached score is found without loading them.
+ * @param argv - argv (command line parameters)
+ * @param gDatBaseIndex - index in argv that contains dataBase path
+ * @param options - the command line options
+ * @return - the version of the data base files as they are now
+ */
+inline uint64_t dataBaseCacheVersion(char* argv[], const int& gDatBaseIndex, \
+                                     const ScanOptions& options)
+{
+    // the matching mode changes the scores, so it is part of the version
+    std::string state = dataBaseFilesState(argv, gDatBaseIndex, options) + \
+                        (options.tokens ? TOKENS_FLAG : "");
+    return fnv1aChecksum(state.data(), state.length());
+}
+
+/**
+ * Load the data base into a new snapshot
+ * @param argv - argv (command line parameters)
+ * @param gDatBaseIndex - index in argv that contains dataBase path
+ * @param options - the command line options
+ * @param version - version of the new snapshot
+ * @param invalidLine - set to the (1 based) number of the first invalid line, if there is one
+ * @return - the snapshot, or nullptr if the data base is invalid
+ */
+inline std::shared_ptr<const DataBaseSnapshot> buildDataBaseSnapshot(char* argv[], \
+                                                                     const int& gDatBaseIndex, \
+                                                                     const ScanOptions& options, \
+                                                                     unsigned long version, \
+                                                                     long& invalidLine)
+{
+    std::shared_ptr<DataBaseSnapshot> snapshot = std::make_shared<DataBaseSnapshot>();
+    snapshot->version = version;
+    // taken before loading, so a change during the load gives the next snapshot a new version
+    snapshot->cacheVersion = dataBaseCacheVersion(argv, gDatBaseIndex, options);
+    if(!loadDataBase(snapshot->dataBase, argv, gDatBaseIndex, options, invalidLine))
+    {
+        return nullptr;
+    }
+    if(options.tokens)
+    {
+        buildTokenDataBase(snapshot->dataBase, snapshot->tokenDataBase);
+    }
+    else if(options.earlyExit)
+    {
+        snapshot->patternsByPoints = sortPatternsByPoints(snapshot->dataBase);
+    }
+    return snapshot;
+}
+
+/**
+ * Score a message with the engine that was chosen on the command line
+ * @param msg - the message
+ * @param snapshot - the data base
+ * @param options - the command line options
+ * @param threshold - the threshold of the message
+ * @return - the total points the message got (see getTotalPointsUpToThreshold for --early-exit)
+ */
+inline long scoreMessage(const std::string& msg, const DataBaseSnapshot& snapshot, \
+                         const ScanOptions& options, long threshold)
+{
+    if(options.tokens)
+    {
+        return getTotalPointsOfTokens(msg, snapshot.tokenDataBase, \
+                                      options.earlyExit ? threshold : \
+                                                          std::numeric_limits<long>::max());
+    }
+    if(options.earlyExit)
+    {
+        return getTotalPointsUpToThreshold(lowerStringCase(msg), snapshot.patternsByPoints, \
+                                           threshold);
+    }
+    return getTotalPoints(msg, snapshot.dataBase);
+}
+
+/**
+ *
+ * @param argv - the command line argument
+ * @param gMsgIndex - index of the msg in the command line argument
+ * @param snapshot - the data base
+ * @param options - the command line options
+ * @param threshold - the threshold of the message
+ * @return -1 if failed to open the file, non-negative otherwise that represent the total pointer
+ *          the file got
+ */
+inline long getTotalFilePoint(char* argv[], const int gMsgIndex, const DataBaseSnapshot& snapshot, \
+                              const ScanOptions& options, long threshold)
+{
+
+    boost::filesystem::path p(argv[gMsgIndex]);
+    // checking if the path actually exist
+    if (!boost::filesystem::exists(p))
+    {
+        return FAILURE;
+    }
+    // convert the file input to string
+    std::ifstream tmp(argv[gMsgIndex]);
+    std::stringstream msg;
+    msg << tmp.rdbuf();
+    return scoreMessage(msg.str(), snapshot, options, threshold);
+}
+
+/**
+ * @param x - 64 bits
+ * @param r - number of bits to rotate by, 0 < r < 64
+ * @return - x rotated left by r bits
+ */
+inline uint64_t rotateLeft(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+/**
+ * @param k - 64 bits
+ * @return - k with every bit of it mixed into all the others
+ */
+inline uint64_t finalMix(uint64_t k)
+{
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+    return k;
+}
+
+/**
+ * MurmurHash3 (x64, 128 bits) of a buffer, with seed 0
+ * @param data - the buffer
+ * @param length - the length of the buffer
+ * @param low - set to the low 64 bits of the hash
+ * @param high - set to the high 64 bits of the hash
+ */
+inline void murmurHash128(const char *data, size_t length, uint64_t& low, uint64_t& high)
+{
+    uint64_t h1 = 0;
+    uint64_t h2 = 0;
+    const size_t numOfBlocks = length / 16;
+    for(size_t i = 0; i < numOfBlocks; ++i)
+    {
+        uint64_t k1 = 0;
+        uint64_t k2 = 0;
+        std::memcpy(&k1, data + i * 16, sizeof(k1));
+        std::memcpy(&k2, data + i * 16 + 8, sizeof(k2));
+        h1 ^= rotateLeft(k1 * MURMUR_C1, 31) * MURMUR_C2;
+        h1 = (rotateLeft(h1, 27) + h2) * 5 + 0x52dce729;
+        h2 ^= rotateLeft(k2 * MURMUR_C2, 33) * MURMUR_C1;
+        h2 = (rotateLeft(h2, 31) + h1) * 5 + 0x38495ab5;
+    }
+
+    const unsigned char *tail = reinterpret_cast<const unsigned char *>(data) + numOfBlocks * 16;
+    const size_t tailLength = length % 16;
+    uint64_t k1 = 0;
+    uint64_t k2 = 0;
+    for(size_t i = 0; i < tailLength; ++i)
+    {
+        if(i < 8)
+        {
+            k1 |= static_cast<uint64_t>(tail[i]) << (i * 8);
+        }
+        else
+        {
+            k2 |= static_cast<uint64_t>(tail[i]) << ((i - 8) * 8);
+        }
+    }
+    if(tailLength > 8)
+    {
+        h2 ^= rotateLeft(k2 * MURMUR_C2, 33) * MURMUR_C1;
+    }
+    if(tailLength > 0)
+    {
+        h1 ^= rotateLeft(k1 * MURMUR_C1, 31) * MURMUR_C2;
+    }
+
+    h1 ^= length;
+    h2 ^= length;
+    h1 += h2;
+    h2 += h1;
+    h1 = finalMix(h1);
+    h2 = finalMix(h2);
+    h1 += h2;
+    h2 += h1;
+    low = h1;
+    high = h2;
+}
+
+/**
+ * The key of a score in the score cache
+ */
+struct ScoreCacheKey
+{
+    uint64_t low; /**< low 64 bits of the hash of the message */
+    uint64_t high; /**< high 64 bits of the hash of the message */
+    uint64_t version; /**< version of the data base the message was scored with */
+
+    /**
+     * @param other - other key
+     * @return - true if both keys are the same, false otherwise
+     */
+    bool operator == (const ScoreCacheKey& other) const
+    {
+        return low == other.low && high == other.high && version == other.version;
+    }
+};
+
+/**
+ * The hash of a ScoreCacheKey in the score cache
+ */
+struct ScoreCacheKeyHash
+{
+    /**
+     * @param key - key
+     * @return - the hash of the key
+     */
+    std::size_t operator()(const ScoreCacheKey& key) const
+    {
+        // the message bits are already a good hash
+        return static_cast<std::size_t>(key.low ^ (key.version * FNV_PRIME));
+    }
+};
+
+/**
+ * @param msg - the message
+ * @param version - the version of the data base
+ * @return - the key of the score of the message with that data base
+ */
+inline ScoreCacheKey makeScoreCacheKey(const std::string& msg, uint64_t version)
+{
+    ScoreCacheKey key = {0, 0, version};
+    murmurHash128(msg.data(), msg.length(), key.low, key.high);
+    return key;
+}
+
+/**
+ * The header of a score cache file. It is followed by the entries, from the least recently used.
+ */
+struct ScoreCacheFileHeader
+{
+    char magic[4]; /**< CACHE_FILE_MAGIC */
+    uint32_t version; /**< CACHE_FILE_VERSION */
+    uint64_t numOfEntries; /**< number of entries in the file */
+    uint64_t hits; /**< the hit counter */
+    uint64_t misses; /**< the miss counter */
+    uint64_t checksum; /**< fnv1aChecksum of the entries */
+};
+
+/**
+ * An entry of a score cache file
+ */
+struct ScoreCacheFileEntry
+{
+    uint64_t low; /**< ScoreCacheKey::low */
+    uint64_t high; /**< ScoreCacheKey::high */
+    uint64_t version; /**< ScoreCacheKey::version */
+    int64_t score; /**< the score */
+    uint64_t partial; /**< 1 if the score is partial, 0 otherwise */
+};
+
+/**
+ * A bounded cache of message scores, that drops the least recently used score when it is full.
+ * A score counted with --early-exit that reached the threshold is kept as partial - it answers a
+ * later lookup only if it reaches that lookup's threshold too. All the methods are thread safe.
+ */
+class ScoreCache
+{
+private:
+    /**
+     * a cached score
+     */
+    struct Score
+    {
+        long score; /**< the score */
+        bool partial; /**< the score was counted only until it reached the threshold */
+    };
+
+    LruHashMap<ScoreCacheKey, Score, ScoreCacheKeyHash> _entries; /**< the scores */
+    unsigned long _hits = 0; /**< number of lookups that found a score */
+    unsigned long _misses = 0; /**< number of lookups that did not find a score */
+    mutable std::mutex _mutex; /**< guards all the members */
+
+public:
+    /**
+     * Constructor
+     * @param capacity - the most entries the cache keeps, at least 1
+     */
+    explicit ScoreCache(std::size_t capacity) : \
+             _entries(std::min<std::size_t>(std::max<std::size_t>(capacity, 1), \
+                                            LRU_HASHMAP_NONE - 1))
+    {
+    }
+
+    /**
+     * Look a score up, and count the lookup as a hit or a miss
+     * @param key - the key
+     * @param threshold - the threshold of the message
+     * @param score - set to the score if it was found
+     * @return - true if the score was found, false otherwise
+     */
+    bool find(const ScoreCacheKey& key, long threshold, long& score)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        const Score *cached = _entries.peek(key);
+        if(cached == nullptr || (cached->partial && cached->score < threshold))
+        {
+            ++_misses;
+            return false;
+        }
+        score = _entries.find(key)->score;
+        ++_hits;
+        return true;
+    }
+
+    /**
+     * Add a score to the cache
+     * @param key - the key
+     * @param score - the score
+     * @param partial - the score was counted only until it reached the threshold
+     */
+    void insert(const ScoreCacheKey& key, long score, bool partial)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _entries.insert(key, {score, partial});
+    }
+
+    /**
+     * Add the entries and the counters of a file that save wrote. A missing or damaged file is
+     * ignored, the cache then just starts empty.
+     * @param filePath - path of the file
+     * @return - true if the file was loaded, false otherwise
+     */
+    bool load(const std::string& filePath)
+    {
+        std::string content;
+        ScoreCacheFileHeader header = {};
+        if(filePath.empty() || !readFileToString(filePath.c_str(), content) || \
+           content.length() < sizeof(header))
+        {
+            return false;
+        }
+        std::memcpy(&header, content.data(), sizeof(header));
+        const char *payload = content.data() + sizeof(header);
+        const std::size_t payloadSize = content.length() - sizeof(header);
+        if(std::memcmp(header.magic, CACHE_FILE_MAGIC, sizeof(header.magic)) != 0 || \
+           header.version != CACHE_FILE_VERSION || \
+           payloadSize != header.numOfEntries * sizeof(ScoreCacheFileEntry) || \
+           fnv1aChecksum(payload, payloadSize) != header.checksum)
+        {
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(_mutex);
+        _hits += header.hits;
+        _misses += header.misses;
+        for(uint64_t i = 0; i < header.numOfEntries; ++i)
+        {
+            ScoreCacheFileEntry fileEntry = {};
+            std::memcpy(&fileEntry, payload + i * sizeof(fileEntry), sizeof(fileEntry));
+            _entries.insert({fileEntry.low, fileEntry.high, fileEntry.version}, \
+                            {static_cast<long>(fileEntry.score), fileEntry.partial != 0});
+        }
+        return true;
+    }
+
+    /**
+     * Write the entries and the counters to a file. The file is replaced at once, so a run that
+     * loads it meanwhile sees either the old or the new cache.
+     * @param filePath - path of the file
+     * @return - true if succeed, false otherwise
+     */
+    bool save(const std::string& filePath) const
+    {
+        std::string payload;
+        ScoreCacheFileHeader header = {};
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _entries.forEachFromOldest([&payload](const ScoreCacheKey& key, const Score& score)
+                                       {
+                                           ScoreCacheFileEntry fileEntry = \
+                                               {key.low, key.high, key.version, score.score, \
+                                                score.partial ? 1U : 0U};
+                                           payload.append(\
+                                               reinterpret_cast<const char *>(&fileEntry), \
+                                               sizeof(fileEntry));
+                                       });
+            header.numOfEntries = _entries.size();
+            header.hits = _hits;
+            header.misses = _misses;
+        }
+        std::memcpy(header.magic, CACHE_FILE_MAGIC, sizeof(header.magic));
+        header.version = CACHE_FILE_VERSION;
+        header.checksum = fnv1aChecksum(payload.data(), payload.length());
+
+        const std::string tempPath = filePath + CACHE_TEMP_SUFFIX + std::to_string(getpid());
+        {
+            std::ofstream output(tempPath, std::ios::binary | std::ios::trunc);
+            output.write(reinterpret_cast<const char *>(&header), sizeof(header));
+            output.write(payload.data(), payload.length());
+            if(!output.flush())
+            {
+                std::remove(tempPath.c_str());
+                return false;
+            }
+        }
+        return std::rename(tempPath.c_str(), filePath.c_str()) == 0;
+    }
+
+    /**
+     * @return - number of lookups that found a score
+     */
+    unsigned long hits() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _hits;
+    }
+
+    /**
+     * @return - number of lookups that did not find a score
+     */
+    unsigned long misses() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _misses;
+    }
+
+    /**
+     * @return - number of scores in the cache
+     */
+    std::size_t size() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _entries.size();
+    }
+};
+
+/**
+ * Score a message, or take its score from the cache if it was already scored with this data base
+ * @param msg - the message
+ * @param snapshot - the data base
+ * @param options - the command line options
+ * @param threshold - the threshold of the message
+ * @param cache - the score cache
+ * @return - the total points the message got, as scoreMessage returns them
+ */
+inline long scoreMessageWithCache(const std::string& msg, const DataBaseSnapshot& snapshot, \
+                                  const ScanOptions& options, long threshold, ScoreCache& cache)
+{
+    const ScoreCacheKey key = makeScoreCacheKey(msg, snapshot.cacheVersion);
+    long totalPoints = 0;
+    if(!cache.find(key, threshold, totalPoints))
+    {
+        totalPoints = scoreMessage(msg, snapshot, options, threshold);
+        cache.insert(key, totalPoints, options.earlyExit && threshold <= totalPoints);
+    }
+    return totalPoints;
+}
+
+/**
+ * What --explain and --profile record about one bad sequence
+ */
+struct PatternProfile
+{
+    std::string pattern; /**< the bad sequence */
+    long matches; /**< number of times it is in the message */
+    long points; /**< points it added to the score */
+    long nanoseconds; /**< time spent searching for it */
+};
+
+/**
+ * Score a message like getTotalPoints, and record the matches, points and time of every bad
+ * sequence
+ * @param msg - the message
+ * @param dataBase - hashMap that contain all the bad sequences and their equivalent wroth
+ * @param profiles - set to the record of every bad sequence
+ * @return - the total points the message got
+ */
+inline long profileMessage(const std::string& msg, const HashMap<std::string, int> &dataBase, \
+                           std::vector<PatternProfile>& profiles)
+{
+    const std::string lowerCaseMsg = lowerStringCase(msg);
+    const std::unique_ptr<NGramFilter> filter(new NGramFilter(lowerCaseMsg));
+    long totalPoints = 0;
+    profiles.clear();
+    const auto dataBaseEnd = dataBase.cend();
+    for(auto it = dataBase.cbegin(); it != dataBaseEnd; ++it)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        const std::string pattern = lowerStringCase(it->first);
+        long matches = 0;
+        if(filter->mayContain(pattern))
+        {
+            matches = countNumberOfLowerCaseStrInStr(lowerCaseMsg, pattern);
+        }
+        const auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(\
+                                 std::chrono::steady_clock::now() - start).count();
+        profiles.push_back({it->first, matches, matches * it->second, \
+                            static_cast<long>(nanoseconds)});
+        totalPoints += matches * it->second;
+    }
+    return totalPoints;
+}
+
+/**
+ * @param str - string
+ * @return - the string as a JSON string literal, with the quotes
+ */
+inline std::string jsonString(const std::string& str)
+{
+    std::string json = "\"";
+    for(char c : str)
+    {
+        if(c == '"' || c == '\\')
+        {
+            json += '\\';
+            json += c;
+        }
+        else if(static_cast<unsigned char>(c) < 0x20)
+        {
+            char escaped[7];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned char>(c));
+            json += escaped;
+        }
+        else
+        {
+            json += c;
+        }
+    }
+    return json + "\"";
+}
+
+/**
+ * @param name - the name of the JSON member
+ * @param profiles - the records of the bad sequences, in the order to write
+ * @param timed - write the time spent on every bad sequence
+ * @return - a JSON member whose value is an array of the first EXPLAIN_TOP_PATTERNS records
+ */
+inline std::string jsonProfiles(const std::string& name, \
+                                const std::vector<PatternProfile>& profiles, bool timed)
+{
+    std::string json = jsonString(name) + ":[";
+    const std::size_t numOfProfiles = std::min<std::size_t>(profiles.size(), \
+                                                            EXPLAIN_TOP_PATTERNS);
+    for(std::size_t i = 0; i < numOfProfiles; ++i)
+    {
+        json += std::string(i == 0 ? "" : ",") + "{\"pattern\":" + \
+                jsonString(profiles[i].pattern) + ",\"matches\":" + \
+                std::to_string(profiles[i].matches) + ",\"points\":" + \
+                std::to_string(profiles[i].points);
+        if(timed)
+        {
+            json += ",\"nanoseconds\":" + std::to_string(profiles[i].nanoseconds);
+        }
+        json += "}";
+    }
+    return json + "]";
+}
+
+/**
+ * Score the message file with profileMessage, and write to stderr a JSON object with the score,
+ * the bad sequences that added the most points (for --explain) and the bad sequences that took
+ * the longest to search for (for --profile)
+ * @param argv - the command line argument
+ * @param gMsgIndex - index of the msg in the command line argument
+ * @param snapshot - the data base
+ * @param options - the command line options
+ * @param threshold - the threshold of the message
+ * @return -1 if failed to read the file, non-negative otherwise that represent the total pointer
+ *          the file got
+ */
+inline long explainFilePoint(char* argv[], const int gMsgIndex, const DataBaseSnapshot& snapshot, \
+                             const ScanOptions& options, long threshold)
+{
+    std::string msg;
+    if(!readFileToString(argv[gMsgIndex], msg))
+    {
+        return FAILURE;
+    }
+    std::vector<PatternProfile> profiles;
+    const auto start = std::chrono::steady_clock::now();
+    const long totalPoints = profileMessage(msg, snapshot.dataBase, profiles);
+    const auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(\
+                             std::chrono::steady_clock::now() - start).count();
+
+    long matchedPatterns = 0;
+    for(const PatternProfile& profile : profiles)
+    {
+        matchedPatterns += profile.matches > 0 ? 1 : 0;
+    }
+    std::string json = "{\"score\":" + std::to_string(totalPoints) + ",\"threshold\":" + \
+                       std::to_string(threshold) + ",\"verdict\":" + \
+                       jsonString(threshold <= totalPoints ? SPAM : NOT_SPAM) + \
+                       ",\"patterns\":" + std::to_string(profiles.size()) + \
+                       ",\"matchedPatterns\":" + std::to_string(matchedPatterns) + \
+                       ",\"nanoseconds\":" + std::to_string(nanoseconds);
+    if(options.explain)
+    {
+        std::vector<PatternProfile> contributors;
+        std::copy_if(profiles.begin(), profiles.end(), std::back_inserter(contributors), \
+                     [](const PatternProfile& profile) { return profile.matches > 0; });
+        std::stable_sort(contributors.begin(), contributors.end(), \
+                         [](const PatternProfile& a, const PatternProfile& b)
+                         {
+                             return a.points > b.points;
+                         });
+        json += "," + jsonProfiles("topContributors", contributors, options.profile);
+    }
+    if(options.profile)
+    {
+        std::stable_sort(profiles.begin(), profiles.end(), \
+                         [](const PatternProfile& a, const PatternProfile& b)
+                         {
+                             return a.nanoseconds > b.nanoseconds;
+                         });
+        json += "," + jsonProfiles("slowestPatterns", profiles, true);
+    }
+    std::cerr << json << "}" << std::endl;
+    return totalPoints;
+}
+
+/**
+ * Score a message file and print whether it is SPAM or NOT_SPAM - the command line tool without a
+ * subcommand. An invalid data base is reported with the number of its first invalid line.
+ * @param argc - number of argument in the command line
+ * @param argv - array of string that contain all the command line arguments
+ * @return 0 on success, 1 on failure
+ */
+inline int runScanCommand(int argc, char* argv[])
+{
+    ScanOptions options;
+    const int gDatBaseIndex = parseScanOptions(argc, argv, 1, options); // the data base location
+    const int gMsgIndex = gDatBaseIndex + 1;
+    const int gThresholdIndex = gDatBaseIndex + 2;
+    if(gDatBaseIndex == FAILURE || argc != gThresholdIndex + 1)
+    {
+        std::cerr << USAGE << std::endl;
+        return EXIT_FAILURE;
+    }
+    long threshold = 0;
+    if(!parseThreshold(argv[gThresholdIndex], threshold))
+    {
+        std::cerr << INVALID_INPUT << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::unique_ptr<ScoreCache> cache;
+    ScoreCacheKey cacheKey = {};
+    std::string msg;
+    long totalFilePoint = 0;
+    const bool explain = options.explain || options.profile;
+    if(!options.cachePath.empty() && !explain)
+    {
+        // a cached score is found before the data base is loaded
+        if(!readFileToString(argv[gMsgIndex], msg))
+        {
+            std::cerr << INVALID_INPUT << std::endl;
+            return EXIT_FAILURE;
+        }
+        cache.reset(new ScoreCache(options.cacheSize));
+        cache->load(options.cachePath);
+        cacheKey = makeScoreCacheKey(msg, dataBaseCacheVersion(argv, gDatBaseIndex, options));
+    }
+
+    if(cache == nullptr || !cache->find(cacheKey, threshold, totalFilePoint))
+    {
+        std::shared_ptr<const DataBaseSnapshot> snapshot;
+        long invalidLine = 0;
+        try
+        {
+            snapshot = buildDataBaseSnapshot(argv, gDatBaseIndex, options, 1, invalidLine);
+        }
+        catch (const std::bad_alloc& e)
+        {
+            std::cerr << ALLOCATION_FAILED << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        if(snapshot == nullptr)
+        {
+            std::cerr << INVALID_INPUT;
+            if(invalidLine > 0)
+            {
+                std::cerr << INVALID_LINE << invalidLine;
+            }
+            std::cerr << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        if(explain)
+        {
+            totalFilePoint = explainFilePoint(argv, gMsgIndex, *snapshot, options, threshold);
+        }
+        else if(cache == nullptr)
+        {
+            totalFilePoint = getTotalFilePoint(argv, gMsgIndex, *snapshot, options, threshold);
+        }
+        else
+        {
+            totalFilePoint = scoreMessage(msg, *snapshot, options, threshold);
+            cacheKey.version = snapshot->cacheVersion;
+            cache->insert(cacheKey, totalFilePoint, options.earlyExit && \
+                                                    threshold <= totalFilePoint);
+        }
+        if(totalFilePoint == FAILURE)
+        {
+            std::cerr << INVALID_INPUT << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    if(cache != nullptr)
+    {
+        cache->save(options.cachePath);
+        if(options.cacheStats)
+        {
+            std::cerr << CACHE_STATS_HITS << cache->hits() << CACHE_STATS_MISSES << \
+                      cache->misses() << CACHE_STATS_ENTRIES << cache->size() << std::endl;
+        }
+    }
+
+    if(threshold <= totalFilePoint)
+    {
+        std::cout << SPAM << std::endl;
+    }
+    else
+    {
+        std::cout << NOT_SPAM << std::endl;
+    }
+
+    return 0;
+}
+
+/**
+ * Scoring daemon. Keeps the data base in memory and scores the messages that are sent to it over
+ * a unix domain socket, with an epoll event loop that hands the requests to a pool of workers.
+ * Every request is one line, either "SCORE <threshold> <message path>" or
+ * "MESSAGE <threshold> <length>" followed by <length> bytes of message, and it is answered with
+ * one line - "<points> SPAM", "<points> NOT_SPAM" or "ERROR Invalid input"; "STATS" is answered
+ * with "STATS <hits> <misses> <entries>" of the score cache. The requests of a connection are
+ * answered in order. When the data base file or one of the delta files changes,
+ * a background thread loads the data base into a new snapshot and swaps it in atomically if it
+ * is valid; requests that are already being scored finish with the snapshot they started with,
+ * and the old snapshot is freed as soon as the last of them is done.
+ */
+class ScoringDaemon
+{
+private:
+    /**
+     * a client connection
+     */
+    struct Connection
+    {
+        unsigned long id = 0; /**< unique id of the connection */
+        std::string input; /**< bytes that were read and not handled yet */
+        std::string output; /**< bytes of responses that were not written yet */
+        bool busy = false; /**< a request of the connection is being scored */
+        bool inputClosed = false; /**< the client will not send more requests */
+        bool closing = false; /**< close the connection once its output was written */
+
+        /**
+         * @param other - other connection
+         * @return - true if both are the same connection, false otherwise
+         */
+        bool operator == (const Connection& other) const
+        {
+            return id == other.id;
+        }
+    };
+
+    /**
+     * a request waiting for a worker
+     */
+    struct Job
+    {
+        int fd; /**< fd of the connection */
+        unsigned long connectionId; /**< id of the connection */
+        long threshold; /**< threshold of the request */
+        bool inlineMessage; /**< the message is given in the request, and not as a path */
+        std::string message; /**< the message, or the path of the message */
+    };
+
+    /**
+     * a response waiting for the event loop
+     */
+    struct Result
+    {
+        int fd; /**< fd of the connection */
+        unsigned long connectionId; /**< id of the connection */
+        std::string response; /**< the response line */
+    };
+
+    char **_argv; /**< the command line arguments */
+    int _gDatBaseIndex; /**< index in argv that contains dataBase path */
+    ScanOptions _options; /**< the command line options */
+    std::shared_ptr<const DataBaseSnapshot> _snapshot; /**< current snapshot, atomic access only */
+    std::string _dataBaseFilesState; /**< state of the data base files when last loaded */
+    std::mutex _reloadMutex; /**< guards _dataBaseFilesState and _nextVersion */
+    std::unique_ptr<ScoreCache> _cache; /**< cache of scores, if it was asked for */
+    unsigned long _nextVersion = 1; /**< version of the next snapshot */
+    std::thread _reloader; /**< thread that loads the data base when it changes */
+    std::mutex _reloaderMutex; /**< guards _reloaderStopping */
+    std::condition_variable _reloaderCondition; /**< signaled when the reloader should stop */
+    bool _reloaderStopping = false; /**< the reloader should exit */
+    std::string _socketPath; /**< path of the listening socket, if there is one */
+    int _listenFd = FAILURE; /**< the listening socket */
+    int _epollFd = FAILURE; /**< the epoll instance */
+    int _eventFd = FAILURE; /**< signaled by the workers when there are results */
+    HashMap<int, Connection> _connections; /**< the open connections, by fd */
+    unsigned long _nextConnectionId = 1; /**< id of the next connection */
+    std::vector<std::thread> _workers; /**< the worker pool */
+    std::deque<Job> _jobs; /**< requests waiting for a worker */
+    std::mutex _jobsMutex; /**< guards _jobs and _stopping */
+    std::condition_variable _jobsCondition; /**< signaled when there are jobs or on stop */
+    bool _stopping = false; /**< the workers should exit */
+    std::deque<Result> _results; /**< responses waiting for the event loop */
+    std::mutex _resultsMutex; /**< guards _results */
+    std::atomic<bool> _stopRequested; /**< the event loop should exit */
+
+    /**
+     * Load the data base into a new snapshot, and publish it if it is valid
+     * @return - true if the data base was loaded, false otherwise
+     */
+    bool reloadDataBase()
+    {
+        // invalid files are not tried again until they change
+        _dataBaseFilesState = dataBaseFilesState(_argv, _gDatBaseIndex, _options);
+        std::shared_ptr<const DataBaseSnapshot> snapshot;
+        long invalidLine = 0;
+        try
+        {
+            snapshot = buildDataBaseSnapshot(_argv, _gDatBaseIndex, _options, _nextVersion, \
+                                             invalidLine);
+        }
+        catch (const std::bad_alloc& e)
+        {
+            std::cerr << ALLOCATION_FAILED << std::endl;
+            return false;
+        }
+        if(snapshot == nullptr)
+        {
+            std::cerr << INVALID_INPUT;
+            if(invalidLine > 0)
+            {
+                std::cerr << INVALID_LINE << invalidLine;
+            }
+            std::cerr << std::endl;
+            return false;
+        }
+        ++_nextVersion;
+        std::atomic_store(&_snapshot, snapshot);
+        return true;
+    }
+
+    /**
+     * The loop of the reloader thread - load the data base whenever its files change
+     */
+    void reloaderLoop()
+    {
+        std::unique_lock<std::mutex> lock(_reloaderMutex);
+        while(!_reloaderCondition.wait_for(lock, \
+                                           std::chrono::milliseconds(DAEMON_RELOAD_CHECK_MS), \
+                                           [this] { return _reloaderStopping; }))
+        {
+            lock.unlock();
+            reloadIfChanged();
+            lock.lock();
+        }
+    }
+
+    /**
+     * Score one request
+     * @param job - the request
+     * @return - the response line
+     */
+    std::string scoreJob(const Job& job)
+    {
+        std::shared_ptr<const DataBaseSnapshot> snapshot = std::atomic_load(&_snapshot);
+        std::string fileContent;
+        if(!job.inlineMessage && !readFileToString(job.message.c_str(), fileContent))
+        {
+            return std::string(DAEMON_ERROR) + INVALID_INPUT + "\n";
+        }
+        const std::string& msg = job.inlineMessage ? job.message : fileContent;
+        long totalPoints = 0;
+        if(_cache == nullptr)
+        {
+            totalPoints = scoreMessage(msg, *snapshot, _options, job.threshold);
+        }
+        else
+        {
+            totalPoints = scoreMessageWithCache(msg, *snapshot, _options, job.threshold, *_cache);
+        }
+        return std::to_string(totalPoints) + " " + \
+               (job.threshold <= totalPoints ? SPAM : NOT_SPAM) + "\n";
+    }
+
+    /**
+     * The loop of a worker thread - score requests until the daemon stops
+     */
+    void workerLoop()
+    {
+        while(true)
+        {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(_jobsMutex);
+                _jobsCondition.wait(lock, [this] { return _stopping || !_jobs.empty(); });
+                if(_stopping)
+                {
+                    return;
+                }
+                job = std::move(_jobs.front());
+                _jobs.pop_front();
+            }
+
+            Result result = {job.fd, job.connectionId, std::string()};
+            try
+            {
+                result.response = scoreJob(job);
+            }
+            catch (const std::bad_alloc& e)
+            {
+                result.response = std::string(DAEMON_ERROR) + ALLOCATION_FAILED + "\n";
+            }
+            {
+                std::lock_guard<std::mutex> lock(_resultsMutex);
+                _results.push_back(std::move(result));
+            }
+            uint64_t one = 1;
+            ssize_t written = write(_eventFd, &one, sizeof(one));
+            (void) written;
+        }
+    }
+
+    /**
+     * Parse the first request in the input of a connection, and hand it to the workers
+     * @param fd - fd of the connection
+     * @param connection - the connection
+     */
+    void dispatchRequest(int fd, Connection& connection)
+    {
+        if(connection.busy || connection.closing)
+        {
+            return;
+        }
+        std::size_t lineEnd = connection.input.find('\n');
+        if(lineEnd == std::string::npos)
+        {
+            if(connection.input.length() > DAEMON_MAX_LINE)
+            {
+                connection.output += std::string(DAEMON_ERROR) + INVALID_INPUT + "\n";
+                connection.closing = true;
+            }
+            // an incomplete request of a client that stopped sending is never answered
+            connection.closing = connection.closing || connection.inputClosed;
+            return;
+        }
+
+        if(connection.input.compare(0, lineEnd, DAEMON_STATS_COMMAND) == 0)
+        {
+            // answered here, the counters do not need a worker
+            connection.input.erase(0, lineEnd + 1);
+            connection.output += std::string(DAEMON_STATS_COMMAND) + " " + \
+                                 std::to_string(_cache == nullptr ? 0 : _cache->hits()) + " " + \
+                                 std::to_string(_cache == nullptr ? 0 : _cache->misses()) + \
+                                 " " + std::to_string(_cache == nullptr ? 0 : _cache->size()) + \
+                                 "\n";
+            dispatchRequest(fd, connection);
+            return;
+        }
+        std::istringstream line(connection.input.substr(0, lineEnd));
+        std::string command, thresholdStr, argument, rest;
+        line >> command >> thresholdStr >> argument;
+        bool validLine = !argument.empty() && !(line >> rest);
+        Job job = {fd, connection.id, 0, command == DAEMON_MESSAGE_COMMAND, std::string()};
+        std::size_t requestLength = lineEnd + 1;
+        if(validLine && command == DAEMON_SCORE_COMMAND)
+        {
+            job.message = argument;
+        }
+        else if(validLine && job.inlineMessage && strContainOnlyDigits(argument) && \
+                argument.length() <= MAX_THRESHOLD_DIGITS && \
+                std::stoul(argument) <= DAEMON_MAX_MESSAGE)
+        {
+            std::size_t messageLength = std::stoul(argument);
+            if(connection.input.length() - requestLength < messageLength)
+            {
+                // wait for the rest of the message
+                connection.closing = connection.inputClosed;
+                return;
+            }
+            job.message = connection.input.substr(requestLength, messageLength);
+            requestLength += messageLength;
+        }
+        else
+        {
+            // the stream can not be followed after a malformed request
+            connection.output += std::string(DAEMON_ERROR) + INVALID_INPUT + "\n";
+            connection.closing = true;
+            return;
+        }
+        connection.input.erase(0, requestLength);
+
+        if(!parseThreshold(thresholdStr, job.threshold))
+        {
+            connection.output += std::string(DAEMON_ERROR) + INVALID_INPUT + "\n";
+            dispatchRequest(fd, connection);
+            return;
+        }
+        connection.busy = true;
+        {
+            std::lock_guard<std::mutex> lock(_jobsMutex);
+            _jobs.push_back(std::move(job));
+        }
+        _jobsCondition.notify_one();
+    }
+
+    /**
+     * Close a connection
+     * @param fd - fd of the connection
+     */
+    void closeConnection(int fd)
+    {
+        epoll_ctl(_epollFd, EPOLL_CTL_DEL, fd, nullptr);
+        close(fd);
+        _connections.erase(fd);
+    }
+
+    /**
+     * Write the pending output of a connection, and close it if it is done
+     * @param fd - fd of the connection
+     */
+    void flushConnection(int fd)
+    {
+        Connection& connection = _connections.at(fd);
+        while(!connection.output.empty())
+        {
+            ssize_t written = send(fd, connection.output.data(), connection.output.length(), \
+                                   MSG_NOSIGNAL);
+            if(written < 0)
+            {
+                if(errno == EAGAIN || errno == EWOULDBLOCK)
+                {
+                    break;
+                }
+                if(errno == EINTR)
+                {
+                    continue;
+                }
+                closeConnection(fd);
+                return;
+            }
+            connection.output.erase(0, static_cast<size_t>(written));
+        }
+        if(connection.output.empty() && connection.closing && !connection.busy)
+        {
+            closeConnection(fd);
+            return;
+        }
+        struct epoll_event event = {};
+        if(!connection.inputClosed)
+        {
+            event.events |= EPOLLIN;
+        }
+        if(!connection.output.empty())
+        {
+            event.events |= EPOLLOUT;
+        }
+        event.data.fd = fd;
+        epoll_ctl(_epollFd, EPOLL_CTL_MOD, fd, &event);
+    }
+
+    /**
+     * Accept all the pending connections
+     */
+    void acceptConnections()
+    {
+        while(true)
+        {
+            int fd = accept4(_listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if(fd == FAILURE)
+            {
+                return;
+            }
+            if(!addConnection(fd))
+            {
+                close(fd);
+            }
+        }
+    }
+
+    /**
+     * Read everything that is available on a connection and handle its requests
+     * @param fd - fd of the connection
+     */
+    void readConnection(int fd)
+    {
+        char buffer[DAEMON_READ_SIZE];
+        bool peerClosed = false;
+        while(true)
+        {
+            ssize_t numOfBytes = recv(fd, buffer, sizeof(buffer), 0);
+            if(numOfBytes > 0)
+            {
+                _connections.at(fd).input.append(buffer, static_cast<size_t>(numOfBytes));
+                continue;
+            }
+            if(numOfBytes < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            peerClosed = numOfBytes == 0 || (errno != EAGAIN && errno != EWOULDBLOCK);
+            break;
+        }
+        Connection& connection = _connections.at(fd);
+        connection.inputClosed = connection.inputClosed || peerClosed;
+        dispatchRequest(fd, connection);
+        flushConnection(fd);
+    }
+
+    /**
+     * Hand the responses of the workers to their connections
+     */
+    void deliverResults()
+    {
+        uint64_t counter = 0;
+        ssize_t numOfBytes = read(_eventFd, &counter, sizeof(counter));
+        (void) numOfBytes;
+        std::deque<Result> results;
+        {
+            std::lock_guard<std::mutex> lock(_resultsMutex);
+            results.swap(_results);
+        }
+        for(Result& result : results)
+        {
+            if(!_connections.containsKey(result.fd) || \
+               _connections.at(result.fd).id != result.connectionId)
+            {
+                continue; // the connection was closed meanwhile
+            }
+            Connection& connection = _connections.at(result.fd);
+            connection.output += result.response;
+            connection.busy = false;
+            dispatchRequest(result.fd, connection);
+            flushConnection(result.fd);
+        }
+    }
+
+public:
+    /**
+     * Constructor
+     * @param argv - the command line arguments
+     * @param gDatBaseIndex - index in argv that contains dataBase path
+     * @param options - the command line options
+     */
+    ScoringDaemon(char *argv[], const int& gDatBaseIndex, const ScanOptions& options) : \
+                  _argv(argv), _gDatBaseIndex(gDatBaseIndex), _options(options), \
+                  _stopRequested(false)
+    {
+    }
+
+    ScoringDaemon(const ScoringDaemon&) = delete;
+    ScoringDaemon& operator = (const ScoringDaemon&) = delete;
+
+    /**
+     * Destructor - stop the workers and close all the connections
+     */
+    ~ScoringDaemon()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_reloaderMutex);
+            _reloaderStopping = true;
+        }
+        _reloaderCondition.notify_all();
+        if(_reloader.joinable())
+        {
+            _reloader.join();
+        }
+        {
+            std::lock_guard<std::mutex> lock(_jobsMutex);
+            _stopping = true;
+        }
+        _jobsCondition.notify_all();
+        for(std::thread& worker : _workers)
+        {
+            worker.join();
+        }
+        std::vector<int> fds;
+        const auto connectionsEnd = _connections.cend();
+        for(auto it = _connections.cbegin(); it != connectionsEnd; ++it)
+        {
+            fds.push_back(it->first);
+        }
+        for(int fd : fds)
+        {
+            close(fd);
+        }
+        for(int fd : {_listenFd, _epollFd, _eventFd})
+        {
+            if(fd != FAILURE)
+            {
+                close(fd);
+            }
+        }
+        if(!_socketPath.empty())
+        {
+            unlink(_socketPath.c_str());
+        }
+    }
+
+    /**
+     * Load the data base, and start the workers and the reloader
+     * @param numOfWorkers - number of worker threads
+     * @return - true if succeed, false if the data base is invalid or the event loop could not
+     *           be created
+     */
+    bool start(int numOfWorkers)
+    {
+        if(_options.cache)
+        {
+            _cache.reset(new ScoreCache(_options.cacheSize));
+            _cache->load(_options.cachePath);
+        }
+        if(!reloadDataBase())
+        {
+            return false;
+        }
+        _epollFd = epoll_create1(EPOLL_CLOEXEC);
+        _eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if(_epollFd == FAILURE || _eventFd == FAILURE)
+        {
+            return false;
+        }
+        struct epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.fd = _eventFd;
+        if(epoll_ctl(_epollFd, EPOLL_CTL_ADD, _eventFd, &event) == FAILURE)
+        {
+            return false;
+        }
+
+        for(int i = 0; i < numOfWorkers; ++i)
+        {
+            _workers.emplace_back(&ScoringDaemon::workerLoop, this);
+        }
+        _reloader = std::thread(&ScoringDaemon::reloaderLoop, this);
+        return true;
+    }
+
+    /**
+     * Accept connections on a unix domain socket, which is removed when the daemon is destroyed
+     * @param socketPath - path of the unix domain socket
+     * @return - true if succeed, false otherwise
+     */
+    bool listenOn(const char *socketPath)
+    {
+        struct sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+        if(std::strlen(socketPath) >= sizeof(address.sun_path))
+        {
+            return false;
+        }
+        std::strcpy(address.sun_path, socketPath);
+        unlink(socketPath);
+
+        _listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if(_listenFd == FAILURE || \
+           bind(_listenFd, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) == \
+           FAILURE || listen(_listenFd, SOMAXCONN) == FAILURE)
+        {
+            return false;
+        }
+        _socketPath = socketPath;
+
+        struct epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.fd = _listenFd;
+        return epoll_ctl(_epollFd, EPOLL_CTL_ADD, _listenFd, &event) != FAILURE;
+    }
+
+    /**
+     * Serve requests on a socket that is already connected, such as an end of a socketpair. The
+     * daemon owns the socket from now on and closes it. Must be called before serve, or from
+     * the thread that runs it.
+     * @param fd - the socket
+     * @return - true if succeed, false otherwise
+     */
+    bool addConnection(int fd)
+    {
+        int flags = fcntl(fd, F_GETFL);
+        struct epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        if(flags == FAILURE || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == FAILURE || \
+           epoll_ctl(_epollFd, EPOLL_CTL_ADD, fd, &event) == FAILURE)
+        {
+            return false;
+        }
+        Connection connection;
+        connection.id = _nextConnectionId++;
+        _connections.insert(fd, connection);
+        return true;
+    }
+
+    /**
+     * Load the data base again if its file or one of the delta files changed since the last
+     * load, and publish it if it is valid. The reloader calls it every DAEMON_RELOAD_CHECK_MS.
+     * @return - true if a new data base was published, false otherwise
+     */
+    bool reloadIfChanged()
+    {
+        std::lock_guard<std::mutex> lock(_reloadMutex);
+        if(dataBaseFilesState(_argv, _gDatBaseIndex, _options) == _dataBaseFilesState)
+        {
+            return false;
+        }
+        return reloadDataBase();
+    }
+
+    /**
+     * Run the event loop until stop is called, then save the score cache if it has a file
+     */
+    void serve()
+    {
+        struct epoll_event events[DAEMON_MAX_EVENTS];
+        while(!_stopRequested)
+        {
+            int numOfEvents = epoll_wait(_epollFd, events, DAEMON_MAX_EVENTS, \
+                                         DAEMON_LOOP_TIMEOUT_MS);
+            for(int i = 0; i < numOfEvents; ++i)
+            {
+                int fd = events[i].data.fd;
+                if(fd == _listenFd)
+                {
+                    acceptConnections();
+                }
+                else if(fd == _eventFd)
+                {
+                    deliverResults();
+                }
+                else if(_connections.containsKey(fd))
+                {
+                    if(events[i].events & (EPOLLERR | EPOLLHUP))
+                    {
+                        closeConnection(fd); // the client is gone, it can not get responses
+                    }
+                    else if(events[i].events & EPOLLIN)
+                    {
+                        readConnection(fd);
+                    }
+                    else if(events[i].events & EPOLLOUT)
+                    {
+                        flushConnection(fd);
+                    }
+                }
+            }
+        }
+        if(_cache != nullptr && !_options.cachePath.empty())
+        {
+            _cache->save(_options.cachePath);
+        }
+    }
+
+    /**
+     * Ask the event loop to exit. May be called from any thread and from a signal handler.
+     */
+    void stop()
+    {
+        _stopRequested = true;
+        uint64_t one = 1;
+        ssize_t written = write(_eventFd, &one, sizeof(one));
+        (void) written;
+    }
+};
+
+#endif //SPAMDETECTOR_HPP
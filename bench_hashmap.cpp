@@ -0,0 +1,726 @@
+//
+// Benchmarks of HashMap, each one next to the same operation on std::unordered_map, on
+// FlatHashMap and on CompactHashMap.
+// Every benchmark takes two arguments - the number of keys (1e2 to 1e7) and the index of the
+// load factor setting in loadFactorSettings. The allocsPerItem counter is the number of calls to
+// operator new per processed item.
+//
+#include "HashMap.hpp"
+#include "FrozenHashMap.hpp"
+#include "FlatHashMap.hpp"
+#include "ShardedHashMap.hpp"
+#include "CompactHashMap.hpp"
+#include "AllocationCounter.hpp"
+#include <benchmark/benchmark.h>
+#include <unordered_map>
+#include <algorithm>
+#include <functional>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <map>
+
+#define MIN_SIZE 100
+#define MAX_SIZE 10000000
+#define SIZE_MULTIPLIER 10
+#define RANDOM_SEED 2019
+
+/**
+ * lower and upper bound of the load factor of HashMap; std::unordered_map gets the upper bound
+ * as its max_load_factor, it has no lower bound
+ */
+const std::pair<double, double> loadFactorSettings[] = {{1.0 / 4, 3.0 / 4}, \
+                                                        {1.0 / 8, 1.0 / 2}, \
+                                                        {1.0 / 2, 9.0 / 10}};
+
+/**
+ * The keys of the benchmarks, generated once per size
+ * @tparam KeyT - int or std::string
+ */
+template <typename KeyT>
+struct Keys;
+
+template <>
+struct Keys<int>
+{
+    /**
+     * @param size - number of keys
+     * @param present - true for the keys that are inserted, false for keys that are never
+     * @return - distinct keys in random order
+     */
+    static const std::vector<int>& get(int size, bool present)
+    {
+        static std::map<std::pair<int, bool>, std::vector<int>> cache;
+        std::vector<int>& keys = cache[{size, present}];
+        if(keys.empty())
+        {
+            // present keys are even, missing keys are odd
+            for(int i = 0; i < size; ++i)
+            {
+                keys.push_back(2 * i + (present ? 0 : 1));
+            }
+            std::shuffle(keys.begin(), keys.end(), std::mt19937(RANDOM_SEED));
+        }
+        return keys;
+    }
+};
+
+template <>
+struct Keys<std::string>
+{
+    /**
+     * @param size - number of keys
+     * @param present - true for the keys that are inserted, false for keys that are never
+     * @return - distinct keys in random order
+     */
+    static const std::vector<std::string>& get(int size, bool present)
+    {
+        static std::map<std::pair<int, bool>, std::vector<std::string>> cache;
+        std::vector<std::string>& keys = cache[{size, present}];
+        if(keys.empty())
+        {
+            for(int key : Keys<int>::get(size, present))
+            {
+                keys.push_back("bad sequence #" + std::to_string(key));
+            }
+        }
+        return keys;
+    }
+};
+
+/**
+ * The operations of HashMap, as the benchmarks use them
+ */
+template <typename KeyT>
+struct HashMapAdapter
+{
+    using Map = HashMap<KeyT, int>;
+
+    static Map make(const benchmark::State& state)
+    {
+        const std::pair<double, double>& bounds = loadFactorSettings[state.range(1)];
+        return Map(bounds.first, bounds.second);
+    }
+
+    static void insert(Map& map, const KeyT& key, int value)
+    {
+        map.insert(key, value);
+    }
+
+    static bool contains(const Map& map, const KeyT& key)
+    {
+        return map.containsKey(key);
+    }
+
+    static void erase(Map& map, const KeyT& key)
+    {
+        map.erase(key);
+    }
+
+    static long sum(const Map& map)
+    {
+        long sum = 0;
+        const auto mapEnd = map.cend();
+        for(auto it = map.cbegin(); it != mapEnd; ++it)
+        {
+            sum += it->second;
+        }
+        return sum;
+    }
+
+    static void rehash(Map& map)
+    {
+        map.rehashing(true);
+        map.rehashing(false);
+    }
+};
+
+/**
+ * The operations of FlatHashMap, as the benchmarks use them; it has a fixed maximal load factor,
+ * so the load factor setting is ignored
+ */
+template <typename KeyT>
+struct FlatHashMapAdapter
+{
+    using Map = FlatHashMap<KeyT, int>;
+
+    static Map make(const benchmark::State&)
+    {
+        return Map();
+    }
+
+    static void insert(Map& map, const KeyT& key, int value)
+    {
+        map.insert(key, value);
+    }
+
+    static bool contains(const Map& map, const KeyT& key)
+    {
+        return map.containsKey(key);
+    }
+
+    static void erase(Map& map, const KeyT& key)
+    {
+        map.erase(key);
+    }
+
+    static long sum(const Map& map)
+    {
+        long sum = 0;
+        for(const auto& pair : map)
+        {
+            sum += pair.second;
+        }
+        return sum;
+    }
+
+    static void rehash(Map& map)
+    {
+        map.rehashing(true);
+        map.rehashing(false);
+    }
+};
+
+/**
+ * The operations of CompactHashMap, as the benchmarks use them; it has a fixed maximal load
+ * factor, so the load factor setting is ignored
+ */
+template <typename KeyT>
+struct CompactHashMapAdapter
+{
+    using Map = CompactHashMap<KeyT, int>;
+
+    static Map make(const benchmark::State&)
+    {
+        return Map();
+    }
+
+    static void insert(Map& map, const KeyT& key, int value)
+    {
+        map.insert(key, value);
+    }
+
+    static bool contains(const Map& map, const KeyT& key)
+    {
+        return map.containsKey(key);
+    }
+
+    static void erase(Map& map, const KeyT& key)
+    {
+        map.erase(key);
+    }
+
+    static long sum(const Map& map)
+    {
+        long sum = 0;
+        for(const auto& pair : map)
+        {
+            sum += pair.second;
+        }
+        return sum;
+    }
+
+    static void rehash(Map& map)
+    {
+        map.rehashing(true);
+        map.rehashing(false);
+    }
+};
+
+/**
+ * The operations of std::unordered_map, as the benchmarks use them
+ */
+template <typename KeyT>
+struct UnorderedMapAdapter
+{
+    using Map = std::unordered_map<KeyT, int>;
+
+    static Map make(const benchmark::State& state)
+    {
+        Map map;
+        map.max_load_factor(static_cast<float>(loadFactorSettings[state.range(1)].second));
+        return map;
+    }
+
+    static void insert(Map& map, const KeyT& key, int value)
+    {
+        map.emplace(key, value);
+    }
+
+    static bool contains(const Map& map, const KeyT& key)
+    {
+        return map.find(key) != map.end();
+    }
+
+    static void erase(Map& map, const KeyT& key)
+    {
+        map.erase(key);
+    }
+
+    static long sum(const Map& map)
+    {
+        long sum = 0;
+        for(const auto& pair : map)
+        {
+            sum += pair.second;
+        }
+        return sum;
+    }
+
+    static void rehash(Map& map)
+    {
+        const std::size_t numOfBuckets = map.bucket_count();
+        map.rehash(numOfBuckets * 2);
+        map.rehash(numOfBuckets);
+    }
+};
+
+/**
+ * Report the number of allocations per processed item
+ * @param state - the benchmark state
+ * @param allocations - number of allocations in the timed part of the benchmark
+ * @param numOfItems - number of processed items
+ */
+void reportAllocations(benchmark::State& state, long allocations, long numOfItems)
+{
+    state.counters["allocsPerItem"] = numOfItems == 0 ? 0.0 : double(allocations) / numOfItems;
+}
+
+/**
+ * @param state - the benchmark state
+ * @return - a map with the present keys of the size of the benchmark
+ */
+template <typename Adapter, typename KeyT>
+typename Adapter::Map makeFullMap(const benchmark::State& state)
+{
+    typename Adapter::Map map = Adapter::make(state);
+    int value = 0;
+    for(const KeyT& key : Keys<KeyT>::get(static_cast<int>(state.range(0)), true))
+    {
+        Adapter::insert(map, key, value++);
+    }
+    return map;
+}
+
+/**
+ * Insert all the keys into an empty map, growing it from the default capacity
+ */
+template <typename Adapter, typename KeyT>
+void insert(benchmark::State& state)
+{
+    const std::vector<KeyT>& keys = Keys<KeyT>::get(static_cast<int>(state.range(0)), true);
+    AllocationScope scope;
+    for(auto _ : state)
+    {
+        typename Adapter::Map map = Adapter::make(state);
+        int value = 0;
+        for(const KeyT& key : keys)
+        {
+            Adapter::insert(map, key, value++);
+        }
+        benchmark::DoNotOptimize(map);
+    }
+    state.SetItemsProcessed(state.iterations() * keys.size());
+    reportAllocations(state, scope.allocations(), state.iterations() * keys.size());
+}
+
+/**
+ * Look up every key of the map
+ */
+template <typename Adapter, typename KeyT>
+void lookupHit(benchmark::State& state)
+{
+    const typename Adapter::Map map = makeFullMap<Adapter, KeyT>(state);
+    const std::vector<KeyT>& keys = Keys<KeyT>::get(static_cast<int>(state.range(0)), true);
+    AllocationScope scope;
+    for(auto _ : state)
+    {
+        for(const KeyT& key : keys)
+        {
+            benchmark::DoNotOptimize(Adapter::contains(map, key));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * keys.size());
+    reportAllocations(state, scope.allocations(), state.iterations() * keys.size());
+}
+
+/**
+ * Look up as many keys that are not in the map
+ */
+template <typename Adapter, typename KeyT>
+void lookupMiss(benchmark::State& state)
+{
+    const typename Adapter::Map map = makeFullMap<Adapter, KeyT>(state);
+    const std::vector<KeyT>& keys = Keys<KeyT>::get(static_cast<int>(state.range(0)), false);
+    AllocationScope scope;
+    for(auto _ : state)
+    {
+        for(const KeyT& key : keys)
+        {
+            benchmark::DoNotOptimize(Adapter::contains(map, key));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * keys.size());
+    reportAllocations(state, scope.allocations(), state.iterations() * keys.size());
+}
+
+/**
+ * Erase every key of a full map, shrinking it back
+ */
+template <typename Adapter, typename KeyT>
+void erase(benchmark::State& state)
+{
+    const std::vector<KeyT>& keys = Keys<KeyT>::get(static_cast<int>(state.range(0)), true);
+    long allocations = 0;
+    for(auto _ : state)
+    {
+        state.PauseTiming();
+        typename Adapter::Map map = makeFullMap<Adapter, KeyT>(state);
+        state.ResumeTiming();
+        AllocationScope scope;
+        for(const KeyT& key : keys)
+        {
+            Adapter::erase(map, key);
+        }
+        allocations += scope.allocations();
+        benchmark::DoNotOptimize(map);
+    }
+    state.SetItemsProcessed(state.iterations() * keys.size());
+    reportAllocations(state, allocations, state.iterations() * keys.size());
+}
+
+/**
+ * Visit every pair of the map
+ */
+template <typename Adapter, typename KeyT>
+void iterate(benchmark::State& state)
+{
+    const typename Adapter::Map map = makeFullMap<Adapter, KeyT>(state);
+    AllocationScope scope;
+    for(auto _ : state)
+    {
+        benchmark::DoNotOptimize(Adapter::sum(map));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    reportAllocations(state, scope.allocations(), state.iterations() * state.range(0));
+}
+
+/**
+ * Visit every pair of the map after 7 of every 8 keys were erased
+ */
+template <typename Adapter, typename KeyT>
+void iterateAfterErase(benchmark::State& state)
+{
+    typename Adapter::Map map = makeFullMap<Adapter, KeyT>(state);
+    const std::vector<KeyT>& keys = Keys<KeyT>::get(static_cast<int>(state.range(0)), true);
+    for(size_t i = 0; i < keys.size(); ++i)
+    {
+        if(i % 8 != 0)
+        {
+            Adapter::erase(map, keys[i]);
+        }
+    }
+    AllocationScope scope;
+    for(auto _ : state)
+    {
+        benchmark::DoNotOptimize(Adapter::sum(map));
+    }
+    state.SetItemsProcessed(state.iterations() * (state.range(0) + 7) / 8);
+    reportAllocations(state, scope.allocations(), state.iterations() * (state.range(0) + 7) / 8);
+}
+
+/**
+ * Copy construct the map
+ */
+template <typename Adapter, typename KeyT>
+void copy(benchmark::State& state)
+{
+    const typename Adapter::Map map = makeFullMap<Adapter, KeyT>(state);
+    AllocationScope scope;
+    for(auto _ : state)
+    {
+        typename Adapter::Map copy(map);
+        benchmark::DoNotOptimize(copy);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    reportAllocations(state, scope.allocations(), state.iterations() * state.range(0));
+}
+
+/**
+ * Rehash the map to twice its buckets and back
+ */
+template <typename Adapter, typename KeyT>
+void rehash(benchmark::State& state)
+{
+    typename Adapter::Map map = makeFullMap<Adapter, KeyT>(state);
+    AllocationScope scope;
+    for(auto _ : state)
+    {
+        Adapter::rehash(map);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0) * 2);
+    reportAllocations(state, scope.allocations(), state.iterations() * state.range(0) * 2);
+}
+
+/**
+ * @param benchmark - a benchmark to run on every size and load factor setting
+ */
+void sizesAndLoadFactors(benchmark::internal::Benchmark* benchmark)
+{
+    const int numOfSettings = sizeof(loadFactorSettings) / sizeof(loadFactorSettings[0]);
+    for(long size = MIN_SIZE; size <= MAX_SIZE; size *= SIZE_MULTIPLIER)
+    {
+        for(int setting = 0; setting < numOfSettings; ++setting)
+        {
+            benchmark->Args({size, setting});
+        }
+    }
+    benchmark->ArgNames({"size", "loadFactor"})->Unit(benchmark::kMicrosecond);
+}
+
+#define BENCHMARK_OPERATION(operation) \
+    BENCHMARK_TEMPLATE(operation, HashMapAdapter<int>, int)->Apply(sizesAndLoadFactors); \
+    BENCHMARK_TEMPLATE(operation, UnorderedMapAdapter<int>, int)->Apply(sizesAndLoadFactors); \
+    BENCHMARK_TEMPLATE(operation, FlatHashMapAdapter<int>, int)->Apply(sizesAndLoadFactors); \
+    BENCHMARK_TEMPLATE(operation, CompactHashMapAdapter<int>, int)->Apply(sizesAndLoadFactors); \
+    BENCHMARK_TEMPLATE(operation, HashMapAdapter<std::string>, std::string)-> \
+        Apply(sizesAndLoadFactors); \
+    BENCHMARK_TEMPLATE(operation, UnorderedMapAdapter<std::string>, std::string)-> \
+        Apply(sizesAndLoadFactors); \
+    BENCHMARK_TEMPLATE(operation, FlatHashMapAdapter<std::string>, std::string)-> \
+        Apply(sizesAndLoadFactors); \
+    BENCHMARK_TEMPLATE(operation, CompactHashMapAdapter<std::string>, std::string)-> \
+        Apply(sizesAndLoadFactors)
+
+BENCHMARK_OPERATION(insert);
+BENCHMARK_OPERATION(lookupHit);
+BENCHMARK_OPERATION(lookupMiss);
+BENCHMARK_OPERATION(erase);
+BENCHMARK_OPERATION(iterate);
+BENCHMARK_OPERATION(iterateAfterErase);
+BENCHMARK_OPERATION(copy);
+BENCHMARK_OPERATION(rehash);
+
+/**
+ * Sum the values of a map of int keys with parallelReduce; the second argument is the number of
+ * threads
+ */
+void parallelSum(benchmark::State& state)
+{
+    HashMap<int, int> map;
+    for(int key : Keys<int>::get(static_cast<int>(state.range(0)), true))
+    {
+        map.insert(key, key);
+    }
+    const int numOfThreads = static_cast<int>(state.range(1));
+    for(auto _ : state)
+    {
+        benchmark::DoNotOptimize(map.parallelReduce(0L, [](const std::pair<int, int>& pair)
+                                                        {
+                                                            return long(pair.second);
+                                                        }, std::plus<long>(), numOfThreads));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+/**
+ * Erase every other key of a full map: by key one at a time when the third argument is 0, with
+ * one eraseIf walk when it is 1
+ */
+template <typename KeyT>
+void expire(benchmark::State& state)
+{
+    const HashMap<KeyT, int> full = makeFullMap<HashMapAdapter<KeyT>, KeyT>(state);
+    const std::vector<KeyT>& keys = Keys<KeyT>::get(static_cast<int>(state.range(0)), true);
+    for(auto _ : state)
+    {
+        state.PauseTiming();
+        HashMap<KeyT, int> map(full);
+        state.ResumeTiming();
+        if(state.range(2) != 0)
+        {
+            map.eraseIf([](const std::pair<KeyT, int>& pair)
+                        {
+                            return pair.second % 2 == 0;
+                        });
+        }
+        else
+        {
+            for(size_t i = 0; i < keys.size(); i += 2)
+            {
+                map.erase(keys[i]);
+            }
+        }
+        benchmark::DoNotOptimize(map.size());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+/**
+ * Count occurrences of int keys from several threads in a ShardedHashMap; with one shard it is
+ * a single HashMap behind a single lock. The first argument is the number of keys, the second
+ * the number of threads, and every thread counts every key once.
+ */
+template <int N>
+void concurrentCount(benchmark::State& state)
+{
+    const std::vector<int>& keys = Keys<int>::get(static_cast<int>(state.range(0)), true);
+    const int numOfThreads = static_cast<int>(state.range(1));
+    for(auto _ : state)
+    {
+        ShardedHashMap<int, long, N> counts;
+        std::vector<std::thread> threads;
+        for(int thread = 0; thread < numOfThreads; ++thread)
+        {
+            threads.emplace_back([&counts, &keys, thread]()
+                                 {
+                                     // every thread starts at another key, as writers of
+                                     // unrelated events would
+                                     const size_t first = keys.size() * thread / 16;
+                                     for(size_t i = 0; i < keys.size(); ++i)
+                                     {
+                                         counts.update(keys[(first + i) % keys.size()], \
+                                                       [](long& count)
+                                                       {
+                                                           ++count;
+                                                       });
+                                     }
+                                 });
+        }
+        for(std::thread& thread : threads)
+        {
+            thread.join();
+        }
+        benchmark::DoNotOptimize(counts.size());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0) * numOfThreads);
+}
+
+/**
+ * Load a map from an image that save wrote, instead of inserting its keys
+ */
+template <typename KeyT>
+void loadImage(benchmark::State& state)
+{
+    const HashMap<KeyT, int> map = makeFullMap<HashMapAdapter<KeyT>, KeyT>(state);
+    std::stringstream image;
+    map.save(image);
+    AllocationScope scope;
+    for(auto _ : state)
+    {
+        image.clear();
+        image.seekg(0);
+        HashMap<KeyT, int> loaded;
+        loaded.load(image);
+        benchmark::DoNotOptimize(loaded);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    reportAllocations(state, scope.allocations(), state.iterations() * state.range(0));
+}
+
+/**
+ * Look up every key, present or missing by the third argument, in a FrozenHashMap of the keys
+ */
+template <typename KeyT>
+void frozenLookup(benchmark::State& state)
+{
+    const FrozenHashMap<KeyT, int> map(makeFullMap<HashMapAdapter<KeyT>, KeyT>(state));
+    const std::vector<KeyT>& keys = Keys<KeyT>::get(static_cast<int>(state.range(0)), \
+                                                    state.range(2) != 0);
+    AllocationScope scope;
+    for(auto _ : state)
+    {
+        for(const KeyT& key : keys)
+        {
+            benchmark::DoNotOptimize(map.containsKey(key));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * keys.size());
+    reportAllocations(state, scope.allocations(), state.iterations() * keys.size());
+}
+
+/**
+ * Look up every key, present or missing by the third argument, with findBatch of a HashMap or,
+ * by the fourth argument, of a FrozenHashMap of the keys
+ */
+template <typename KeyT>
+void lookupBatch(benchmark::State& state)
+{
+    const HashMap<KeyT, int> map = makeFullMap<HashMapAdapter<KeyT>, KeyT>(state);
+    const FrozenHashMap<KeyT, int> frozen(map);
+    const std::vector<KeyT>& keys = Keys<KeyT>::get(static_cast<int>(state.range(0)), \
+                                                    state.range(2) != 0);
+    std::vector<const int *> values(keys.size());
+    AllocationScope scope;
+    for(auto _ : state)
+    {
+        if(state.range(3) != 0)
+        {
+            frozen.findBatch(keys.data(), keys.size(), values.data());
+        }
+        else
+        {
+            map.findBatch(keys.data(), keys.size(), values.data());
+        }
+        benchmark::DoNotOptimize(values.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * keys.size());
+    reportAllocations(state, scope.allocations(), state.iterations() * keys.size());
+}
+
+/**
+ * @param benchmark - a benchmark to run on every size, for present and for missing keys
+ */
+void sizesAndPresence(benchmark::internal::Benchmark* benchmark)
+{
+    for(long size = MIN_SIZE; size <= MAX_SIZE; size *= SIZE_MULTIPLIER)
+    {
+        benchmark->Args({size, 0, 1})->Args({size, 0, 0});
+    }
+    benchmark->ArgNames({"size", "loadFactor", "present"})->Unit(benchmark::kMicrosecond);
+}
+
+BENCHMARK_TEMPLATE(frozenLookup, int)->Apply(sizesAndPresence);
+BENCHMARK_TEMPLATE(frozenLookup, std::string)->Apply(sizesAndPresence);
+
+/**
+ * @param benchmark - a benchmark to run on every size, for present and for missing keys, on a
+ *                    HashMap and on a FrozenHashMap
+ */
+void sizesPresenceAndFrozen(benchmark::internal::Benchmark* benchmark)
+{
+    for(long size = MIN_SIZE; size <= MAX_SIZE; size *= SIZE_MULTIPLIER)
+    {
+        for(long frozen = 0; frozen <= 1; ++frozen)
+        {
+            benchmark->Args({size, 0, 1, frozen})->Args({size, 0, 0, frozen});
+        }
+    }
+    benchmark->ArgNames({"size", "loadFactor", "present", "frozen"})-> \
+        Unit(benchmark::kMicrosecond);
+}
+
+BENCHMARK_TEMPLATE(lookupBatch, int)->Apply(sizesPresenceAndFrozen);
+BENCHMARK_TEMPLATE(lookupBatch, std::string)->Apply(sizesPresenceAndFrozen);
+
+BENCHMARK_TEMPLATE(loadImage, int)->Apply(sizesAndLoadFactors);
+BENCHMARK_TEMPLATE(loadImage, std::string)->Apply(sizesAndLoadFactors);
+
+BENCHMARK(parallelSum)->ArgsProduct({{100000, 10000000}, {1, 2, 4, 8}})-> \
+    ArgNames({"size", "threads"})->Unit(benchmark::kMicrosecond)->UseRealTime();
+
+BENCHMARK_TEMPLATE(expire, int)->ArgsProduct({{10000, 1000000}, {0}, {0, 1}})-> \
+    ArgNames({"size", "loadFactor", "eraseIf"})->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(expire, std::string)->ArgsProduct({{10000, 1000000}, {0}, {0, 1}})-> \
+    ArgNames({"size", "loadFactor", "eraseIf"})->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_TEMPLATE(concurrentCount, 1)->ArgsProduct({{100000}, {1, 4, 16}})-> \
+    ArgNames({"size", "threads"})->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_TEMPLATE(concurrentCount, 64)->ArgsProduct({{100000}, {1, 4, 16}})-> \
+    ArgNames({"size", "threads"})->Unit(benchmark::kMillisecond)->UseRealTime();
+
+BENCHMARK_MAIN();
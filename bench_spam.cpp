@@ -0,0 +1,366 @@
+//
+// End to end benchmarks of SpamDetector on a synthetic corpus - loading the data base (csv and
+// compiled image) and scoring messages with every engine. Every benchmark takes two arguments -
+// the number of bad sequences and the hit rate of the messages in per mille. The scoring
+// benchmarks also report the number of calls to operator new per message.
+// 'bench_spam generate <directory> <number of patterns> <hit rate per mille> [seed]' only writes
+// the corpus, so it can be fed to the SpamDetector executable.
+//
+#include "SpamDetector.hpp"
+#include "AllocationCounter.hpp"
+#include <benchmark/benchmark.h>
+#include <boost/filesystem.hpp>
+#include <sys/resource.h>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+#include <map>
+#include <tuple>
+
+#define GENERATE_USAGE "Usage: bench_spam generate <directory> <number of patterns> " \
+                       "<hit rate per mille> [seed]"
+#define GENERATE_COMMAND "generate"
+#define DATA_BASE_FILE "db.csv"
+#define IMAGE_FILE "db.img"
+#define MESSAGE_FILE_PREFIX "message"
+#define DEFAULT_SEED 2019
+#define PER_MILLE 1000
+#define BENCHMARK_THRESHOLD 500
+#define BYTES_IN_MB (1024.0 * 1024.0)
+
+/**
+ * The parameters of a synthetic corpus
+ */
+struct CorpusConfig
+{
+    int numOfPatterns = 10000; /**< number of bad sequences in the data base */
+    int minWordLength = 3; /**< length of the shortest word */
+    int maxWordLength = 10; /**< length of the longest word */
+    int maxWordsInPattern = 3; /**< bad sequences have 1 to maxWordsInPattern words */
+    int vocabularySize = 20000; /**< number of distinct words the bad sequences are made of */
+    int maxPoints = 100; /**< bad sequences are worth 0 to maxPoints points */
+    int numOfMessages = 16; /**< number of messages */
+    int messageLength = 16384; /**< length of every message */
+    int hitRate = 10; /**< per mille of the phrases of a message that are bad sequences */
+    unsigned seed = DEFAULT_SEED; /**< seed of the generator, the same seed gives the same corpus */
+};
+
+/**
+ * A synthetic corpus, in files
+ */
+struct Corpus
+{
+    std::string dataBasePath; /**< the data base, as a csv */
+    std::string imagePath; /**< the data base, compiled */
+    std::vector<std::string> messagePaths; /**< the messages */
+    long totalMessageBytes = 0; /**< the length of all the messages together */
+};
+
+/**
+ * @param random - the generator
+ * @param config - the corpus parameters
+ * @return - a word of lower case letters
+ */
+std::string generateWord(std::mt19937& random, const CorpusConfig& config)
+{
+    std::uniform_int_distribution<int> length(config.minWordLength, config.maxWordLength);
+    std::uniform_int_distribution<int> letter('a', 'z');
+    std::string word(static_cast<std::size_t>(length(random)), ' ');
+    for(char& c : word)
+    {
+        c = static_cast<char>(letter(random));
+    }
+    return word;
+}
+
+/**
+ * Write a corpus - a data base of phrases of 1 to maxWordsInPattern words, and messages made of
+ * bad sequences (hitRate per mille of the phrases) and of filler words. The filler words are made
+ * of digits, so they never contain a bad sequence and the hit rate is what was asked for.
+ * @param config - the corpus parameters
+ * @param directory - an existing directory to write the files into
+ * @param corpus - set to the paths of the files
+ * @return - true if succeed, false otherwise
+ */
+bool generateCorpus(const CorpusConfig& config, const std::string& directory, Corpus& corpus)
+{
+    std::mt19937 random(config.seed);
+    std::vector<std::string> vocabulary;
+    for(int i = 0; i < config.vocabularySize; ++i)
+    {
+        vocabulary.push_back(generateWord(random, config));
+    }
+
+    std::uniform_int_distribution<int> wordIndex(0, config.vocabularySize - 1);
+    std::uniform_int_distribution<int> numOfWords(1, config.maxWordsInPattern);
+    std::uniform_int_distribution<int> points(0, config.maxPoints);
+    HashMap<std::string, int> dataBase;
+    std::vector<std::string> patterns;
+    std::string csv;
+    while(static_cast<int>(patterns.size()) < config.numOfPatterns)
+    {
+        std::string pattern = vocabulary[wordIndex(random)];
+        for(int words = numOfWords(random); words > 1; --words)
+        {
+            pattern += " " + vocabulary[wordIndex(random)];
+        }
+        if(dataBase.insert(pattern, 0))
+        {
+            patterns.push_back(pattern);
+            csv += pattern + "," + std::to_string(points(random)) + "\n";
+        }
+    }
+    corpus.dataBasePath = directory + "/" + DATA_BASE_FILE;
+    std::ofstream(corpus.dataBasePath, std::ios::binary) << csv;
+
+    std::uniform_int_distribution<int> perMille(0, PER_MILLE - 1);
+    std::uniform_int_distribution<std::size_t> patternIndex(0, patterns.size() - 1);
+    std::uniform_int_distribution<int> digit('0', '9');
+    corpus.messagePaths.clear();
+    corpus.totalMessageBytes = 0;
+    for(int i = 0; i < config.numOfMessages; ++i)
+    {
+        std::string message;
+        while(static_cast<int>(message.length()) < config.messageLength)
+        {
+            if(perMille(random) < config.hitRate)
+            {
+                message += patterns[patternIndex(random)];
+            }
+            else
+            {
+                std::string filler = generateWord(random, config);
+                for(char& c : filler)
+                {
+                    c = static_cast<char>(digit(random));
+                }
+                message += filler;
+            }
+            message += " ";
+        }
+        corpus.messagePaths.push_back(directory + "/" + MESSAGE_FILE_PREFIX + \
+                                      std::to_string(i) + ".txt");
+        std::ofstream(corpus.messagePaths.back(), std::ios::binary) << message;
+        corpus.totalMessageBytes += static_cast<long>(message.length());
+    }
+
+    corpus.imagePath = directory + "/" + IMAGE_FILE;
+    char *argv[] = {&corpus.dataBasePath[0], &corpus.imagePath[0]};
+    long invalidLine = 0;
+    return compileDataBase(argv, 0, 1, invalidLine);
+}
+
+/**
+ * The corpora of the benchmarks, written once per configuration into a temporary directory that
+ * is removed when the benchmarks end
+ */
+class CorpusCache
+{
+private:
+    boost::filesystem::path _directory; /**< the temporary directory */
+    std::map<std::pair<int, int>, Corpus> _corpora; /**< by number of patterns and hit rate */
+
+public:
+    CorpusCache() : _directory(boost::filesystem::temp_directory_path() / \
+                               boost::filesystem::unique_path("bench_spam-%%%%-%%%%"))
+    {
+    }
+
+    ~CorpusCache()
+    {
+        boost::system::error_code error;
+        boost::filesystem::remove_all(_directory, error);
+    }
+
+    /**
+     * @param state - the benchmark state, with the number of patterns and the hit rate
+     * @return - the corpus of the benchmark
+     */
+    const Corpus& get(const benchmark::State& state)
+    {
+        const std::pair<int, int> key(static_cast<int>(state.range(0)), \
+                                      static_cast<int>(state.range(1)));
+        if(_corpora.find(key) == _corpora.end())
+        {
+            CorpusConfig config;
+            config.numOfPatterns = key.first;
+            config.hitRate = key.second;
+            const boost::filesystem::path directory = _directory / \
+                (std::to_string(key.first) + "-" + std::to_string(key.second));
+            boost::filesystem::create_directories(directory);
+            if(!generateCorpus(config, directory.string(), _corpora[key]))
+            {
+                throw std::runtime_error("failed to write the corpus in " + directory.string());
+            }
+        }
+        return _corpora[key];
+    }
+};
+
+CorpusCache corpusCache;
+
+/**
+ * Report the peak resident set size of the process, which is at least the peak of the benchmark
+ * @param state - the benchmark state
+ */
+void reportPeakRss(benchmark::State& state)
+{
+    struct rusage usage = {};
+    getrusage(RUSAGE_SELF, &usage);
+    state.counters["peakRssMB"] = usage.ru_maxrss / 1024.0; // ru_maxrss is in KB
+}
+
+/**
+ * Load the data base, as a csv or as the compiled image
+ * @param state - the benchmark state
+ * @param compiled - load the compiled image
+ */
+void loadDataBase(benchmark::State& state, bool compiled)
+{
+    const Corpus& corpus = corpusCache.get(state);
+    std::string dataBasePath = compiled ? corpus.imagePath : corpus.dataBasePath;
+    char *argv[] = {&dataBasePath[0]};
+    ScanOptions options;
+    options.dbCompiled = compiled;
+    for(auto _ : state)
+    {
+        long invalidLine = 0;
+        std::shared_ptr<const DataBaseSnapshot> snapshot = \
+            buildDataBaseSnapshot(argv, 0, options, 1, invalidLine);
+        if(snapshot == nullptr)
+        {
+            state.SkipWithError("invalid data base");
+            break;
+        }
+        benchmark::DoNotOptimize(snapshot);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.SetBytesProcessed(state.iterations() * \
+                            static_cast<long>(boost::filesystem::file_size(dataBasePath)));
+    reportPeakRss(state);
+}
+
+/**
+ * Score every message of the corpus through getTotalFilePoint, with the engine the options pick
+ * @param state - the benchmark state
+ * @param options - the command line options
+ */
+void scoreMessages(benchmark::State& state, ScanOptions options)
+{
+    const Corpus& corpus = corpusCache.get(state);
+    std::string dataBasePath = corpus.dataBasePath;
+    char *dataBaseArgv[] = {&dataBasePath[0]};
+    long invalidLine = 0;
+    std::shared_ptr<const DataBaseSnapshot> snapshot = \
+        buildDataBaseSnapshot(dataBaseArgv, 0, options, 1, invalidLine);
+    if(snapshot == nullptr)
+    {
+        state.SkipWithError("invalid data base");
+        return;
+    }
+    std::vector<std::string> messagePaths = corpus.messagePaths;
+    long numOfSpam = 0;
+    AllocationScope scope;
+    for(auto _ : state)
+    {
+        for(std::string& messagePath : messagePaths)
+        {
+            char *argv[] = {&messagePath[0]};
+            long points = getTotalFilePoint(argv, 0, *snapshot, options, BENCHMARK_THRESHOLD);
+            numOfSpam += points >= BENCHMARK_THRESHOLD ? 1 : 0;
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<long>(messagePaths.size()));
+    state.SetBytesProcessed(state.iterations() * corpus.totalMessageBytes);
+    const double numOfMessages = double(state.iterations() * \
+                                        static_cast<long>(messagePaths.size()));
+    state.counters["spamRate"] = numOfMessages == 0 ? 0.0 : numOfSpam / numOfMessages;
+    state.counters["allocsPerMessage"] = numOfMessages == 0 ? 0.0 : \
+                                         scope.allocations() / numOfMessages;
+    reportPeakRss(state);
+}
+
+void loadCsv(benchmark::State& state)
+{
+    loadDataBase(state, false);
+}
+
+void loadCompiled(benchmark::State& state)
+{
+    loadDataBase(state, true);
+}
+
+void scoreSubstrings(benchmark::State& state)
+{
+    scoreMessages(state, ScanOptions());
+}
+
+void scoreEarlyExit(benchmark::State& state)
+{
+    ScanOptions options;
+    options.earlyExit = true;
+    scoreMessages(state, options);
+}
+
+void scoreTokens(benchmark::State& state)
+{
+    ScanOptions options;
+    options.tokens = true;
+    scoreMessages(state, options);
+}
+
+/**
+ * @param benchmark - a benchmark to run on every data base size and hit rate
+ */
+void corpusSizes(benchmark::internal::Benchmark* benchmark)
+{
+    for(int numOfPatterns : {1000, 10000, 100000})
+    {
+        for(int hitRate : {0, 10, 100})
+        {
+            benchmark->Args({numOfPatterns, hitRate});
+        }
+    }
+    benchmark->ArgNames({"patterns", "hitRatePerMille"})->Unit(benchmark::kMillisecond);
+}
+
+BENCHMARK(loadCsv)->Apply(corpusSizes);
+BENCHMARK(loadCompiled)->Apply(corpusSizes);
+BENCHMARK(scoreSubstrings)->Apply(corpusSizes);
+BENCHMARK(scoreEarlyExit)->Apply(corpusSizes);
+BENCHMARK(scoreTokens)->Apply(corpusSizes);
+
+/**
+ * Run the benchmarks, or write a corpus with 'generate'
+ * @param argc - number of argument in the command line
+ * @param argv - array of string that contain all the command line arguments
+ * @return 0 on success, 1 on failure
+ */
+int main(int argc, char* argv[])
+{
+    if(argc > 1 && std::strcmp(argv[1], GENERATE_COMMAND) == 0)
+    {
+        CorpusConfig config;
+        if((argc != 5 && argc != 6) || !strContainOnlyDigits(argv[3]) || \
+           !strContainOnlyDigits(argv[4]) || (argc == 6 && !strContainOnlyDigits(argv[5])))
+        {
+            std::cerr << GENERATE_USAGE << std::endl;
+            return EXIT_FAILURE;
+        }
+        config.numOfPatterns = std::max(1, std::atoi(argv[3]));
+        config.hitRate = std::atoi(argv[4]);
+        config.seed = argc == 6 ? static_cast<unsigned>(std::stoul(argv[5])) : DEFAULT_SEED;
+        Corpus corpus;
+        boost::filesystem::create_directories(argv[2]);
+        return generateCorpus(config, argv[2], corpus) ? 0 : EXIT_FAILURE;
+    }
+
+    benchmark::Initialize(&argc, argv);
+    if(benchmark::ReportUnrecognizedArguments(argc, argv))
+    {
+        return EXIT_FAILURE;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    return 0;
+}
@@ -0,0 +1,203 @@
+#include <iostream>
+#include "gtest/gtest.h"
+#include "AllocationCounter.hpp"
+#include "HashMap.hpp"
+#include "SpamDetector.hpp"
+#include <string>
+#include <sstream>
+#include <vector>
+
+int main(int argc , char *argv[])
+{
+    testing::InitGoogleTest(&argc , argv);
+    return RUN_ALL_TESTS();
+}
+
+
+
+/**
+ * Allocation budgets of HashMap and of the scoring loop of SpamDetector.
+ * The keys are longer than the small string buffer, so every copy of a key allocates.
+ */
+
+std::string longKey(int i)
+{
+    return "a key that is too long for the small string buffer #" + std::to_string(i);
+}
+
+HashMap<std::string, int> makeStringMap(int size)
+{
+    HashMap<std::string, int> h;
+    for (int i = 0; i < size; i++)
+    {
+        h.insert(longKey(i), i);
+    }
+    return h;
+}
+
+TEST(AllocationTest, lookupHit)
+{
+    const HashMap<std::string, int> h = makeStringMap(1000);
+    std::vector<std::string> keys;
+    for (int i = 0; i < 1000; i++)
+    {
+        keys.push_back(longKey(i));
+    }
+    AllocationScope scope;
+    long sum = 0;
+    for (const std::string& key : keys)
+    {
+        EXPECT_TRUE(h.containsKey(key));
+        sum += h.at(key) + h[key] + h.bucketSize(key);
+    }
+    EXPECT_GT(sum, 0);
+    EXPECT_EQ(scope.allocations(), 0);
+}
+
+TEST(AllocationTest, lookupMiss)
+{
+    const HashMap<std::string, int> h = makeStringMap(1000);
+    const std::string missing = longKey(-1);
+    AllocationScope scope;
+    for (int i = 0; i < 1000; i++)
+    {
+        EXPECT_FALSE(h.containsKey(missing));
+        EXPECT_EQ(h[missing], 0);
+    }
+    EXPECT_EQ(scope.allocations(), 0);
+}
+
+TEST(AllocationTest, iterator)
+{
+    const HashMap<std::string, int> h = makeStringMap(1000);
+    AllocationScope scope;
+    int count = 0;
+    for (auto it = h.cbegin(); it != h.cend(); ++it)
+    {
+        count++;
+    }
+    for (const auto& pair : h)
+    {
+        count += pair.second >= 0 ? 1 : 0;
+    }
+    auto it = h.begin();
+    auto copy = it++;
+    EXPECT_NE(copy, it);
+    EXPECT_EQ(count, 2000);
+    EXPECT_EQ(scope.allocations(), 0);
+}
+
+TEST(AllocationTest, compare)
+{
+    const HashMap<std::string, int> h = makeStringMap(1000);
+    const HashMap<std::string, int> s = makeStringMap(1000);
+    AllocationScope scope;
+    EXPECT_TRUE(h == s);
+    EXPECT_FALSE(h != s);
+    EXPECT_EQ(scope.allocations(), 0);
+}
+
+TEST(AllocationTest, insertAndEraseAmortized)
+{
+    std::vector<std::string> keys;
+    for (int i = 0; i < 100000; i++)
+    {
+        keys.push_back(longKey(i));
+    }
+    HashMap<std::string, int> h;
+    AllocationScope insertScope;
+    for (const std::string& key : keys)
+    {
+        h.insert(key, 0);
+    }
+    // the copy of the key, the growth of its bucket and the rehashing
+    EXPECT_LE(insertScope.allocations(), 4 * 100000);
+
+    // a rehash allocates the new buckets, it never copies the keys
+    AllocationScope rehashScope;
+    h.rehashing(true);
+    EXPECT_LE(rehashScope.allocations(), h.capacity() / 2 + 2);
+
+    AllocationScope eraseScope;
+    for (const std::string& key : keys)
+    {
+        h.erase(key);
+    }
+    EXPECT_LE(eraseScope.allocations(), 2 * 100000);
+    EXPECT_EQ(h.size(), 0);
+}
+
+TEST(AllocationTest, loadAllocatesPerBucket)
+{
+    HashMap<int, int> h;
+    for (int i = 0; i < 100000; i++)
+    {
+        h.insert(i, i);
+    }
+    std::stringstream image;
+    h.save(image);
+    HashMap<int, int> loaded;
+    AllocationScope scope;
+    loaded.load(image);
+    // the bucket offsets, the buckets, a chunk of entries and every non empty bucket
+    EXPECT_LE(scope.allocations(), h.capacity() + 4);
+    EXPECT_TRUE(loaded == h);
+}
+
+/**
+ * @param numOfPatterns - number of bad sequences
+ * @return - a data base of bad sequences that are longer than the small string buffer
+ */
+HashMap<std::string, int> makeDataBase(int numOfPatterns)
+{
+    HashMap<std::string, int> dataBase;
+    for (int i = 0; i < numOfPatterns; i++)
+    {
+        dataBase.insert("Bad Sequence Number " + std::to_string(i) + " Of The Data Base", 1);
+    }
+    return dataBase;
+}
+
+/**
+ * @param options - the command line options
+ * @param numOfPatterns - number of bad sequences
+ * @return - the number of allocations of scoring a message
+ */
+long scoringAllocations(const ScanOptions& options, int numOfPatterns)
+{
+    DataBaseSnapshot snapshot;
+    snapshot.dataBase = makeDataBase(numOfPatterns);
+    if (options.tokens)
+    {
+        buildTokenDataBase(snapshot.dataBase, snapshot.tokenDataBase);
+    }
+    else if (options.earlyExit)
+    {
+        snapshot.patternsByPoints = sortPatternsByPoints(snapshot.dataBase);
+    }
+    std::string msg;
+    for (int i = 0; i < 100; i++)
+    {
+        msg += "some words and bad sequence number " + std::to_string(i) + " of the data base. ";
+    }
+    AllocationScope scope;
+    EXPECT_EQ(scoreMessage(msg, snapshot, options, 1000000), 100);
+    return scope.allocations();
+}
+
+TEST(AllocationTest, scoringDoesNotAllocatePerPattern)
+{
+    ScanOptions substrings;
+    ScanOptions earlyExit;
+    earlyExit.earlyExit = true;
+    ScanOptions tokens;
+    tokens.tokens = true;
+    for (const ScanOptions& options : {substrings, earlyExit, tokens})
+    {
+        long small = scoringAllocations(options, 100);
+        long large = scoringAllocations(options, 10000);
+        EXPECT_LE(small, 16);
+        // only the vectors that have an entry per pattern may grow with the data base
+        EXPECT_LE(large, small + 1);
+    }
+}
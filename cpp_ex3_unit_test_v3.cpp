@@ -1,8 +1,32 @@
 #include <iostream>
 #include "gtest/gtest.h"
 #include "HashMap.hpp"
+#include "MappedHashMap.hpp"
+#include "FrozenHashMap.hpp"
+#include "FlatHashMap.hpp"
+#include "HashSet.hpp"
+#include "HashMultiMap.hpp"
+#include "ShardedHashMap.hpp"
+#include "LruHashMap.hpp"
+#include "CompactHashMap.hpp"
+#include "SpamDetector.hpp"
 #include <string>
 #include <sstream>
+#include <fstream>
+#include <cstdio>
+#include <atomic>
+#include <functional>
+#include <stdexcept>
+#include <random>
+#include <vector>
+#include <initializer_list>
+#include <cctype>
+#include <thread>
+#include <regex>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/stat.h>
+#include <fcntl.h>
 
 int main(int argc , char *argv[])
 {
@@ -336,4 +360,1637 @@ TEST(HashMapTest, compare)
 	HashMap<int, int> a(keys_a, vals), b(keys_b, vals);
 	ASSERT_EQ(a,b);
 	ASSERT_EQ(a !=b, false);
-}
\ No newline at end of file
+}
+TEST(HashMapTest, bulkInsert)
+{
+    std::vector<std::pair<int, int>> pairs;
+    HashMap<int, int> serial;
+    for (int i = 0; i < 1000; i++)
+    {
+        pairs.emplace_back(i % 700, i);
+        serial.insert(i % 700, i);
+    }
+    for (int threads = 1; threads <= 4; threads++)
+    {
+        HashMap<int, int> h;
+        h.insert(5, -1);
+        EXPECT_EQ(h.bulkInsert(pairs, threads), 699);
+        EXPECT_EQ(h.size(), 700);
+        EXPECT_EQ(h.at(5), -1);
+        EXPECT_EQ(h.at(6), 6);
+        EXPECT_EQ(h.at(699), 699);
+        EXPECT_EQ(h.capacity(), serial.capacity());
+    }
+
+    HashMap<std::string, int> s;
+    EXPECT_EQ(s.bulkInsert({{"a", 1}, {"b", 2}, {"a", 3}}, 2), 2);
+    EXPECT_EQ(s.at("a"), 1);
+    EXPECT_EQ(s.capacity(), 16);
+}
+/**
+ * A key whose move throws if the key is negative
+ */
+struct ThrowingMoveKey
+{
+    int value;
+    explicit ThrowingMoveKey(int v) : value(v)
+    {
+    }
+    ThrowingMoveKey(const ThrowingMoveKey& other) = default;
+    ThrowingMoveKey(ThrowingMoveKey&& other) : value(other.value)
+    {
+        if (value < 0)
+        {
+            throw std::runtime_error("move");
+        }
+    }
+    bool operator==(const ThrowingMoveKey& other) const
+    {
+        return value == other.value;
+    }
+};
+struct ThrowingMoveKeyHash
+{
+    size_t operator()(const ThrowingMoveKey& key) const
+    {
+        return std::hash<int>()(key.value);
+    }
+};
+TEST(HashMapTest, bulkInsertThrows)
+{
+    std::vector<std::pair<ThrowingMoveKey, int>> pairs;
+    for (int i = 0; i < 1000; i++)
+    {
+        const ThrowingMoveKey key(i == 500 ? -1 : i);
+        pairs.emplace_back(key, i);
+    }
+    HashMap<ThrowingMoveKey, int, ThrowingMoveKeyHash> h;
+    EXPECT_THROW(h.bulkInsert(pairs, 4), std::runtime_error);
+    // the pairs that the other threads inserted are counted in the size
+    int count = 0;
+    for (auto it = h.cbegin(); it != h.cend(); ++it)
+    {
+        ++count;
+    }
+    EXPECT_GT(count, 0);
+    EXPECT_EQ(h.size(), count);
+}
+TEST(HashMapTest, threadJoiner)
+{
+    // the threads that were started are joined when the calling thread throws
+    std::atomic<int> finished(0);
+    std::vector<std::thread> threads;
+    try
+    {
+        ThreadJoiner joiner(threads);
+        for (int i = 0; i < 4; i++)
+        {
+            threads.emplace_back([&finished]()
+                                 {
+                                     std::this_thread::sleep_for(std::chrono::milliseconds(20));
+                                     ++finished;
+                                 });
+        }
+        throw std::runtime_error("the work of the calling thread failed");
+    }
+    catch (const std::runtime_error& e)
+    {
+        EXPECT_EQ(finished, 4);
+    }
+    for (std::thread& thread : threads)
+    {
+        EXPECT_FALSE(thread.joinable());
+    }
+}
+TEST(HashMapTest, parallelBulkOperations)
+{
+    for (int threads = 1; threads <= 5; threads++)
+    {
+        HashMap<int, int> h;
+        HashMap<int, int> serial;
+        for (int i = 0; i < 1000; i++)
+        {
+            h.insert(i, i);
+            serial.insert(i, i);
+        }
+        std::atomic<int> visited(0);
+        h.parallelForEach([&visited](const std::pair<int, int>& pair)
+                          {
+                              visited += pair.first == pair.second ? 1 : 0;
+                          }, threads);
+        EXPECT_EQ(visited, 1000);
+        EXPECT_EQ(h.parallelReduce(0L, [](const std::pair<int, int>& pair)
+                                       {
+                                           return long(pair.second);
+                                       }, std::plus<long>(), threads), 999L * 1000 / 2);
+
+        auto notMultipleOfThree = [](const std::pair<int, int>& pair)
+        {
+            return pair.first % 3 != 0;
+        };
+        EXPECT_EQ(h.eraseIf(notMultipleOfThree, threads), 666);
+        for (int i = 0; i < 1000; i++)
+        {
+            if (i % 3 != 0)
+            {
+                serial.erase(i);
+            }
+        }
+        EXPECT_EQ(h.size(), 334);
+        EXPECT_EQ(h.capacity(), serial.capacity());
+        EXPECT_TRUE(h == serial);
+        EXPECT_FALSE(h.containsKey(1));
+        EXPECT_EQ(h.at(999), 999);
+    }
+
+    HashMap<int, int> empty;
+    EXPECT_EQ(empty.parallelReduce(0, [](const std::pair<int, int>& pair)
+                                      {
+                                          return pair.second;
+                                      }, std::plus<int>(), 8), 0);
+    EXPECT_EQ(empty.eraseIf([](const std::pair<int, int>&)
+                            {
+                                return true;
+                            }, 8), 0);
+    empty.insert(1, 1);
+    EXPECT_THROW(empty.parallelForEach([](const std::pair<int, int>&)
+                                       {
+                                           throw std::runtime_error("error");
+                                       }, 4), std::runtime_error);
+}
+struct ReverseHash
+{
+    size_t operator()(int key) const
+    {
+        return 15 - key;
+    }
+};
+TEST(HashMapTest, customHash)
+{
+    HashMap<int, int, ReverseHash> h;
+    h.insert(0, 0);
+    h.insert(16, 16);
+    h.insert(15, 15);
+    EXPECT_EQ(h.bucketSize(0), 2);
+    EXPECT_EQ(h.bucketSize(16), 2);
+    EXPECT_EQ(h.bucketSize(15), 1);
+    EXPECT_EQ(h.at(16), 16);
+}
+TEST(HashMapTest, saveAndLoad)
+{
+    HashMap<int, double> h(1.0 / 8, 1.0 / 2);
+    for (int i = 0; i < 1000; i++)
+    {
+        h.insert(i * 7, i / 2.0);
+    }
+    std::stringstream image;
+    EXPECT_TRUE(h.save(image));
+    HashMap<int, double> loaded;
+    loaded.insert(-1, -1);
+    loaded.load(image);
+    EXPECT_TRUE(loaded == h);
+    EXPECT_EQ(loaded.capacity(), h.capacity());
+    EXPECT_EQ(loaded.getLowerBound(), 1.0 / 8);
+    EXPECT_EQ(loaded.bucketSize(7), h.bucketSize(7));
+    EXPECT_FALSE(loaded.containsKey(-1));
+
+    HashMap<std::string, std::string> s;
+    s.insert("", "empty");
+    s.insert("a key that is too long for the small string buffer", "");
+    s.insert("key", "value");
+    std::stringstream stringImage;
+    EXPECT_TRUE(s.save(stringImage));
+    HashMap<std::string, std::string> loadedStrings;
+    loadedStrings.load(stringImage);
+    EXPECT_TRUE(loadedStrings == s);
+    EXPECT_EQ(loadedStrings.at(""), "empty");
+
+    // an image of other types, or a truncated one, leaves the map unchanged
+    stringImage.clear();
+    stringImage.seekg(0);
+    EXPECT_THROW(loaded.load(stringImage), std::invalid_argument);
+    std::string truncated = image.str();
+    truncated.resize(truncated.size() - 1);
+    std::stringstream truncatedImage(truncated);
+    EXPECT_THROW(loaded.load(truncatedImage), std::invalid_argument);
+    EXPECT_TRUE(loaded == h);
+
+    // a header that claims more than the image holds is rejected once the stream ends, and only
+    // as much memory as the image holds is allocated for it; a size that does not fit in an int,
+    // or that is above the upper bound of the load factor, is rejected up front
+    HashMapImageHeader header = {};
+    std::memcpy(&header, image.str().data(), sizeof(header));
+    std::vector<HashMapImageHeader> corruptedHeaders(3, header);
+    corruptedHeaders[0].blobSize = uint64_t(1) << 62;
+    corruptedHeaders[1].size = uint64_t(1) << 31;
+    corruptedHeaders[2].size = header.capacity;
+    EXPECT_TRUE(isValidHashMapImageHeader(header));
+    EXPECT_FALSE(isValidHashMapImageHeader(corruptedHeaders[1]));
+    EXPECT_FALSE(isValidHashMapImageHeader(corruptedHeaders[2]));
+    for (const HashMapImageHeader& corrupted : corruptedHeaders)
+    {
+        std::string bytes = image.str();
+        std::memcpy(&bytes[0], &corrupted, sizeof(corrupted));
+        std::stringstream corruptedImage(bytes);
+        EXPECT_THROW(loaded.load(corruptedImage), std::invalid_argument);
+    }
+    EXPECT_TRUE(loaded == h);
+}
+TEST(HashMapTest, mappedHashMap)
+{
+    const std::string path = "mapped_hash_map_test.img";
+    HashMap<std::string, int> h;
+    for (int i = 0; i < 100; i++)
+    {
+        h.insert("bad sequence #" + std::to_string(i), i);
+    }
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        EXPECT_TRUE(h.save(out));
+    }
+    {
+        MappedHashMap<std::string, int> mapped(path);
+        EXPECT_EQ(mapped.size(), 100);
+        EXPECT_EQ(mapped.capacity(), h.capacity());
+        EXPECT_EQ(mapped.at("bad sequence #42"), 42);
+        EXPECT_EQ(mapped.bucketSize("bad sequence #42"), h.bucketSize("bad sequence #42"));
+        EXPECT_FALSE(mapped.containsKey("bad sequence #100"));
+        EXPECT_THROW(mapped.at("bad sequence #100"), std::invalid_argument);
+        long sum = 0;
+        mapped.forEach([&sum, &h](boost::string_view key, int value)
+                       {
+                           sum += h.at(std::string(key)) == value ? value : -1000;
+                       });
+        EXPECT_EQ(sum, 99 * 100 / 2);
+    }
+    EXPECT_THROW((MappedHashMap<int, int>(path)), std::invalid_argument);
+    std::remove(path.c_str());
+    EXPECT_THROW((MappedHashMap<std::string, int>(path)), std::runtime_error);
+}
+/**
+ * A hash that only looks at the first char, so many keys have the same hash
+ */
+struct FirstCharHash
+{
+    size_t operator()(const std::string& key) const
+    {
+        return key.empty() ? 0 : static_cast<unsigned char>(key[0]);
+    }
+};
+constexpr int frozenKeys[] = {3, 1, 4, 15, 9, 26, 5, 35, 8, 97};
+constexpr char frozenValues[] = {'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 'i', 'j'};
+constexpr StaticFrozenHashMap<int, char, 10> staticFrozen(frozenKeys, frozenValues);
+static_assert(staticFrozen.at(97) == 'j', "the map is built at compile time");
+static_assert(!staticFrozen.containsKey(2), "the map is built at compile time");
+TEST(HashMapTest, frozenHashMap)
+{
+    HashMap<int, int> h;
+    for (int i = 0; i < 10000; i++)
+    {
+        h.insert(i * 3, i);
+    }
+    FrozenHashMap<int, int> frozen(h);
+    EXPECT_EQ(frozen.size(), 10000);
+    for (int i = 0; i < 30000; i++)
+    {
+        EXPECT_EQ(frozen.containsKey(i), i % 3 == 0);
+        EXPECT_EQ(frozen[i], i % 3 == 0 ? i / 3 : 0);
+    }
+    EXPECT_THROW(frozen.at(1), std::invalid_argument);
+    EXPECT_LE(frozen.displacementBytes(), 2 * 10000);
+    long sum = 0;
+    for (const auto& pair : frozen)
+    {
+        sum += pair.second;
+    }
+    EXPECT_EQ(sum, 9999L * 10000 / 2);
+
+    FrozenHashMap<std::string, int> empty;
+    EXPECT_TRUE(empty.empty());
+    EXPECT_FALSE(empty.containsKey("a"));
+    FrozenHashMap<std::string, int> one({{"a", 1}});
+    EXPECT_EQ(one.at("a"), 1);
+    EXPECT_FALSE(one.containsKey("b"));
+    EXPECT_THROW((FrozenHashMap<std::string, int>({{"a", 1}, {"a", 2}})), std::invalid_argument);
+
+    // distinct keys with the same hash are found by comparing the keys
+    std::vector<std::pair<std::string, int>> pairs;
+    std::vector<std::string> keys;
+    for (int i = 0; i < 200; i++)
+    {
+        pairs.emplace_back(std::string(1, char('a' + i % 5)) + std::to_string(i), i);
+        keys.push_back(pairs.back().first);
+    }
+    keys.push_back("a1");
+    const FrozenHashMap<std::string, int, FirstCharHash> sameHashes(pairs);
+    EXPECT_EQ(sameHashes.size(), 200);
+    long sameHashesSum = 0;
+    for (const auto& pair : sameHashes)
+    {
+        sameHashesSum += pair.second;
+    }
+    EXPECT_EQ(sameHashesSum, 199L * 200 / 2);
+    std::vector<const int *> values(keys.size());
+    sameHashes.findBatch(keys.data(), keys.size(), values.data());
+    for (int i = 0; i < 200; i++)
+    {
+        EXPECT_EQ(sameHashes.at(pairs[i].first), i);
+        ASSERT_NE(values[i], nullptr);
+        EXPECT_EQ(*values[i], i);
+    }
+    EXPECT_FALSE(sameHashes.containsKey("a1"));
+    EXPECT_EQ(values[200], nullptr);
+    pairs.emplace_back("a0", 0);
+    EXPECT_THROW((FrozenHashMap<std::string, int, FirstCharHash>(pairs)), std::invalid_argument);
+
+    EXPECT_EQ(staticFrozen.size(), 10);
+    for (int i = 0; i < 10; i++)
+    {
+        EXPECT_EQ(staticFrozen.at(frozenKeys[i]), frozenValues[i]);
+    }
+    EXPECT_EQ(staticFrozen.find(0), nullptr);
+    EXPECT_THROW(staticFrozen.at(0), std::invalid_argument);
+}
+/**
+ * A value whose move may throw, so the HashMap copies it when rehashing
+ */
+struct ThrowingMoveValue
+{
+    int value = 0;
+    ThrowingMoveValue() = default;
+    ThrowingMoveValue(int value) : value(value)
+    {
+    }
+    ThrowingMoveValue(const ThrowingMoveValue& other) noexcept(false) : value(other.value)
+    {
+    }
+    ThrowingMoveValue& operator=(const ThrowingMoveValue& other) noexcept(false)
+    {
+        value = other.value;
+        return *this;
+    }
+    bool operator==(const ThrowingMoveValue& other) const
+    {
+        return value == other.value;
+    }
+};
+TEST(HashMapTest, assignmentAndRehash)
+{
+    HashMap<int, int> h;
+    HashMap<int, int> s;
+    for (int i = 0; i < 10; i++)
+    {
+        h.insert(i, i);
+        s.insert(i + 100, i);
+    }
+    EXPECT_EQ(h.capacity(), s.capacity());
+    s = h;
+    EXPECT_EQ(s.size(), 10);
+    EXPECT_TRUE(s == h);
+    EXPECT_EQ(s.bucketSize(0), 1);
+    EXPECT_FALSE(s.containsKey(100));
+    s = s;
+    EXPECT_TRUE(s == h);
+
+    HashMap<int, std::string> strings;
+    HashMap<int, ThrowingMoveValue> values;
+    for (int i = 0; i < 1000; i++)
+    {
+        strings.insert(i * 5, std::to_string(i));
+        values.insert(i * 5, i);
+    }
+    for (int i = 0; i < 1000; i += 2)
+    {
+        strings.erase(i * 5);
+        values.erase(i * 5);
+    }
+    for (int grow : {1, 0, 0, 1, 1})
+    {
+        strings.rehashing(grow == 1);
+        values.rehashing(grow == 1);
+        EXPECT_EQ(strings.capacity(), values.capacity());
+        EXPECT_EQ(strings.bucketSize(15), values.bucketSize(15));
+        for (int i = 0; i < 1000; i++)
+        {
+            EXPECT_EQ(strings.containsKey(i * 5), i % 2 == 1);
+            EXPECT_EQ(values.containsKey(i * 5), i % 2 == 1);
+        }
+        EXPECT_EQ(strings.at(4995), "999");
+        EXPECT_EQ(values.at(4995).value, 999);
+    }
+    HashMap<int, int> one;
+    one.insert(1, 1);
+    while (one.capacity() > 1)
+    {
+        one.rehashing(false);
+    }
+    one.rehashing(false);
+    EXPECT_EQ(one.capacity(), 1);
+    EXPECT_EQ(one.at(1), 1);
+}
+TEST(HashMapTest, flatHashMap)
+{
+    FlatHashMap<int, int> flat;
+    HashMap<int, int> h;
+    std::mt19937 random(2019);
+    for (int i = 0; i < 200000; i++)
+    {
+        int key = static_cast<int>(random() % 5000) * 16;
+        switch (random() % 3)
+        {
+            case 0:
+                EXPECT_EQ(flat.insert(key, i), h.insert(key, i));
+                break;
+            case 1:
+                EXPECT_EQ(flat.erase(key), h.erase(key));
+                break;
+            default:
+                EXPECT_EQ(flat.containsKey(key), h.containsKey(key));
+                EXPECT_EQ(flat.containsKey(key) ? flat.at(key) : -1, \
+                          h.containsKey(key) ? h.at(key) : -1);
+        }
+        ASSERT_EQ(flat.size(), h.size());
+    }
+    long sum = 0;
+    for (const auto& pair : flat)
+    {
+        sum += pair.second - h.at(pair.first);
+    }
+    EXPECT_EQ(sum, 0);
+    EXPECT_LE(flat.size() * 8, flat.capacity() * 7);
+
+    FlatHashMap<std::string, std::string> strings;
+    for (int i = 0; i < 1000; i++)
+    {
+        strings[std::to_string(i)] = std::to_string(i * 2);
+    }
+    FlatHashMap<std::string, std::string> copy(strings);
+    EXPECT_TRUE(copy.erase("7"));
+    FlatHashMap<std::string, std::string> moved(std::move(copy));
+    EXPECT_EQ(moved.size(), 999);
+    EXPECT_EQ(copy.size(), 0);
+    EXPECT_FALSE(copy.containsKey("8"));
+    EXPECT_EQ(copy.begin(), copy.end());
+    EXPECT_FALSE(moved.containsKey("7"));
+    EXPECT_EQ(strings.at("7"), "14");
+    EXPECT_THROW(moved.at("7"), std::invalid_argument);
+    strings = moved;
+    EXPECT_EQ(strings.size(), 999);
+    strings.clear();
+    EXPECT_TRUE(strings.empty());
+    EXPECT_FALSE(strings.containsKey("8"));
+    moved.rehashing(true);
+    moved.rehashing(false);
+    EXPECT_EQ(moved.at("999"), "1998");
+    // a map that was moved from is usable again after clear or rehashing
+    FlatHashMap<std::string, std::string> cleared(std::move(strings));
+    strings.clear();
+    EXPECT_EQ(strings.capacity(), FLAT_HASHMAP_GROUP_WIDTH);
+    EXPECT_FALSE(strings.containsKey("8"));
+    EXPECT_TRUE(strings.insert("8", "16"));
+    EXPECT_EQ(strings.at("8"), "16");
+    FlatHashMap<std::string, std::string> rehashed(std::move(moved));
+    moved.rehashing(true);
+    EXPECT_EQ(moved.capacity(), FLAT_HASHMAP_GROUP_WIDTH);
+    for (int i = 0; i < 100; i++)
+    {
+        EXPECT_TRUE(moved.insert(std::to_string(i), ""));
+    }
+    EXPECT_EQ(moved.size(), 100);
+    EXPECT_EQ(rehashed.at("999"), "1998");
+
+    int8_t group[FLAT_HASHMAP_GROUP_WIDTH];
+    for (int i = 0; i < 1000; i++)
+    {
+        for (int8_t& control : group)
+        {
+            int kind = static_cast<int>(random() % 4);
+            control = kind == 0 ? FLAT_HASHMAP_EMPTY : kind == 1 ? FLAT_HASHMAP_DELETED : \
+                      static_cast<int8_t>(random() % 4);
+        }
+        EXPECT_EQ(flatGroupMatch(group, 3), flatGroupMatchScalar(group, 3));
+        EXPECT_EQ(flatGroupMatch(group, FLAT_HASHMAP_EMPTY), \
+                  flatGroupMatchScalar(group, FLAT_HASHMAP_EMPTY));
+        EXPECT_EQ(flatGroupMatchFree(group), flatGroupMatchFreeScalar(group));
+    }
+}
+TEST(HashMapTest, findBatch)
+{
+    HashMap<int, int> h;
+    std::vector<int> keys;
+    for (int i = 0; i < 1000; i++)
+    {
+        h.insert(i * 3, i);
+        keys.push_back(i * 2);
+    }
+    std::vector<int *> values(keys.size());
+    h.findBatch(keys.data(), keys.size(), values.data());
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        if (keys[i] % 3 == 0)
+        {
+            ASSERT_NE(values[i], nullptr);
+            EXPECT_EQ(*values[i], keys[i] / 3);
+        }
+        else
+        {
+            EXPECT_EQ(values[i], nullptr);
+        }
+    }
+    *values[0] = -1;
+    EXPECT_EQ(h.at(0), -1);
+
+    const HashMap<int, int> empty(std::vector<int>{}, std::vector<int>{});
+    std::vector<const int *> constValues(keys.size(), &keys[0]);
+    empty.findBatch(keys.data(), keys.size(), constValues.data());
+    EXPECT_EQ(std::count(constValues.begin(), constValues.end(), nullptr), keys.size());
+
+    std::vector<std::pair<int, int>> pairs;
+    for (int i = 0; i < 1000; i++)
+    {
+        pairs.emplace_back(i * 3, i);
+    }
+    const FrozenHashMap<int, int> frozen(pairs);
+    frozen.findBatch(keys.data(), 5, constValues.data());
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        EXPECT_EQ(constValues[i], i < 5 ? frozen.find(keys[i]) : nullptr);
+    }
+    frozen.findBatch(keys.data(), keys.size(), constValues.data());
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        EXPECT_EQ(constValues[i], frozen.find(keys[i]));
+    }
+}
+TEST(HashMapTest, hashSetAndMultiMap)
+{
+    HashSet<int> set;
+    HashMap<int, int> h;
+    std::mt19937 random(2019);
+    for (int i = 0; i < 100000; i++)
+    {
+        int key = static_cast<int>(random() % 3000);
+        if (random() % 2 == 0)
+        {
+            EXPECT_EQ(set.insert(key), h.insert(key, i));
+        }
+        else
+        {
+            EXPECT_EQ(set.erase(key), h.erase(key));
+        }
+        ASSERT_EQ(set.size(), h.size());
+        ASSERT_EQ(set.capacity(), h.capacity());
+    }
+    int numOfKeys = 0;
+    for (int key : set)
+    {
+        EXPECT_TRUE(h.containsKey(key));
+        ++numOfKeys;
+    }
+    EXPECT_EQ(numOfKeys, set.size());
+    HashSet<int> copy(set);
+    EXPECT_TRUE(copy == set);
+    copy.insert(-1);
+    EXPECT_TRUE(copy != set);
+    EXPECT_THROW(set.bucketSize(-1), std::invalid_argument);
+    HashSet<std::string> strings(std::vector<std::string>{"a", "b", "a"});
+    EXPECT_EQ(strings.size(), 2);
+    EXPECT_TRUE(strings.containsKey("b"));
+    EXPECT_FALSE(strings.containsKey("c"));
+
+    HashMultiMap<std::string, int> multi;
+    for (int i = 0; i < 1000; i++)
+    {
+        multi.insert(std::to_string(i % 100), i);
+    }
+    EXPECT_EQ(multi.size(), 1000);
+    EXPECT_EQ(multi.count("7"), 10);
+    EXPECT_EQ(multi.count("100"), 0);
+    int sum = 0;
+    multi.forEachValue("7", [&sum](int value)
+    {
+        sum += value;
+    });
+    EXPECT_EQ(sum, 10 * 7 + 100 * 45);
+    for (int i = 0; i < 95; i++)
+    {
+        EXPECT_EQ(multi.erase(std::to_string(i)), 10);
+    }
+    EXPECT_EQ(multi.erase("7"), 0);
+    EXPECT_FALSE(multi.containsKey("7"));
+    EXPECT_TRUE(multi.containsKey("99"));
+    EXPECT_EQ(multi.size(), 50);
+    EXPECT_GE(multi.getLoadFactor(), multi.getLowerBound());
+    HashMultiMap<std::string, int> moved(std::move(multi));
+    EXPECT_EQ(moved.count("99"), 10);
+    moved.clear();
+    EXPECT_TRUE(moved.empty());
+}
+TEST(HashMapTest, shardedHashMap)
+{
+    ShardedHashMap<int, long, 8> sharded;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++)
+    {
+        threads.emplace_back([&sharded, t]()
+        {
+            for (int i = 0; i < 20000; i++)
+            {
+                sharded.update(i % 1000, [](long& count)
+                {
+                    ++count;
+                });
+                if (i % 4 == t)
+                {
+                    sharded.insert(100000 + i, i);
+                }
+            }
+        });
+    }
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+    EXPECT_EQ(sharded.size(), 1000 + 20000);
+    for (int key = 0; key < 1000; key++)
+    {
+        ASSERT_EQ(sharded.at(key), 80);
+    }
+    long value = 0;
+    EXPECT_TRUE(sharded.find(100007, value));
+    EXPECT_EQ(value, 7);
+    EXPECT_FALSE(sharded.find(-1, value));
+    EXPECT_THROW(sharded.at(-1), std::invalid_argument);
+    EXPECT_FALSE(sharded.insert(5, 0));
+    EXPECT_TRUE(sharded.erase(5));
+    EXPECT_FALSE(sharded.containsKey(5));
+
+    int minShard = sharded.size();
+    int maxShard = 0;
+    for (int i = 0; i < sharded.numOfShards(); i++)
+    {
+        minShard = std::min(minShard, sharded.shardSize(i));
+        maxShard = std::max(maxShard, sharded.shardSize(i));
+    }
+    EXPECT_GT(minShard * 2, maxShard);
+    long sum = 0;
+    sharded.forEach([&sum](const std::pair<int, long>& pair)
+    {
+        sum += pair.first < 100000 ? pair.second : 0;
+    });
+    EXPECT_EQ(sum, 999 * 80);
+    sharded.clear();
+    EXPECT_EQ(sharded.size(), 0);
+
+    const ShardedHashMap<int, int, 3> bounded(1.0 / 8, 1.0 / 2);
+    EXPECT_FALSE(bounded.containsKey(1));
+}
+/**
+ * A clock that moves only when a test moves it
+ */
+struct ManualClock
+{
+    typedef std::chrono::milliseconds duration;
+    typedef std::chrono::time_point<ManualClock, duration> time_point;
+    static time_point current;
+
+    static time_point now()
+    {
+        return current;
+    }
+};
+ManualClock::time_point ManualClock::current;
+TEST(HashMapTest, lruHashMap)
+{
+    LruHashMap<int, std::string> lru(3);
+    for (int i = 0; i < 3; i++)
+    {
+        EXPECT_TRUE(lru.insert(i, std::to_string(i)));
+    }
+    ASSERT_NE(lru.find(0), nullptr);
+    EXPECT_TRUE(lru.insert(3, "3"));
+    EXPECT_EQ(lru.size(), 3u);
+    EXPECT_EQ(lru.evictions(), 1u);
+    EXPECT_FALSE(lru.containsKey(1));
+    EXPECT_EQ(*lru.find(0), "0");
+    EXPECT_FALSE(lru.insert(2, "two"));
+    EXPECT_EQ(*lru.peek(2), "two");
+    EXPECT_EQ(lru.find(1), nullptr);
+    EXPECT_EQ(lru.hits(), 2u);
+    EXPECT_EQ(lru.misses(), 1u);
+    std::vector<int> order;
+    lru.forEachFromOldest([&order](int key, const std::string&)
+    {
+        order.push_back(key);
+    });
+    EXPECT_EQ(order, std::vector<int>({3, 0, 2}));
+    EXPECT_TRUE(lru.erase(0));
+    EXPECT_FALSE(lru.erase(0));
+    EXPECT_TRUE(lru.insert(4, "4"));
+    EXPECT_EQ(lru.size(), 3u);
+
+    LruHashMap<int, int> bounded(1000, 100);
+    for (int i = 0; i < 100; i++)
+    {
+        bounded.insert(i, i, 30);
+        ASSERT_LE(bounded.bytes(), 100u);
+    }
+    EXPECT_EQ(bounded.size(), 3u);
+    EXPECT_EQ(bounded.evictions(), 97u);
+    bounded.insert(-1, -1, 500);
+    EXPECT_EQ(bounded.size(), 1u);
+    EXPECT_TRUE(bounded.containsKey(-1));
+    bounded.clear();
+    EXPECT_EQ(bounded.bytes(), 0u);
+    EXPECT_THROW((LruHashMap<int, int>(0)), std::out_of_range);
+
+    LruHashMap<int, int, std::hash<int>, ManualClock> expiring(10, 1000, \
+                                                              std::chrono::milliseconds(100));
+    expiring.insert(1, 1);
+    ManualClock::current += std::chrono::milliseconds(60);
+    expiring.insert(2, 2);
+    EXPECT_NE(expiring.find(1), nullptr);
+    ManualClock::current += std::chrono::milliseconds(60);
+    EXPECT_FALSE(expiring.containsKey(1));
+    EXPECT_EQ(expiring.find(1), nullptr);
+    EXPECT_EQ(expiring.expirations(), 1u);
+    EXPECT_EQ(*expiring.find(2), 2);
+    EXPECT_EQ(expiring.size(), 1u);
+    ManualClock::current += std::chrono::milliseconds(60);
+    EXPECT_FALSE(expiring.erase(2));
+    EXPECT_EQ(expiring.size(), 0u);
+}
+TEST(HashMapTest, compactHashMap)
+{
+    CompactHashMap<int, int> compact;
+    HashMap<int, int> h;
+    std::mt19937 random(2019);
+    for (int i = 0; i < 200000; i++)
+    {
+        int key = static_cast<int>(random() % 5000) * 32;
+        switch (random() % 3)
+        {
+            case 0:
+                EXPECT_EQ(compact.insert(key, i), h.insert(key, i));
+                break;
+            case 1:
+                EXPECT_EQ(compact.erase(key), h.erase(key));
+                break;
+            default:
+                EXPECT_EQ(compact.containsKey(key) ? compact.at(key) : -1, \
+                          h.containsKey(key) ? h.at(key) : -1);
+        }
+        ASSERT_EQ(compact.size(), h.size());
+    }
+    int numOfPairs = 0;
+    for (const auto& pair : compact)
+    {
+        EXPECT_EQ(pair.second, h.at(pair.first));
+        ++numOfPairs;
+    }
+    EXPECT_EQ(numOfPairs, h.size());
+
+    CompactHashMap<std::string, int> ordered;
+    for (int i = 0; i < 100000; i++)
+    {
+        ordered[std::to_string(i)] = i;
+        if (i == 50)
+        {
+            EXPECT_EQ(ordered.indexBytes(), size_t(ordered.capacity()));
+        }
+    }
+    EXPECT_EQ(ordered.indexBytes(), size_t(ordered.capacity()) * 4);
+    for (int i = 0; i < 100000; i += 2)
+    {
+        EXPECT_TRUE(ordered.erase(std::to_string(i)));
+    }
+    EXPECT_FALSE(ordered.erase("0"));
+    EXPECT_THROW(ordered.at("0"), std::invalid_argument);
+    EXPECT_FALSE(ordered.insert("1", 0));
+    ordered.insert("0", -1);
+    int previous = -1;
+    std::string lastKey;
+    for (const auto& pair : ordered)
+    {
+        lastKey = pair.first;
+        if (pair.first != "0")
+        {
+            EXPECT_EQ(pair.second, previous + 2);
+            previous = pair.second;
+        }
+    }
+    EXPECT_EQ(previous, 99999);
+    EXPECT_EQ(lastKey, "0");
+    CompactHashMap<std::string, int> copy(ordered);
+    EXPECT_TRUE(copy == ordered);
+    copy["0"] = 5;
+    EXPECT_TRUE(copy != ordered);
+    ordered.rehashing(true);
+    ordered.rehashing(false);
+    ordered.rehashing(false);
+    EXPECT_EQ(ordered.at("99999"), 99999);
+    ordered.clear();
+    EXPECT_TRUE(ordered.empty());
+    EXPECT_EQ(ordered.begin(), ordered.end());
+}
+TEST(HashMapTest, eraseInPlace)
+{
+    HashMap<int, int> h;
+    for (int i = 0; i < 10000; i++)
+    {
+        h.insert(i, i);
+    }
+    int capacity = h.capacity();
+    int visited = 0;
+    for (auto it = h.cbegin(); it != h.cend();)
+    {
+        ++visited;
+        it = it->first % 3 == 0 ? h.erase(it) : std::next(it);
+    }
+    EXPECT_EQ(visited, 10000);
+    EXPECT_EQ(h.size(), 6666);
+    EXPECT_EQ(h.capacity(), capacity);
+    for (int i = 0; i < 10000; i++)
+    {
+        ASSERT_EQ(h.containsKey(i), i % 3 != 0);
+    }
+
+    HashMap<int, int> byKey(h);
+    HashMap<int, int> parallel(h);
+    auto odd = [](const std::pair<int, int>& pair)
+    {
+        return pair.second % 2 == 1;
+    };
+    EXPECT_EQ(h.eraseIf(odd), 3333);
+    EXPECT_EQ(parallel.eraseIf(odd, 4), 3333);
+    for (int i = 1; i < 10000; i += 2)
+    {
+        byKey.erase(i);
+    }
+    EXPECT_TRUE(h == byKey);
+    EXPECT_TRUE(h == parallel);
+    EXPECT_EQ(h.eraseIf(odd), 0);
+    EXPECT_FALSE(h.erase(1));
+
+    HashSet<std::string> set;
+    for (int i = 0; i < 100; i++)
+    {
+        set.insert(std::to_string(i));
+    }
+    for (auto it = set.cbegin(); it != set.cend();)
+    {
+        it = *it != "42" ? set.erase(it) : std::next(it);
+    }
+    EXPECT_EQ(set.size(), 1);
+    EXPECT_TRUE(set.containsKey("42"));
+    EXPECT_TRUE(set.erase("42"));
+    EXPECT_TRUE(set.empty());
+}
+
+
+
+/**
+ * SpamDetector related tests.
+ */
+
+/**
+ * Command line arguments for the functions of SpamDetector that take argv
+ */
+class Arguments
+{
+public:
+    Arguments(std::initializer_list<std::string> args) : _args(args)
+    {
+        for (std::string& arg : _args)
+        {
+            _argv.push_back(&arg[0]);
+        }
+    }
+
+    char **argv()
+    {
+        return _argv.data();
+    }
+
+private:
+    std::vector<std::string> _args;
+    std::vector<char *> _argv;
+};
+
+void writeFile(const std::string& path, const std::string& content)
+{
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out << content;
+}
+
+std::string readFile(const std::string& path)
+{
+    std::ifstream in(path, std::ios::binary);
+    std::ostringstream content;
+    content << in.rdbuf();
+    return content.str();
+}
+
+/**
+ * @param path - path of a csv data base or of a compiled image
+ * @param options - the options to load it with
+ * @return - the data base
+ */
+HashMap<std::string, int> loadTestDataBase(const std::string& path, const ScanOptions& options)
+{
+    HashMap<std::string, int> dataBase;
+    Arguments args({path});
+    long invalidLine = 0;
+    EXPECT_TRUE(loadDataBase(dataBase, args.argv(), 0, options, invalidLine));
+    return dataBase;
+}
+
+/**
+ * @param dataBase - a data base
+ * @param other - other data base
+ * @return - true if both have the same bad sequences with the same points
+ */
+bool sameDataBase(const HashMap<std::string, int>& dataBase, \
+                  const HashMap<std::string, int>& other)
+{
+    if (dataBase.size() != other.size())
+    {
+        return false;
+    }
+    for (const auto& pair : dataBase)
+    {
+        if (!other.containsKey(pair.first) || other.at(pair.first) != pair.second)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+TEST(SpamDetectorTest, compiledImage)
+{
+    // a repeated bad sequence keeps its first points, also in the image
+    writeFile("image_test.csv", "free,1\nFREE,2\nwin,3\nfree,9\nbuy now,0\n");
+    Arguments args({"image_test.csv", "image_test.img"});
+    long invalidLine = 0;
+    ASSERT_TRUE(compileDataBase(args.argv(), 0, 1, invalidLine));
+    ScanOptions compiled;
+    compiled.dbCompiled = true;
+    const HashMap<std::string, int> csvDataBase = loadTestDataBase("image_test.csv", ScanOptions());
+    const HashMap<std::string, int> imageDataBase = loadTestDataBase("image_test.img", compiled);
+    EXPECT_EQ(imageDataBase.size(), 4);
+    EXPECT_TRUE(sameDataBase(imageDataBase, csvDataBase));
+
+    const std::string image = readFile("image_test.img");
+    Arguments imageArgs({"image_test.img"});
+    HashMap<std::string, int> dataBase;
+    // a flipped bit in any record, a truncated image and a csv are all rejected
+    for (size_t i = sizeof(CompiledDataBaseHeader); i < image.length(); i += 7)
+    {
+        std::string corrupted = image;
+        corrupted[i] ^= 1;
+        writeFile("image_test.img", corrupted);
+        EXPECT_FALSE(insertCompiledDataBaseToHashMap(dataBase, imageArgs.argv(), 0));
+    }
+    writeFile("image_test.img", image.substr(0, image.length() - 1));
+    EXPECT_FALSE(insertCompiledDataBaseToHashMap(dataBase, imageArgs.argv(), 0));
+    writeFile("image_test.img", readFile("image_test.csv"));
+    EXPECT_FALSE(insertCompiledDataBaseToHashMap(dataBase, imageArgs.argv(), 0));
+    writeFile("image_test.img", image);
+    EXPECT_TRUE(insertCompiledDataBaseToHashMap(dataBase, imageArgs.argv(), 0));
+
+    // an invalid csv is not compiled
+    writeFile("image_test.csv", "free,1\nwin\n");
+    EXPECT_FALSE(compileDataBase(args.argv(), 0, 1, invalidLine));
+    EXPECT_EQ(invalidLine, 2);
+    std::remove("image_test.csv");
+    std::remove("image_test.img");
+}
+TEST(SpamDetectorTest, invalidLine)
+{
+    const std::string invalidLines[] = {"no points", ",1", "a,", "a,1,2", "a,-1", "a,2147483648", \
+                                        ""};
+    for (const std::string& invalid : invalidLines)
+    {
+        for (int line : {1, 2, 37, 100})
+        {
+            std::string content;
+            for (int i = 1; i <= 100; i++)
+            {
+                content += (i == line ? invalid : "bad sequence " + std::to_string(i) + ",1") + \
+                           "\n";
+            }
+            HashMap<std::string, int> dataBase;
+            long invalidLine = 0;
+            EXPECT_FALSE(insertDataBaseContentToHashMap(dataBase, content, invalidLine));
+            EXPECT_EQ(invalidLine, line);
+            for (int threads = 1; threads <= 8; threads++)
+            {
+                invalidLine = 0;
+                EXPECT_FALSE(insertDataBaseContentToHashMapParallel(dataBase, content, threads, \
+                                                                    invalidLine));
+                EXPECT_EQ(invalidLine, line);
+            }
+        }
+    }
+
+    // a valid data base loads the same in chunks, with or without a last new line
+    std::string content;
+    for (int i = 0; i < 1000; i++)
+    {
+        content += "bad sequence " + std::to_string(i % 700) + "," + std::to_string(i) + "\n";
+    }
+    HashMap<std::string, int> serial;
+    long invalidLine = 0;
+    ASSERT_TRUE(insertDataBaseContentToHashMap(serial, content, invalidLine));
+    EXPECT_EQ(serial.size(), 700);
+    for (int threads = 1; threads <= 8; threads++)
+    {
+        HashMap<std::string, int> chunked;
+        ASSERT_TRUE(insertDataBaseContentToHashMapParallel(chunked, content, threads, \
+                                                           invalidLine));
+        EXPECT_TRUE(sameDataBase(chunked, serial));
+        HashMap<std::string, int> noLastNewLine;
+        ASSERT_TRUE(insertDataBaseContentToHashMapParallel(\
+            noLastNewLine, boost::string_view(content).substr(0, content.length() - 1), threads, \
+            invalidLine));
+        EXPECT_TRUE(sameDataBase(noLastNewLine, serial));
+    }
+
+    writeFile("invalid_line_test.csv", "free,1\nwin,3\nwin,3,\n");
+    Arguments args({"invalid_line_test.csv"});
+    HashMap<std::string, int> dataBase;
+    EXPECT_FALSE(insertDataFromDataBaseToHashMap(dataBase, args.argv(), 0, invalidLine));
+    EXPECT_EQ(invalidLine, 3);
+    std::remove("invalid_line_test.csv");
+}
+TEST(SpamDetectorTest, scanCommand)
+{
+    writeFile("scan_command_test.csv", "free,1\nwin\nbuy now,3\n");
+    writeFile("scan_command_test.txt", "Free money, WIN now");
+    Arguments args({"SpamDetector", "scan_command_test.csv", "scan_command_test.txt", "4"});
+    std::ostringstream out;
+    std::ostringstream err;
+    std::streambuf *coutBuffer = std::cout.rdbuf(out.rdbuf());
+    std::streambuf *cerrBuffer = std::cerr.rdbuf(err.rdbuf());
+    // an invalid data base is reported with its first invalid line, and nothing is scored
+    const int invalidResult = runScanCommand(4, args.argv());
+    const std::string invalidOut = out.str();
+    const std::string invalidErr = err.str();
+    writeFile("scan_command_test.csv", "free,1\nwin,3\nbuy now,3\n");
+    out.str("");
+    err.str("");
+    const int validResult = runScanCommand(4, args.argv());
+    std::cout.rdbuf(coutBuffer);
+    std::cerr.rdbuf(cerrBuffer);
+    EXPECT_EQ(invalidResult, EXIT_FAILURE);
+    EXPECT_EQ(invalidErr, "Invalid input at line 2\n");
+    EXPECT_EQ(invalidOut, "");
+    EXPECT_EQ(validResult, 0);
+    EXPECT_EQ(err.str(), "");
+    EXPECT_EQ(out.str(), "SPAM\n");
+    std::remove("scan_command_test.csv");
+    std::remove("scan_command_test.txt");
+}
+
+/**
+ * A client of a ScoringDaemon, on a socketpair whose other end the daemon serves
+ */
+class DaemonClient
+{
+public:
+    explicit DaemonClient(ScoringDaemon& daemon) : _fd(-1)
+    {
+        int fds[2];
+        EXPECT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+        EXPECT_TRUE(daemon.addConnection(fds[0]));
+        _fd = fds[1];
+        struct timeval timeout = {5, 0};
+        setsockopt(_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    }
+
+    ~DaemonClient()
+    {
+        close(_fd);
+    }
+
+    int fd() const
+    {
+        return _fd;
+    }
+
+    /**
+     * @param request - bytes to send, may be empty
+     * @return - the next line of response, with its '\n', or what was read until the daemon
+     *           closed the connection
+     */
+    std::string send(const std::string& request)
+    {
+        if (!request.empty())
+        {
+            EXPECT_EQ(::send(_fd, request.data(), request.length(), MSG_NOSIGNAL), \
+                      (ssize_t) request.length());
+        }
+        std::string line;
+        char c = 0;
+        while (line.empty() || line.back() != '\n')
+        {
+            if (recv(_fd, &c, 1, 0) != 1)
+            {
+                break;
+            }
+            line += c;
+        }
+        return line;
+    }
+
+private:
+    int _fd;
+};
+
+TEST(SpamDetectorTest, daemonProtocol)
+{
+    writeFile("daemon_test.csv", "free,1\nFREE,2\nwin,3\n");
+    writeFile("daemon_test.txt", "Free money, WIN");
+    Arguments args({"daemon_test.csv"});
+    ScanOptions options;
+    options.cache = true;
+    ScoringDaemon daemon(args.argv(), 0, options);
+    ASSERT_TRUE(daemon.start(2));
+    DaemonClient client(daemon);
+    DaemonClient other(daemon);
+    std::thread loop(&ScoringDaemon::serve, &daemon);
+
+    EXPECT_EQ(client.send("SCORE 6 daemon_test.txt\n"), "6 SPAM\n");
+    EXPECT_EQ(client.send("SCORE 7 daemon_test.txt\n"), "6 NOT_SPAM\n");
+    EXPECT_EQ(client.send("MESSAGE 3 8\nwin free"), "6 SPAM\n");
+    // a message may come in several parts, and may hold new lines
+    EXPECT_EQ(::send(client.fd(), "MESSAGE 10 9\nwin", 16, 0), 16);
+    EXPECT_EQ(client.send("\nwin\nw"), "6 NOT_SPAM\n");
+    EXPECT_EQ(other.send("STATS\n"), "STATS 1 3 3\n");
+    // an invalid threshold is answered, and the connection goes on
+    EXPECT_EQ(client.send("SCORE 0 daemon_test.txt\n"), "ERROR Invalid input\n");
+    EXPECT_EQ(client.send("SCORE 1 daemon_test_missing.txt\n"), "ERROR Invalid input\n");
+    EXPECT_EQ(client.send("SCORE 1 daemon_test.txt\n"), "6 SPAM\n");
+    // a malformed request closes the connection
+    EXPECT_EQ(client.send("SCORE 1\n"), "ERROR Invalid input\n");
+    EXPECT_EQ(client.send(""), "");
+    EXPECT_EQ(other.send("STATS\n"), "STATS 2 3 3\n");
+
+    daemon.stop();
+    loop.join();
+    std::remove("daemon_test.csv");
+    std::remove("daemon_test.txt");
+}
+
+/**
+ * Set the modification time of a file
+ * @param path - the file
+ * @param seconds - the new modification time
+ */
+void setModificationTime(const std::string& path, time_t seconds)
+{
+    struct timespec times[2] = {{0, UTIME_OMIT}, {seconds, 0}};
+    EXPECT_EQ(utimensat(AT_FDCWD, path.c_str(), times, 0), 0);
+}
+
+TEST(SpamDetectorTest, daemonReload)
+{
+    writeFile("reload_test.csv", "free,1\nwin,3\n");
+    writeFile("reload_test.delta", "+money,10\n");
+    setModificationTime("reload_test.csv", 1000000000);
+    setModificationTime("reload_test.delta", 1000000000);
+    Arguments args({"reload_test.csv"});
+    ScanOptions options;
+    options.deltaPaths.push_back("reload_test.delta");
+
+    // the version of the files changes with their modification time and with their inode
+    const std::string state = dataBaseFilesState(args.argv(), 0, options);
+    const uint64_t version = dataBaseCacheVersion(args.argv(), 0, options);
+    EXPECT_EQ(dataBaseFilesState(args.argv(), 0, options), state);
+    setModificationTime("reload_test.delta", 1000000001);
+    EXPECT_NE(dataBaseFilesState(args.argv(), 0, options), state);
+    EXPECT_NE(dataBaseCacheVersion(args.argv(), 0, options), version);
+    setModificationTime("reload_test.delta", 1000000000);
+    EXPECT_EQ(dataBaseCacheVersion(args.argv(), 0, options), version);
+    writeFile("reload_test.new", readFile("reload_test.csv"));
+    setModificationTime("reload_test.new", 1000000000);
+    ASSERT_EQ(std::rename("reload_test.new", "reload_test.csv"), 0);
+    EXPECT_NE(dataBaseFilesState(args.argv(), 0, options), state);
+    EXPECT_NE(dataBaseCacheVersion(args.argv(), 0, options), version);
+    // the matching mode is part of the version, but not of the state of the files
+    ScanOptions tokens = options;
+    tokens.tokens = true;
+    EXPECT_EQ(dataBaseFilesState(args.argv(), 0, tokens), \
+              dataBaseFilesState(args.argv(), 0, options));
+    EXPECT_NE(dataBaseCacheVersion(args.argv(), 0, tokens), \
+              dataBaseCacheVersion(args.argv(), 0, options));
+
+    ScoringDaemon daemon(args.argv(), 0, options);
+    ASSERT_TRUE(daemon.start(1));
+    DaemonClient client(daemon);
+    std::thread loop(&ScoringDaemon::serve, &daemon);
+    const std::string request = "MESSAGE 100 14\nfree money win";
+    EXPECT_EQ(client.send(request), "14 NOT_SPAM\n");
+    EXPECT_FALSE(daemon.reloadIfChanged());
+
+    // a changed delta file of the same size, told apart by its modification time; the reloader
+    // thread may reload it first, either way it is loaded once reloadIfChanged returns
+    writeFile("reload_test.delta", "=money,20\n");
+    setModificationTime("reload_test.delta", 1000000002);
+    daemon.reloadIfChanged();
+    EXPECT_EQ(client.send(request), "24 NOT_SPAM\n");
+
+    // an invalid data base is not published
+    writeFile("reload_test.csv", "free,1\nwin\n");
+    daemon.reloadIfChanged();
+    EXPECT_EQ(client.send(request), "24 NOT_SPAM\n");
+
+    // a data base that replaces the file
+    writeFile("reload_test.new", "free,5\nwin,3\n");
+    ASSERT_EQ(std::rename("reload_test.new", "reload_test.csv"), 0);
+    daemon.reloadIfChanged();
+    EXPECT_EQ(client.send(request), "28 NOT_SPAM\n");
+
+    daemon.stop();
+    loop.join();
+    std::remove("reload_test.csv");
+    std::remove("reload_test.delta");
+}
+TEST(SpamDetectorTest, deltaOperations)
+{
+    writeFile("delta_ops_test.csv", "free,1\nwin,3\n");
+    writeFile("delta_ops_test.delta", "+free,7\n+money,10\n=win,5\n=prize,2\n-gone\n");
+    ScanOptions options;
+    options.deltaPaths.push_back("delta_ops_test.delta");
+    HashMap<std::string, int> dataBase = loadTestDataBase("delta_ops_test.csv", options);
+    // '+' keeps the points of a bad sequence that is already there, '=' sets them, and '-' of a
+    // bad sequence that is not there does nothing
+    EXPECT_EQ(dataBase.size(), 4);
+    EXPECT_EQ(dataBase.at("free"), 1);
+    EXPECT_EQ(dataBase.at("money"), 10);
+    EXPECT_EQ(dataBase.at("win"), 5);
+    EXPECT_EQ(dataBase.at("prize"), 2);
+
+    // the delta files apply in order
+    writeFile("delta_ops_test2.delta", "-money\n=free,4\n");
+    options.deltaPaths.push_back("delta_ops_test2.delta");
+    dataBase = loadTestDataBase("delta_ops_test.csv", options);
+    EXPECT_EQ(dataBase.size(), 3);
+    EXPECT_FALSE(dataBase.containsKey("money"));
+    EXPECT_EQ(dataBase.at("free"), 4);
+
+    // an invalid delta is rejected as a whole, with the number of its invalid line
+    const std::string invalidDeltas[] = {"+free,1\nfree,1\n", "+free,1\n-free,1\n", \
+                                         "+free,1\n=free\n", "+free,1\n*free,1\n", "+free,1\n-\n"};
+    for (const std::string& delta : invalidDeltas)
+    {
+        writeFile("delta_ops_test2.delta", delta);
+        HashMap<std::string, int> invalid;
+        Arguments args({"delta_ops_test.csv"});
+        long invalidLine = 0;
+        EXPECT_FALSE(loadDataBase(invalid, args.argv(), 0, options, invalidLine));
+        EXPECT_EQ(invalidLine, 2);
+    }
+
+    // every 'apply-delta' appends a segment that is replayed in order on load
+    Arguments compileArgs({"delta_ops_test.csv", "delta_ops_test.img"});
+    long invalidLine = 0;
+    ASSERT_TRUE(compileDataBase(compileArgs.argv(), 0, 1, invalidLine));
+    const std::string segments[] = {"+money,10\n=win,5\n", "-money\n+money,6\n", "=free,4\n"};
+    Arguments applyArgs({"delta_ops_test.img", "delta_ops_test2.delta"});
+    for (const std::string& segment : segments)
+    {
+        writeFile("delta_ops_test2.delta", segment);
+        ASSERT_TRUE(appendDeltaToCompiledDataBase(applyArgs.argv(), 0, 1, invalidLine));
+    }
+    ScanOptions compiled;
+    compiled.dbCompiled = true;
+    dataBase = loadTestDataBase("delta_ops_test.img", compiled);
+    EXPECT_EQ(dataBase.size(), 3);
+    EXPECT_EQ(dataBase.at("free"), 4);
+    EXPECT_EQ(dataBase.at("money"), 6);
+    EXPECT_EQ(dataBase.at("win"), 5);
+
+    // an invalid delta appends nothing, and a corrupted segment is rejected
+    const std::string image = readFile("delta_ops_test.img");
+    writeFile("delta_ops_test2.delta", "+money,1\nmoney\n");
+    EXPECT_FALSE(appendDeltaToCompiledDataBase(applyArgs.argv(), 0, 1, invalidLine));
+    EXPECT_EQ(invalidLine, 2);
+    EXPECT_EQ(readFile("delta_ops_test.img"), image);
+    std::string corrupted = image;
+    corrupted[corrupted.length() - 1] ^= 1;
+    writeFile("delta_ops_test.img", corrupted);
+    Arguments imageArgs({"delta_ops_test.img"});
+    EXPECT_FALSE(insertCompiledDataBaseToHashMap(dataBase, imageArgs.argv(), 0));
+    writeFile("delta_ops_test.img", image + COMPILED_DELTA_MAGIC);
+    EXPECT_FALSE(insertCompiledDataBaseToHashMap(dataBase, imageArgs.argv(), 0));
+
+    std::remove("delta_ops_test.csv");
+    std::remove("delta_ops_test.img");
+    std::remove("delta_ops_test.delta");
+    std::remove("delta_ops_test2.delta");
+}
+
+/**
+ * @param random - random generator
+ * @param length - length of the text
+ * @param letters - the letters of the text, few letters give many overlapping occurrences
+ * @return - a text of the letters, each in lower or upper case
+ */
+std::string randomText(std::mt19937& random, size_t length, const std::string& letters)
+{
+    std::string text;
+    for (size_t i = 0; i < length; i++)
+    {
+        char c = letters[random() % letters.length()];
+        text += random() % 2 == 0 ? c : static_cast<char>(std::toupper(c));
+    }
+    return text;
+}
+
+TEST(SpamDetectorTest, earlyExit)
+{
+    std::mt19937 random(2019);
+    for (int round = 0; round < 20; round++)
+    {
+        HashMap<std::string, int> dataBase;
+        for (int i = 0; i < 30; i++)
+        {
+            dataBase.insert(randomText(random, 1 + random() % 6, "abc"), random() % 10);
+        }
+        // messages of several blocks, so occurrences cross the ends of the blocks
+        const std::string msg = randomText(random, random() % (5 * EARLY_EXIT_BLOCK_SIZE), "abc");
+        const std::string lowerCaseMsg = lowerStringCase(msg);
+        const std::vector<std::pair<std::string, long>> patterns = sortPatternsByPoints(dataBase);
+        const long total = getTotalPoints(msg, dataBase);
+        EXPECT_EQ(getTotalPointsUpToThreshold(lowerCaseMsg, patterns, \
+                                              std::numeric_limits<long>::max()), total);
+        for (long threshold : {1L, total / 3, total / 2, total, total + 1})
+        {
+            if (threshold <= 0)
+            {
+                continue;
+            }
+            long points = getTotalPointsUpToThreshold(lowerCaseMsg, patterns, threshold);
+            EXPECT_EQ(points >= threshold, total >= threshold);
+            EXPECT_LE(points, total);
+            if (points < threshold)
+            {
+                EXPECT_EQ(points, total);
+            }
+        }
+    }
+}
+TEST(SpamDetectorTest, tokens)
+{
+    std::vector<std::size_t> wordStarts;
+    EXPECT_EQ(normalizeWords("  Free-MONEY!!\tnow, 100%", wordStarts), "free money now 100");
+    EXPECT_EQ(wordStarts, std::vector<std::size_t>({0, 5, 11, 15}));
+    EXPECT_EQ(normalizeWords("?! ...", wordStarts), "");
+    EXPECT_TRUE(wordStarts.empty());
+
+    // bad sequences with the same words are folded, and those without any word are dropped
+    HashMap<std::string, int> dataBase;
+    dataBase.insert("free", 1);
+    dataBase.insert("FREE!", 2);
+    dataBase.insert("Buy now", 4);
+    dataBase.insert("win", 8);
+    dataBase.insert("!!", 16);
+    TokenDataBase tokens;
+    buildTokenDataBase(dataBase, tokens);
+    EXPECT_EQ(tokens.points.size(), 3);
+    EXPECT_EQ(tokens.maxWords, 2UL);
+    EXPECT_EQ(tokens.points.at("free"), 3);
+    EXPECT_EQ(tokens.points.at("buy now"), 4);
+
+    // a whole word scores whatever its case and the punctuation around it
+    const long noThreshold = std::numeric_limits<long>::max();
+    EXPECT_EQ(getTotalPointsOfTokens("FREE, free... Buy\nNOW!", tokens, noThreshold), 10);
+    // a bad sequence inside a larger word does not, unlike in the default mode
+    const std::string msg = "freedom to buy nowhere, winner";
+    EXPECT_EQ(getTotalPointsOfTokens(msg, tokens, noThreshold), 0);
+    EXPECT_EQ(getTotalPoints(msg, dataBase), 13);
+    // the scan stops once the points reach the threshold
+    EXPECT_EQ(getTotalPointsOfTokens("win win win", tokens, 10), 16);
+}
+TEST(SpamDetectorTest, nGramFilter)
+{
+    std::mt19937 random(2019);
+    for (int round = 0; round < 20; round++)
+    {
+        const std::string text = lowerStringCase(randomText(random, 1 + random() % 5000, \
+                                                            "abcdefgh"));
+        const std::unique_ptr<NGramFilter> filter(new NGramFilter(text));
+        // every substring of the text may be in it
+        for (int i = 0; i < 500; i++)
+        {
+            size_t start = random() % text.length();
+            EXPECT_TRUE(filter->mayContain(text.substr(start, 1 + random() % 12)));
+        }
+    }
+    const std::unique_ptr<NGramFilter> filter(new NGramFilter("free money"));
+    EXPECT_TRUE(filter->mayContain("ee mo"));
+    EXPECT_TRUE(filter->mayContain("zz"));
+    EXPECT_FALSE(filter->mayContain("free cash"));
+
+    // scoring with the filter counts the same as searching for every bad sequence
+    for (int round = 0; round < 20; round++)
+    {
+        HashMap<std::string, int> dataBase;
+        for (int i = 0; i < 50; i++)
+        {
+            dataBase.insert(randomText(random, 1 + random() % 8, "abcdefgh"), random() % 10);
+        }
+        const std::string msg = randomText(random, random() % 3000, "abcdefgh");
+        long total = 0;
+        for (const auto& pair : dataBase)
+        {
+            total += countNumberOfStrInStr(msg, pair.first) * pair.second;
+        }
+        EXPECT_EQ(getTotalPoints(msg, dataBase), total);
+    }
+}
+TEST(SpamDetectorTest, scoreCache)
+{
+    ScoreCache cache(3);
+    const ScoreCacheKey key = makeScoreCacheKey("free money", 1);
+    long score = 0;
+    EXPECT_FALSE(cache.find(key, 10, score));
+    cache.insert(key, 7, false);
+    EXPECT_TRUE(cache.find(key, 10, score));
+    EXPECT_EQ(score, 7);
+    // another data base version or another message is another key
+    EXPECT_FALSE(cache.find(makeScoreCacheKey("free money", 2), 10, score));
+    EXPECT_FALSE(cache.find(makeScoreCacheKey("free money!", 1), 10, score));
+    // a partial score answers only thresholds that it reaches
+    const ScoreCacheKey partialKey = makeScoreCacheKey("win a prize", 1);
+    cache.insert(partialKey, 50, true);
+    EXPECT_TRUE(cache.find(partialKey, 50, score));
+    EXPECT_EQ(score, 50);
+    EXPECT_FALSE(cache.find(partialKey, 51, score));
+    EXPECT_EQ(cache.hits(), 2UL);
+    EXPECT_EQ(cache.misses(), 4UL);
+    EXPECT_EQ(cache.size(), 2UL);
+
+    // the entries and counters survive a save and a load, least recently used first
+    ASSERT_TRUE(cache.save("score_cache_test.bin"));
+    ScoreCache loaded(2);
+    const ScoreCacheKey newKey = makeScoreCacheKey("new", 1);
+    loaded.insert(newKey, 1, false);
+    ASSERT_TRUE(loaded.load("score_cache_test.bin"));
+    EXPECT_EQ(loaded.size(), 2UL);
+    EXPECT_EQ(loaded.hits(), 2UL);
+    EXPECT_EQ(loaded.misses(), 4UL);
+    EXPECT_TRUE(loaded.find(key, 10, score));
+    EXPECT_EQ(score, 7);
+    EXPECT_TRUE(loaded.find(partialKey, 40, score));
+    EXPECT_FALSE(loaded.find(partialKey, 60, score));
+    EXPECT_FALSE(loaded.find(newKey, 10, score));
+    // a damaged or missing file is ignored
+    std::string file = readFile("score_cache_test.bin");
+    file[file.length() - 1] ^= 1;
+    writeFile("score_cache_test.bin", file);
+    ScoreCache damaged(3);
+    EXPECT_FALSE(damaged.load("score_cache_test.bin"));
+    EXPECT_EQ(damaged.size(), 0UL);
+    std::remove("score_cache_test.bin");
+    EXPECT_FALSE(damaged.load("score_cache_test.bin"));
+
+    // a changed data base gets a new version, so its messages are scored again
+    writeFile("score_cache_test.csv", "free,1\n");
+    setModificationTime("score_cache_test.csv", 1000000000);
+    Arguments args({"score_cache_test.csv"});
+    ScanOptions options;
+    long invalidLine = 0;
+    std::shared_ptr<const DataBaseSnapshot> snapshot = \
+        buildDataBaseSnapshot(args.argv(), 0, options, 1, invalidLine);
+    ASSERT_NE(snapshot, nullptr);
+    ScoreCache scores(10);
+    EXPECT_EQ(scoreMessageWithCache("free free", *snapshot, options, 5, scores), 2);
+    EXPECT_EQ(scoreMessageWithCache("free free", *snapshot, options, 5, scores), 2);
+    EXPECT_EQ(scores.hits(), 1UL);
+    writeFile("score_cache_test.csv", "free,3\n");
+    setModificationTime("score_cache_test.csv", 1000000001);
+    snapshot = buildDataBaseSnapshot(args.argv(), 0, options, 2, invalidLine);
+    ASSERT_NE(snapshot, nullptr);
+    EXPECT_EQ(scoreMessageWithCache("free free", *snapshot, options, 5, scores), 6);
+    EXPECT_EQ(scores.hits(), 1UL);
+    EXPECT_EQ(scores.misses(), 2UL);
+    std::remove("score_cache_test.csv");
+}
+
+/**
+ * @return - what explainFilePoint wrote to std::cerr, with every time replaced by 0
+ */
+std::string explainOutput(char* argv[], const DataBaseSnapshot& snapshot, \
+                          const ScanOptions& options, long threshold, long& score)
+{
+    std::ostringstream captured;
+    std::streambuf *oldBuffer = std::cerr.rdbuf(captured.rdbuf());
+    score = explainFilePoint(argv, 1, snapshot, options, threshold);
+    std::cerr.rdbuf(oldBuffer);
+    return std::regex_replace(captured.str(), std::regex("\"nanoseconds\":[0-9]+"), \
+                              "\"nanoseconds\":0");
+}
+
+TEST(SpamDetectorTest, explainAndProfile)
+{
+    EXPECT_EQ(jsonString("a\"b\\c\n"), "\"a\\\"b\\\\c\\u000a\"");
+
+    writeFile("explain_test.csv", "free,3\ncash,5\nprize,2\n");
+    writeFile("explain_test.txt", "Free cash, free money");
+    Arguments args({"explain_test.csv", "explain_test.txt"});
+    ScanOptions options;
+    long invalidLine = 0;
+    std::shared_ptr<const DataBaseSnapshot> snapshot = \
+        buildDataBaseSnapshot(args.argv(), 0, options, 1, invalidLine);
+    ASSERT_NE(snapshot, nullptr);
+    const std::string head = "{\"score\":11,\"threshold\":10,\"verdict\":\"SPAM\","
+                             "\"patterns\":3,\"matchedPatterns\":2,\"nanoseconds\":0";
+    const std::string free = "{\"pattern\":\"free\",\"matches\":2,\"points\":6";
+    const std::string cash = "{\"pattern\":\"cash\",\"matches\":1,\"points\":5";
+    const std::string prize = "{\"pattern\":\"prize\",\"matches\":0,\"points\":0";
+    long score = 0;
+
+    options.explain = true;
+    EXPECT_EQ(explainOutput(args.argv(), *snapshot, options, 10, score), \
+              head + ",\"topContributors\":[" + free + "}," + cash + "}]}\n");
+    EXPECT_EQ(score, 11);
+
+    // the slowest patterns are in the order of their times, so only their set is known
+    options.explain = false;
+    options.profile = true;
+    const std::string profiled = explainOutput(args.argv(), *snapshot, options, 12, score);
+    const std::string profiledHead = "{\"score\":11,\"threshold\":12,\"verdict\":\"NOT_SPAM\","
+                                     "\"patterns\":3,\"matchedPatterns\":2,\"nanoseconds\":0"
+                                     ",\"slowestPatterns\":[";
+    ASSERT_EQ(profiled.compare(0, profiledHead.length(), profiledHead), 0) << profiled;
+    EXPECT_EQ(profiled.substr(profiled.length() - 3), "]}\n");
+    EXPECT_EQ(profiled.length(), profiledHead.length() + free.length() + cash.length() + \
+                                 prize.length() + 3 * std::string(",\"nanoseconds\":0}").length() \
+                                 + 2 + 3);
+    for (const std::string& pattern : {free, cash, prize})
+    {
+        EXPECT_NE(profiled.find(pattern + ",\"nanoseconds\":0}"), std::string::npos) << pattern;
+    }
+
+    // with both, the contributors are timed too and come before the slowest patterns
+    options.explain = true;
+    const std::string both = explainOutput(args.argv(), *snapshot, options, 10, score);
+    const std::string bothHead = head + ",\"topContributors\":[" + free + \
+                                 ",\"nanoseconds\":0}," + cash + ",\"nanoseconds\":0}]," + \
+                                 "\"slowestPatterns\":[";
+    EXPECT_EQ(both.compare(0, bothHead.length(), bothHead), 0) << both;
+    EXPECT_EQ(both.length() - bothHead.length(), profiled.length() - profiledHead.length());
+
+    std::remove("explain_test.txt");
+    EXPECT_EQ(explainOutput(args.argv(), *snapshot, options, 10, score), "");
+    EXPECT_EQ(score, FAILURE);
+    std::remove("explain_test.csv");
+}
+TEST(SpamDetectorTest, deltaOnCompiledImage)
+{
+    writeFile("delta_test.csv", "free,1\nFREE,2\nwin,3\n");
+    Arguments compileArgs({"delta_test.csv", "delta_test.img"});
+    long invalidLine = 0;
+    ASSERT_TRUE(compileDataBase(compileArgs.argv(), 0, 1, invalidLine));
+    const std::string msg = "free money win";
+    const std::string deltas[] = {"-free\n", "=Free,10\n", "+FREE,7\n=win,5\n"};
+    const long scores[] = {5, 16, 8};
+    for (int i = 0; i < 3; i++)
+    {
+        writeFile("delta_test.delta", deltas[i]);
+        ScanOptions csv;
+        csv.deltaPaths.push_back("delta_test.delta");
+        ScanOptions compiled = csv;
+        compiled.dbCompiled = true;
+        EXPECT_EQ(getTotalPoints(msg, loadTestDataBase("delta_test.csv", csv)), scores[i]);
+        EXPECT_EQ(getTotalPoints(msg, loadTestDataBase("delta_test.img", compiled)), scores[i]);
+
+        // the same delta appended to the image by 'apply-delta'
+        writeFile("delta_test_applied.img", readFile("delta_test.img"));
+        Arguments applyArgs({"delta_test_applied.img", "delta_test.delta"});
+        ASSERT_TRUE(appendDeltaToCompiledDataBase(applyArgs.argv(), 0, 1, invalidLine));
+        compiled.deltaPaths.clear();
+        EXPECT_EQ(getTotalPoints(msg, loadTestDataBase("delta_test_applied.img", compiled)), \
+                  scores[i]);
+    }
+    std::remove("delta_test.csv");
+    std::remove("delta_test.img");
+    std::remove("delta_test.delta");
+    std::remove("delta_test_applied.img");
+}
+TEST(SpamDetectorTest, cacheOptions)
+{
+    Arguments noCache({"SpamDetector", "db.csv", "msg.txt", "1"});
+    ScanOptions options;
+    EXPECT_EQ(parseScanOptions(4, noCache.argv(), 1, options), 1);
+    EXPECT_FALSE(options.cache);
+    // asking for the default size still asks for a cache
+    Arguments defaultSize({"SpamDetector", "--cache-size", "65536", "db.csv"});
+    EXPECT_EQ(parseScanOptions(4, defaultSize.argv(), 1, options), 3);
+    EXPECT_TRUE(options.cache);
+    EXPECT_EQ(options.cacheSize, (std::size_t) CACHE_DEFAULT_SIZE);
+    EXPECT_TRUE(options.cachePath.empty());
+}